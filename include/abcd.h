@@ -156,6 +156,27 @@ public:
     /*! The entries of the matrix of size #nz */
     double *val;
 
+    /*! The row pointers of a matrix given in CSR, of size #m + 1
+     *
+     * When set, #jcn and #val hold the column indices and the entries
+     * of the rows one after the other and #irn is not used. With
+     * #start_index set to 1 the pointers are 1-based too. For a
+     * symmetric matrix only one triangle is given. Otherwise the
+     * arrays are used in place as the storage of the matrix: they are
+     * neither copied nor released, are modified by the preprocessing
+     * and have to live as long as the solver. Default is null.
+     */
+    int *row_ptr;
+
+    /*! The number of rows given by the processes before this one
+     *
+     * Used when icntl[Controls::dist_input] is set, each process then
+     * gives the rows from its #row_offset up to the #row_offset of the
+     * next process, or #m for the last one. #irn holds their global
+     * indices and #nz is the number of local entries. Default is 0.
+     */
+    int row_offset;
+
     /*! The number of right-hand sides to solve, default is 1 */
     int nrhs;
 
@@ -165,6 +186,14 @@ public:
     /*!  The solution vector of size #n * #nrhs */
     double *sol;
 
+    /*!  The starting point of the solve, of size #n * #nrhs
+     *
+     * Given in the original numbering, it is used by the regular
+     * block Cimmino only. When null (*default*) the solve starts from
+     * zero, see also icntl[Controls::warm_start].
+     */
+    double *x0;
+
     /*!  The gateway function that launches all other options
      *
      * Run an operation identified by the value of job_id, it can be
@@ -174,8 +203,10 @@ public:
      *    * The information about the matrix. #m, #n, #nz,
      *      #sym, #irn, #jcn and #val have to be initialized before the
      *      call.
+     *      A matrix in CSR is given through #row_ptr instead of #irn.
      *    * After the call, the arrays #irn, #jcn and #val
-     *      are no longer used by the solver and can be freely deallocated.
+     *      are no longer used by the solver and can be freely deallocated,
+     *      unless they were adopted through #row_ptr.
      * - 1, performs the preprocessing. During this call, the solver
      *    scales the matrix, partitions it and, if requested by the user,
      *    performs the augmentation of the matrix. Prior to this call, the
@@ -201,6 +232,19 @@ public:
      * - 4, combines the call to the phases 1 and 2. 
      * - 5, combines the call to the phases 2 and 3. 
      * - 6, combines the call to the phases 1, 2 and 3.
+     * - 7, refactorizes a matrix with the same sparsity pattern, it
+     *     can be called after the phases 2 or 3.
+     *     * The new values are given in #val, in the same order as
+     *       the entries given to the phase -1. #irn and #jcn are not
+     *       used.
+     *     * The scaling, the partitioning, the structure of the
+     *       augmentation and the analysis of the augmented systems
+     *       are kept. The new values, and the blocks of C computed
+     *       from them, are pushed in the existing partitions and only
+     *       the numerical factorization is redone. With ABCD, S is
+     *       rebuilt during the next solve.
+     *     * If a cancellation changes the pattern of C, the status is
+     *       set to ``-14``.
      *
      */
     int operator() (int job_id);
@@ -232,6 +276,22 @@ public:
     /*! The path where to write the matrix \f$S_k\f$ where \f$k\f$ is the mpi-process rank */
     std::string write_s;
 
+    /*! The path where to write a binary checkpoint of the preprocessed
+     *  problem at the end of the job 1, on the master
+     */
+    std::string write_checkpoint;
+
+    /*! The path of a checkpoint written by a previous run
+     *
+     * When set on the master, the job -1 does not need the matrix and
+     * the job 1 reads the scaling, the partitioning and the augmentation
+     * from the checkpoint instead of computing them, the controls of
+     * the preprocessing are then not used. A refactorization still
+     * needs the new entries in #val. Not available with
+     * icntl[Controls::dist_input].
+     */
+    std::string read_checkpoint;
+
     /*! The file where to write logging information */
     std::string log_output;
     
@@ -255,6 +315,7 @@ public:
     int initializeMatrix();
     int preprocessMatrix();
     int factorizeAugmentedSystems();
+    int refactorizeMatrix();
     int solveSystem();
     
     abcd();
@@ -297,12 +358,19 @@ private:
     // structure functions
     /// Partitions the matrix into abcd::nbrows
     void partitionMatrix();
+    void applyRowPartition(const int *partvec);
+    void multilevelPartition(std::vector<int> &partvec);
+    void columnPattern(std::vector<int> &xpins, std::vector<int> &pins);
+    void refinePartitionCoupling();
     /**
      * Analyses the structure of each partition
      * Compresses the  and analyses the interconnections between them
      */
     void analyseFrame();
 
+    void writeCheckpoint();
+    void readCheckpoint();
+
     /*! The type of process
      * - 0 the process will behave as a CG master
      * - 1 the process will be a  MUMPS Slave
@@ -314,15 +382,56 @@ private:
     void cijAugmentMatrix(std::vector<CompCol_Mat_double > &loc_parts);
     void aijAugmentMatrix(std::vector<CompCol_Mat_double > &loc_parts);
 
+    /// The two blocks of the augmentation between a pair of partitions,
+    /// main is 0 when C_i holds the columns to select and 1 for C_j
+    struct PairBlocks {
+        CompCol_Mat_double C_i;
+        CompCol_Mat_double C_j;
+        int main;
+    };
+    bool cijPairBlocks(CompCol_Mat_double &A_ij, CompCol_Mat_double &A_ji, PairBlocks &pb);
+    bool aijPairBlocks(CompCol_Mat_double &A_ij, CompCol_Mat_double &A_ji, PairBlocks &pb);
+    bool pairBlocks(CompCol_Mat_double &A_ij, CompCol_Mat_double &A_ji, PairBlocks &pb);
+    void localPairBlocks(std::vector<CompCol_Mat_double > &loc_parts,
+                         std::vector<std::vector<int> > &ci,
+                         std::map<std::pair<int, int>, PairBlocks> &blocks);
+    int refreshPartitions(CompRow_Mat_double &new_A,
+                          std::vector<std::vector<double> > &part_vals);
+
+    // Distributed preprocessing, the jobs are run by all the processes
+    /// Whether the master hands the preprocessing jobs to all processes,
+    /// the partitions then stay on the masters holding them
+    bool dist_prep;
+    /// The partitions kept by this master until distributeData
+    std::map<int, CompCol_Mat_double> dist_parts;
+    void distributedScaling();
+    void distributedPartitions();
+    void distributedPairBlocks(std::map<std::pair<int, int>, PairBlocks> &blocks);
+    /// The master holding each partition
+    std::vector<int> part_holder;
+
+    // Matrix given by slices of rows, see icntl[Controls::dist_input]
+    /// The first row of each process, and m
+    std::vector<int> row_slices;
+    /// The pattern of the whole matrix by rows, gathered on the master
+    /// for the hypergraph partitioners
+    std::vector<int> pattern_rp, pattern_ci;
+    int initializeDistributedMatrix();
+    void preprocessDistributedMatrix();
+    void distributedRowPartition();
+    void distributedAugmentation();
+    void adoptDistributedPartitions(std::vector<int> &colours);
+
     // Communication stuffs
     void createInterCommunicators();
     void distributePartitions();
     void createInterconnections();
 
     void distributeData();
+    void computeNrmMtx();
 
     void solveABCD(MV_ColMat_double &b);
-    MV_ColMat_double solveS ( MV_ColMat_double &f );
+    void solveS ( MV_ColMat_double &f );
 
     void buildS(std::vector<int> &rows,
                 std::vector<int> &cols,
@@ -335,27 +444,61 @@ private:
 
     Coord_Mat_double buildS();
     Coord_Mat_double buildS(std::vector<int>);
+    void buildSchurS(std::vector<int> &my_cols,
+                     std::vector<int> &rows,
+                     std::vector<int> &cols,
+                     std::vector<double> &vals);
 
     // Cimmino
     void initializeDirectSolver();
     void distributeRhs();
+    void distributeX0();
     void distributeNewRhs();
     void bcg(MV_ColMat_double &b);
 
-    MUMPS buildM();
-    VECTOR_double solveM ( MUMPS &mu, VECTOR_double &z );
+    void buildM();
+    void factorizeOnMasters(MUMPS &mumps, int order, std::vector<int> &irn,
+                            std::vector<int> &jcn, std::vector<double> &val,
+                            const char *what);
+    MV_ColMat_double solveM(MV_ColMat_double &Z);
     MV_ColMat_double prodSv(MV_ColMat_double &);
-    VECTOR_double pcgS ( VECTOR_double &b );
+    MV_ColMat_double pcgS(MV_ColMat_double &F);
+    void selectSColumns(CompCol_Mat_double &C_i, CompCol_Mat_double *C_j, int first);
     std::vector<int> selected_S_columns;
     std::vector<int> skipped_S_columns;
+    /// The factorized preconditioner of the iterative solve of Sz = f
+    MUMPS mumps_M;
     double compute_rho(MV_ColMat_double &X, MV_ColMat_double &U);
+    double compute_rho(VECTOR_double &nrmR, VECTOR_double &nrmX);
+    void pipelinedCG(MV_ColMat_double &b);
+    void chebyshev(MV_ColMat_double &b);
+    void asyncCimmino(MV_ColMat_double &b);
+    void kaczmarzSweeps(MV_ColMat_double &b);
+    void twoLevelCG(MV_ColMat_double &b);
+    void startAcceleration(MV_ColMat_double &b, MV_ColMat_double &u);
+    void endAcceleration(int it);
+    void globalDot(MV_ColMat_double &W, MV_ColMat_double &V, double *dots, bool diag);
     std::vector<double> normres;
 
+    // Krylov recycling across the solves
+    int recycleBudget();
+    void deflateStart(MV_ColMat_double &r);
+    void deflateDirection(MV_ColMat_double &r, MV_ColMat_double &p);
+    void updateRecycleBasis(std::vector<MV_ColMat_double> &P,
+                            std::vector<MV_ColMat_double> &HP);
+    /// The recycled basis, with rec_W^T H rec_W = I, and rec_HW = H rec_W
+    MV_ColMat_double rec_W;
+    MV_ColMat_double rec_HW;
+    int rec_size;
+
     // MUMPS
     int m_n;
     int m_nz;
     int n_aug, nz_aug;
     std::vector<int> irn_aug, jcn_aug;
+    /// The ordering of the initial local analysis, given to MUMPS
+    /// for the analysis with the slaves
+    std::vector<int> aug_perm;
     std::vector<double> val_aug;
 
     MUMPS mumps;
@@ -370,10 +513,101 @@ private:
     void allocateMumpsSlaves(MUMPS &);
     void factorizeAugmentedSystems(MUMPS &);
 
+    /// Computes alpha * A^+ Rhs + beta * H X
+    ///
+    /// The result references abcd::ws_delta and the next call to
+    /// sumProject (or sweepProject) overwrites it: use it right away or
+    /// assign it to a matrix that owns its storage, never keep it in a
+    /// matrix constructed from the return value such as
+    /// `MV_ColMat_double x = sumProject(...)` across another call.
     MV_ColMat_double sumProject(double alpha,
                                 MV_ColMat_double &Rhs,
                                 double beta,
                                 MV_ColMat_double &X);
+    void solveLocalProjections(double alpha,
+                               MV_ColMat_double &Rhs,
+                               double beta,
+                               MV_ColMat_double &X,
+                               int s,
+                               VECTOR_double *nrmR = nullptr);
+
+    // Block Kaczmarz sweeps over coloured partitions
+    void colourPartitions(std::vector<int> &colours);
+    void distributeColours(std::vector<int> &colours);
+    /// Same result lifetime as sumProject, it lives in abcd::ws_delta
+    MV_ColMat_double sweepProject(double alpha,
+                                  MV_ColMat_double &Rhs,
+                                  double beta,
+                                  MV_ColMat_double &X);
+    /// The colour of each local partition
+    std::vector<int> part_colour;
+    int nb_colours;
+    /// The colour whose projections are computed, -1 for all of them
+    int active_colour;
+
+    // Two-level block Cimmino
+    void buildCoarseSpace();
+    MV_ColMat_double coarseCorrection(MV_ColMat_double &r);
+    /// The coarse vector, i.e. the global partition, of each local column
+    std::vector<int> coarse_id;
+    /// The factorized coarse matrix Z^T H Z
+    MUMPS mumps_E;
+
+    // sumProject workspace, reused across the BCG iterations
+    void allocateWorkspace(int s);
+    /// The number of columns the workspace is sized for
+    int ws_s;
+    /// The number of bytes allocated by the workspace so far
+    double ws_bytes;
+    std::vector<double> ws_rhs;
+    std::vector<double> ws_delta;
+    /// Send and receive buffers, the key is the neighbour's rank in inter_comm
+    std::map<int, std::vector<double> > ws_itcp;
+    std::map<int, std::vector<double> > ws_otcp;
+    std::vector<mpi::request> ws_reqs;
+
+    /// For each local column, the positions in the augmented systems'
+    /// solution contributing to it, in CSR format
+    std::vector<int> delta_src_ptr;
+    std::vector<int> delta_src;
+    /// Local columns shared with other masters and the remaining ones
+    std::vector<int> boundary_cols;
+    std::vector<int> interior_cols;
+
+    /// The distributed graph of the masters sharing columns with us
+    mpi::communicator halo_comm;
+    /// The neighbours in halo_comm and the columns exchanged with each
+    /// of them, packed one after the other
+    std::vector<int> halo_nbrs;
+    std::vector<int> halo_ptr;
+    std::vector<int> halo_idx;
+    std::vector<double> halo_sbuf;
+    std::vector<double> halo_rbuf;
+    std::vector<int> halo_counts;
+    std::vector<int> halo_displs;
+    MPI_Request halo_req;
+    /// The number of columns halo_req was initialized for
+    int halo_req_s;
+
+    /// The C columns held by this master, as indices in C and as local
+    /// columns, the c_nb_owned owned ones (comm_map == 1) first
+    std::vector<int> c_idx;
+    std::vector<int> c_loc;
+    int c_nb_owned;
+    /// On the first master, the C columns of every master packed one
+    /// after the other, with the number of held and owned ones
+    std::vector<int> c_all_idx;
+    std::vector<int> c_counts;
+    std::vector<int> c_owned_counts;
+    std::vector<int> c_displs;
+
+    void createHaloGraph();
+    void createCLayout();
+    void gatherF(MV_ColMat_double &w, MV_ColMat_double &f);
+    void scatterZ(MV_ColMat_double &z, MV_ColMat_double &x);
+    void gatherDelta(std::vector<int> &cols, int s);
+    void postDeltaExchange(int s);
+    void finishDeltaExchange(int s);
     MV_ColMat_double spSimpleProject(std::vector<int> mycols);
     void spSimpleProject(std::vector<int> mycols, std::vector<int> &vrows,
                          std::vector<int> &vcols, std::vector<double> &vvals);
@@ -394,6 +628,10 @@ private:
                     MV_ColMat_double &b,
                     VECTOR_double &nrmR,
                     VECTOR_double &nrmX);
+    void get_local_nrmres(MV_ColMat_double &x,
+                          MV_ColMat_double &b,
+                          VECTOR_double &nrmRV,
+                          VECTOR_double &nrmXV);
 
     MUMPS mumps_S;
     Coord_Mat_double S;
@@ -409,6 +647,9 @@ private:
 
     CompRow_Mat_double A;
     std::vector<int> row_perm;
+    /// The index in the user's val of each entry of A before the row permutation,
+    /// empty when the entries are in the user's order
+    std::vector<int> a_entries;
 
     bool runSolveS;
 
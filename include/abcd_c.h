@@ -43,16 +43,50 @@ enum controls {
    abcd_verbose_level      , 
    abcd_aug_type           ,
    abcd_aug_blocking       ,
+   abcd_halo_exchange      ,
+   abcd_acceleration       ,
+   abcd_check_interval     ,
+   abcd_aug_schur          ,
+   abcd_aug_balance        ,
+   abcd_aug_iterative      ,
+   abcd_aug_itmax          ,
+   abcd_recycle            ,
+   abcd_warm_start         ,
+   abcd_cheb_lanczos       ,
+   abcd_kaczmarz           ,
+   abcd_two_level          ,
+   abcd_part_refine        ,
+   abcd_dist_preprocess    ,
+   abcd_dist_input
+};
 
+/* the indices in dcntl, the same as Controls::dcontrols */
+enum dcontrols {
    abcd_part_imbalance     ,
    abcd_threshold          ,
+   abcd_aug_precond        ,
+   abcd_aug_tol            ,
+   abcd_recycle_mem        ,
+   abcd_async_omega
+};
 
+/* the indices in info, the same as Controls::info */
+enum info {
    abcd_status             ,
    abcd_nb_iter            ,
+   abcd_aug_nb_iter
+};
+
+/* the indices in dinfo, the same as Controls::dinfo */
+enum dinfo {
    abcd_residual           ,
    abcd_forward_error      ,
    abcd_backward           ,
-   abcd_scaled_residual    
+   abcd_scaled_residual    ,
+   abcd_ws_bytes           ,
+   abcd_ws_iter_bytes      ,
+   abcd_s_imbalance        ,
+   abcd_aug_residual
 };
 
 
@@ -68,17 +102,22 @@ struct abcd_solver
   int sym;
   
   char *write_problem;
+  char *write_checkpoint;
+  char *read_checkpoint;
 
   int *irn;
   int *jcn;
   double *val;
+  int *row_ptr;
   int start_index;
+  int row_offset;
     
 
   int nrhs;
     
   double *rhs;
   double *sol;
+  double *x0;
 };
 
 typedef struct abcd_solver abcd_c;
@@ -651,6 +651,9 @@ int BLASFUNC(cpotri)(char *, int *, float  *, int *, int *);
 int BLASFUNC(zpotri)(char *, int *, double *, int *, int *);
 int BLASFUNC(xpotri)(char *, int *, double *, int *, int *);
 
+int BLASFUNC(ssyev)(char *, char *, int *, float  *, int *, float  *, float  *, int *, int *);
+int BLASFUNC(dsyev)(char *, char *, int *, double *, int *, double *, double *, int *, int *);
+
 #ifdef __cplusplus
 }
 #endif
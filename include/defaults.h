@@ -111,6 +111,12 @@ namespace Controls{
          *         obj.dcntl[part_imbalance] = 0.3;
          *
          * \endrststar
+         *
+         * - 4, Automatic hypergraph partitioning with the in-tree
+         *   multilevel partitioner, for when ``PaToH`` is not
+         *   available. The rows are the vertices and the columns the
+         *   nets as with ``PaToH``, the imbalance is also handled
+         *   using ``obj.dcntl[part_imbalance]``.
          */
         part_type          ,
 
@@ -187,6 +193,217 @@ namespace Controls{
          */
         aug_blocking        ,
 
+        /*! \brief The exchange of the projections between the masters
+         *
+         * Defines how each CG-master sums its projections with the
+         * ones of the masters sharing columns with it:
+         * - 0 (*default*), compute all the local projections, then
+         *   exchange the shared columns and wait for them.
+         * - 1, pipelined exchange: the shared columns are summed and
+         *   sent first, the remaining columns are summed while the
+         *   messages are in flight.
+         * - 2, pipelined exchange using a single neighbourhood
+         *   collective over a distributed graph of the masters that
+         *   share columns (persistent when MPI-4 is available).
+         */
+        halo_exchange       ,
+
+        /*! \brief The acceleration used in regular block Cimmino
+         *
+         * Possible values are:
+         * - 0 (*default*), stabilized block-CG, see #block_size.
+         * - 1, pipelined CG: each right-hand side is handled by its
+         *   own CG recurrence and all the global reductions of an
+         *   iteration (inner products and stopping criterion) are
+         *   fused in a single non-blocking reduction that overlaps
+         *   the next sum of projections. The stopping criterion is
+         *   evaluated on the current iterate inside that reduction,
+         *   which costs one extra sum of projections at the last
+         *   iteration. The #block_size is ignored.
+         * - 2, Chebyshev semi-iterations: #cheb_lanczos CG steps
+         *   estimate the spectrum of the sum of projectors, then the
+         *   iterations only need the sums of projections, without
+         *   any inner product. The backward error is the only global
+         *   reduction left, computed every #check_interval
+         *   iterations. The #block_size is ignored.
+         * - 3, asynchronous relaxed block Cimmino: each master
+         *   updates its columns with its own projections and those
+         *   received from the masters sharing them, without waiting
+         *   for them. See dcntl[Controls::async_omega]. The #itmax
+         *   bounds the local iterations of each master.
+         */
+        acceleration        ,
+
+        /*! \brief The interval between two backward error computations
+         *
+         * The backward error needs a product with the local matrix
+         * and a global reduction. With a value ``k`` higher than ``1``
+         * it is only computed every ``k`` iterations, the iterations
+         * in between use an estimate derived from the recurrence of
+         * the acceleration. The exact value is also computed as soon as
+         * the estimate gets below the threshold and at the last
+         * iteration, so that dinfo[Controls::backward] is always exact
+         * on exit. Default is ``0``: every iteration, but every ``10``
+         * iterations with the Chebyshev #acceleration, whose only
+         * global reduction is this one.
+         */
+        check_interval      ,
+
+        /*! \brief The way S is built in ABCD
+         *
+         * Possible values are:
+         * - 0 (*default*), project blocks of #aug_blocking columns of
+         *   Y^T with sparse right-hand side solves.
+         * - 1, get from MUMPS the Schur complement on the C variables
+         *   of each augmented system, its inverse is the partition's
+         *   contribution to S. It needs a dense matrix of the size of
+         *   the partition's C columns and runs on the masters only.
+         */
+        aug_schur           ,
+
+        /*! \brief Balance the construction of S between the masters
+         *
+         * When set to ``1``, each master starts with blocks of
+         * #aug_blocking columns scaled by its number of C columns and
+         * inversely to the cost of one of its solves (the size of its
+         * factors), both relative to the average master. It then grows
+         * or shrinks them, within a factor 4 of #aug_blocking, following
+         * the time per column averaged over the last blocks. The
+         * resulting balance is in dinfo[Controls::s_imbalance].
+         * Default is ``0``, fixed blocks.
+         */
+        aug_balance         ,
+
+        /*! \brief Solve Sz = f iteratively in ABCD
+         *
+         * When set to ``1``, S is never assembled: Sz = f is solved with
+         * a preconditioned CG on all the right-hand sides at once, the
+         * products with S being sums of projections. The preconditioner
+         * is selected with dcntl[Controls::aug_precond] and the stopping
+         * criterion with dcntl[Controls::aug_tol] and #aug_itmax.
+         * Default is ``0``, build and factorize S.
+         */
+        aug_iterative       ,
+
+        /*! \brief The max number of iterations when solving Sz = f
+         *
+         * Used with #aug_iterative, default is ``0`` for the size of S.
+         * When reached before aug_tol, a warning is logged and
+         * info[Controls::status] is set to ``1``.
+         */
+        aug_itmax           ,
+
+        /*! \brief Recycle a Krylov subspace across the solves
+         *
+         * When set to ``k > 0``, the block-CG keeps at the end of
+         * each solve a basis of at most ``k`` vectors approximating the
+         * eigenvectors of the sum of projectors with the smallest
+         * eigenvalues, extracted from its search directions. The
+         * following solves start from the projection of the solution
+         * on that basis and keep their search directions orthogonal
+         * to it, which removes the slowest components of the
+         * convergence. The basis is dropped by a refactorization.
+         * Its memory is limited by dcntl[Controls::recycle_mem].
+         * Default is ``0``, no recycling.
+         */
+        recycle             ,
+
+        /*! \brief Start the solve from the previous solution
+         *
+         * When set to ``1``, the regular block Cimmino starts from the
+         * solution of the previous solve if it has the same number of
+         * right-hand sides, which suits sequences of close systems.
+         * Default is ``0``, start from abcd::x0 when it is given and
+         * from zero otherwise.
+         */
+        warm_start          ,
+
+        /*! \brief The number of CG steps before the Chebyshev iterations
+         *
+         * Used with #acceleration set to ``2``, the coefficients of
+         * these steps give the Lanczos estimates of the extreme
+         * eigenvalues. Default is ``0``, for 20 steps.
+         */
+        cheb_lanczos        ,
+
+        /*! \brief Sweep over the partitions instead of summing the projections
+         *
+         * The partitions are coloured so that the partitions of a
+         * colour share no column, their projections are computed in
+         * parallel and the colours are applied one after the other,
+         * as in block Kaczmarz. Only with the regular block Cimmino
+         * (#aug_type set to ``0``). Possible values are:
+         * - 0 (*default*), the sum of projections of block Cimmino.
+         * - 1, a forward then a backward sweep over the colours
+         *   replaces the sum of projections in the #acceleration
+         *   (except the asynchronous one), the operator stays
+         *   symmetric.
+         * - 2, forward sweeps on their own, without acceleration,
+         *   until the stopping criterion or #itmax is reached.
+         */
+        kaczmarz            ,
+
+        /*! \brief Add a coarse correction built from the partitions
+         *
+         * When set to ``1``, each column is given to one of the
+         * partitions holding it and the indicator of the columns of
+         * each partition makes a coarse space Z of #nbparts vectors.
+         * The coarse matrix Z^T H Z is assembled from the augmented
+         * systems, factorized once by MUMPS on the masters, and the
+         * coarse correction Z (Z^T H Z)^-1 Z^T is added to the
+         * identity to precondition a CG on each right-hand side. It
+         * keeps the number of iterations from growing with #nbparts.
+         * The #acceleration and #block_size are then ignored, and it
+         * is not combined with #kaczmarz. Default is ``0``.
+         */
+        two_level           ,
+
+        /*! \brief Reassign the rows after the partitioning by coupling
+         *
+         * When set to ``1``, the rows are moved between the partitions
+         * given by #part_type so that the rows whose normalized inner
+         * product is large end up in the same partition, as the
+         * convergence of block Cimmino depends on the angles between
+         * the blocks. The partition sizes stay within
+         * dcntl[Controls::part_imbalance] of the average. The coupling
+         * between the partitions is reported before and after.
+         * Default is ``0``.
+         */
+        part_refine         ,
+
+        /*! \brief Run the preprocessing on all the processes
+         *
+         * When set to ``1``, the master hands parts of the
+         * preprocessing to all the processes: the scaling of MUMPS
+         * runs in parallel on blocks of rows, the partitions are
+         * extracted by the masters holding them and stay there, and
+         * the blocks of the augmentation between pairs of partitions
+         * are computed by the master holding the first one of the
+         * pair. The partitioning itself still runs on the master,
+         * which only gets back the column indices. The partitions and
+         * the augmentation are the same as with ``0`` (*default*),
+         * which runs everything on the master. It is ignored when a
+         * checkpoint is written, see abcd::write_checkpoint.
+         */
+        dist_preprocess     ,
+
+        /*! \brief Give the matrix by slices of rows
+         *
+         * When set to ``1`` on all the processes, each process gives
+         * its own rows of the matrix, see abcd::row_offset, and the
+         * values of the matrix are never gathered: the scaling runs on
+         * the slices and the rows of each partition go to the master
+         * that holds it. PaToH and the multilevel partitioner still
+         * gather the whole pattern of the matrix on the master, which
+         * then needs room for its indices, and #part_refine is not
+         * available. The
+         * right-hand side is still given on the master, and the
+         * refactorization is not available. The matrix cannot be
+         * symmetric. Default is ``0``, the matrix is given on the
+         * master.
+         */
+        dist_input          ,
+
 #ifdef WIP
         /*! \brief Exploit the sparcity in MUMPS
          */
@@ -213,8 +430,6 @@ namespace Controls{
          */
         aug_analysis        ,
 
-        aug_iterative   , ///< \exp Enable or disable iterative solving of Sz=f
-
         aug_project     , ///< \deprecated Compute the projection only
         aug_dense       , ///< \deprecated Use dense RHS when doing the computation
 #endif //WIP
@@ -223,14 +438,45 @@ namespace Controls{
         part_imbalance, ///< The imbalance factor in PaToH case
         threshold     , ///< The stoping threshold
 
+        /*! \brief The preconditioner of the iterative solve of Sz = f
+         *
+         * The preconditioner is S restricted to a subset of its columns,
+         * the others being replaced by the identity, it is factorized
+         * once and reused by the following solves. A column is selected
+         * when the coupling it represents in the augmentation has a norm
+         * larger than the given value, a negative value ``-k`` selects
+         * one column out of ``k``. Default is ``0``, no preconditioner.
+         */
+        aug_precond   ,
+        aug_tol       , ///< The stopping threshold when solving Sz = f iteratively
+
+        /*! \brief The memory used by the recycling in MB per master
+         *
+         * Bounds the basis kept by icntl[Controls::recycle] together
+         * with the search directions gathered during a solve to
+         * extract it. Default is ``0``, room for the ``k`` vectors of
+         * the basis and ``2k`` gathered directions.
+         */
+        recycle_mem   ,
+
+        /*! \brief The relaxation of the asynchronous block Cimmino
+         *
+         * A column shared by ``s`` partitions is updated with ``omega
+         * / s`` times each of their projections. Default is ``0``,
+         * which means ``1``.
+         */
+        async_omega   ,
+
 #ifdef WIP
         aug_filter    , ///< \deprecated The filtering value
-        aug_precond   , ///< \exp The preconditioner criteria of selection
 #endif //WIP
     };
     enum info {
-        status        , ///< Exit status
+        status        , ///< Exit status, 1 if the solve of Sz = f stopped at aug_itmax
         nb_iter       , ///< Number of iterations after CG
+        aug_nb_iter   , ///< Iterations of the last iterative solve of Sz = f
+        nb_backward   , ///< Exact backward errors computed by the last solve
+        nb_orderings  , ///< Orderings computed by MUMPS for the augmented systems of the master
     };
 
     enum dinfo {
@@ -238,6 +484,12 @@ namespace Controls{
         forward_error  , ///< The resulting forward error
         backward       , ///< The resulting residual
         scaled_residual, ///< The resulting residual
+        ws_bytes       , ///< Bytes allocated by the sumProject workspace
+        ws_iter_bytes  , ///< Max bytes allocated by the workspace during a BCG iteration
+        s_imbalance    , ///< Max over average of the masters' time to build S
+        aug_residual   , ///< Max relative residual of the last iterative solve of Sz = f
+        coupling_before, ///< Coupling between the partitions before icntl[Controls::part_refine]
+        coupling_after , ///< Coupling between the partitions after icntl[Controls::part_refine]
     };
 
 }
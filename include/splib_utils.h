@@ -6,6 +6,7 @@ double infNorm(MV_ColMat_double &V);
 double infNorm(Coord_Mat_double &M);
 CompRow_Mat_double CSR_middleRows (CompRow_Mat_double &M, int st_row, int nb_rows, int nb_cols);
 CompCol_Mat_double CSC_middleRows (CompRow_Mat_double &M, int st_row, int nb_rows);
+void CSR_reference (CompRow_Mat_double &M, int m, int n, int nz, double *val, int *row_ptr, int *col_ind);
 CompCol_Mat_double sub_matrix (CompCol_Mat_double &M, std::vector<int> &ci);
 VECTOR_double middleCol(CompCol_Mat_double &M, int col_num);
 VECTOR_double middleCol(CompCol_Mat_double &M, int col_num, VECTOR_int &ind);
@@ -34,6 +34,30 @@ void set_matrix(
     obj.val = reinterpret_cast<double *>(val.get_data());
 }
 
+void set_csr_matrix(
+        abcd &obj,
+        int const & m, int const & n, int const & nz,
+        bn::ndarray const & row_ptr,
+        bn::ndarray const & col_ind,
+        bn::ndarray const & val
+    ) 
+{
+    // check types
+    if( (row_ptr.get_dtype() != bn::dtype::get_builtin<int>()) ||
+        (col_ind.get_dtype() != bn::dtype::get_builtin<int>()) ||
+        (val.get_dtype() != bn::dtype::get_builtin<double>())){
+        PyErr_SetString(PyExc_TypeError, "Incorrect array data type");
+        bp::throw_error_already_set();
+    }
+    
+    obj.m = m;
+    obj.n = n;
+    obj.nz = nz;
+    obj.row_ptr = reinterpret_cast<int *>(row_ptr.get_data());
+    obj.jcn = reinterpret_cast<int *>(col_ind.get_data());
+    obj.val = reinterpret_cast<double *>(val.get_data());
+}
+
 void set_rhs(
     abcd &obj,
     bn::ndarray const & rhs,
@@ -43,6 +67,18 @@ void set_rhs(
     obj.rhs = reinterpret_cast<double *>(rhs.get_data());
 }
 
+void set_x0(
+    abcd &obj,
+    bn::ndarray const & x0)
+{
+    if(x0.get_dtype() != bn::dtype::get_builtin<double>()){
+        PyErr_SetString(PyExc_TypeError, "Incorrect array data type");
+        bp::throw_error_already_set();
+    }
+
+    obj.x0 = reinterpret_cast<double *>(x0.get_data());
+}
+
 bn::ndarray get_sol(abcd &obj)
 {
     return bn::from_data(obj.sol, bn::dtype::get_builtin<double>(),
@@ -101,12 +137,17 @@ BOOST_PYTHON_MODULE(abcdpy)
     bp::class_<abcd>("abcd", bp::init<>())
         .def("run", &abcd::operator())
         .def("set_matrix", set_matrix)
+        .def("set_csr_matrix", set_csr_matrix)
         .def("set_rhs", set_rhs)
+        .def("set_x0", set_x0)
         .def("get_sol", get_sol)
         .def_readwrite("icntl", &abcd::icntl) 
         .def_readwrite("dcntl", &abcd::dcntl) 
         .def_readwrite("info", &abcd::info) 
         .def_readwrite("dinfo", &abcd::dinfo)
+        .def_readwrite("row_offset", &abcd::row_offset)
+        .def_readwrite("write_checkpoint", &abcd::write_checkpoint)
+        .def_readwrite("read_checkpoint", &abcd::read_checkpoint)
         .def("get_s", get_STuple)
         .def_readonly("s_shape", &abcd::size_c)
         .def_readonly("s_rows", &abcd::S_rows)
@@ -122,19 +163,43 @@ BOOST_PYTHON_MODULE(abcdpy)
         .value("block_size", Controls::block_size)
         .value("verbose_level", Controls::verbose_level)
         .value("aug_type", Controls::aug_type)
-        .value("aug_blocking", Controls::aug_blocking);
+        .value("aug_blocking", Controls::aug_blocking)
+        .value("halo_exchange", Controls::halo_exchange)
+        .value("acceleration", Controls::acceleration)
+        .value("check_interval", Controls::check_interval)
+        .value("aug_schur", Controls::aug_schur)
+        .value("aug_balance", Controls::aug_balance)
+        .value("aug_iterative", Controls::aug_iterative)
+        .value("aug_itmax", Controls::aug_itmax)
+        .value("recycle", Controls::recycle)
+        .value("warm_start", Controls::warm_start)
+        .value("cheb_lanczos", Controls::cheb_lanczos)
+        .value("kaczmarz", Controls::kaczmarz)
+        .value("two_level", Controls::two_level)
+        .value("part_refine", Controls::part_refine)
+        .value("dist_preprocess", Controls::dist_preprocess)
+        .value("dist_input", Controls::dist_input);
     
     bp::enum_<Controls::dcontrols>("dcontrols")
         .value("part_imbalance", Controls::part_imbalance)
-        .value("threshold", Controls::threshold);
+        .value("threshold", Controls::threshold)
+        .value("aug_precond", Controls::aug_precond)
+        .value("aug_tol", Controls::aug_tol)
+        .value("recycle_mem", Controls::recycle_mem)
+        .value("async_omega", Controls::async_omega);
 
     bp::enum_<Controls::info>("info")
         .value("status", Controls::status)
-        .value("nb_iter", Controls::nb_iter);
+        .value("nb_iter", Controls::nb_iter)
+        .value("aug_nb_iter", Controls::aug_nb_iter);
     
     bp::enum_<Controls::dinfo>("dinfo")
         .value("residual", Controls::residual)
         .value("forward_error", Controls::forward_error)
         .value("backward", Controls::backward)
-        .value("scaled_residual", Controls::scaled_residual);
+        .value("scaled_residual", Controls::scaled_residual)
+        .value("ws_bytes", Controls::ws_bytes)
+        .value("ws_iter_bytes", Controls::ws_iter_bytes)
+        .value("s_imbalance", Controls::s_imbalance)
+        .value("aug_residual", Controls::aug_residual);
 }
@@ -49,19 +49,31 @@ abcd::abcd()
     use_xk = false;
     use_xf = false;
     rhs = nullptr;
+    sol = nullptr;
+    row_offset = 0;
+    x0 = nullptr;
     size_c = 0;
     verbose = false;
     runSolveS = false;
     parallel_cg = 0;
+    ws_s = 0;
+    ws_bytes = 0;
+    halo_req = MPI_REQUEST_NULL;
+    halo_req_s = 0;
+    rec_size = 0;
+    nb_colours = 0;
+    active_colour = -1;
+    dist_prep = false;
 
     irn = nullptr;
     jcn = nullptr;
     val = nullptr;
+    row_ptr = nullptr;
 
-    icntl.assign(20, 0);
+    icntl.assign(32, 0);
     dcntl.assign(20, 0);
     info.assign(10, 0);
-    dinfo.assign(5, 0);
+    dinfo.assign(10, 0);
 
     icntl[Controls::aug_blocking] = 256;
 
@@ -72,7 +84,9 @@ abcd::abcd()
     icntl[Controls::scaling] = 1;
     icntl[Controls::itmax] = 1000;
     icntl[Controls::block_size] = 1;
+    icntl[Controls::check_interval] = 0;
     dcntl[Controls::threshold] = 1e-12;
+    dcntl[Controls::aug_tol] = 1e-10;
 
     icntl[Controls::verbose_level] = 0;
     info[Controls::status] = 0;
@@ -89,6 +103,27 @@ abcd::~abcd()
   if (mumps.initialized) {
     mumps(-2);
   }
+  if (mumps_M.initialized) {
+    mumps_M(-2);
+  }
+  if (mumps_E.initialized) {
+    mumps_E(-2);
+  }
+
+  int finalized;
+  MPI_Finalized(&finalized);
+  if (halo_req != MPI_REQUEST_NULL && !finalized) {
+    MPI_Request_free(&halo_req);
+  }
+}
+
+/// The row of the k-th user entry given by irn or by the CSR row_ptr,
+/// r being the row of the previous one
+static int entryRow(const int *irn, const int *row_ptr, int k, int r)
+{
+    if(row_ptr == nullptr) return irn[k];
+    while(row_ptr[r + 1] <= k) ++r;
+    return r;
 }
 
 /// Creates the internal matrix from user's data
@@ -97,24 +132,56 @@ int abcd::initializeMatrix()
     LINFO << "*----------------------------------*";
     LINFO << "> Local matrix initialization";
     
+    if(icntl[Controls::dist_input] != 0) return initializeDistributedMatrix();
+
     if(comm.rank() != 0) return 0;
+
+    if(read_checkpoint.length() != 0) {
+        LINFO << "The matrix will be read from the checkpoint";
+        return 0;
+    }
     
     // Check that the matrix data is present
-    if(irn == nullptr || jcn == nullptr || val == nullptr) {
+    bool csr = row_ptr != nullptr;
+    if((!csr && irn == nullptr) || jcn == nullptr || val == nullptr) {
         // Hey!! where is my data?
         info[Controls::status] = -1;
-        LOG_IF(irn == nullptr, ERROR) << "irn is not allocated";
+        LOG_IF(!csr && irn == nullptr, ERROR) << "irn is not allocated";
         LOG_IF(jcn == nullptr, ERROR) << "jcn is not allocated";
         LOG_IF(val == nullptr, ERROR) << "val is not allocated";
         throw std::runtime_error("Unallocated matrix vectors");
     }
     LINFO << "M  = " << m << "  N  = " << n << "  NZ = " << nz;
 
-    if(m <= 0 || n <= 0 || nz <= 0){
+    if(m <= 0 || n <= 0 || nz <= 0 ||
+       (csr && row_ptr[m] - row_ptr[0] != nz) || (csr && row_ptr[0] != start_index)){
         info[Controls::status] = -2;
         LOG_IF(m <= 0, ERROR) << "m is negative or zero";
         LOG_IF(n <= 0, ERROR) << "n is negative or zero";
         LOG_IF(nz<= 0, ERROR) << "nz is negative or zero";
+        LOG_IF(m > 0 && csr && (row_ptr[m] - row_ptr[0] != nz || row_ptr[0] != start_index), ERROR)
+            << "row_ptr does not hold nz entries from start_index";
+        throw std::range_error("Errornous information about the matrix");
+    }
+
+    // A is filled in a single pass that trusts the indices, an entry out
+    // of the matrix would be written out of bounds
+    int bad_ptr = 0, bad_row = 0, bad_col = 0;
+    if(csr) {
+        for(int i = 0; i < m; ++i)
+            if(row_ptr[i + 1] < row_ptr[i]) bad_ptr = 1;
+    } else {
+        for(int k = 0; k < nz; ++k)
+            if(irn[k] - start_index < 0 || irn[k] - start_index >= m) bad_row = 1;
+    }
+    for(int k = 0; k < nz; ++k)
+        if(jcn[k] - start_index < 0 || jcn[k] - start_index >= n) bad_col = 1;
+
+    if(bad_ptr || bad_row || bad_col) {
+        info[Controls::status] = -2;
+        LOG_IF(bad_ptr, ERROR) << "row_ptr is decreasing";
+        LOG_IF(bad_row, ERROR) << "irn has a row index out of the matrix";
+        LOG_IF(bad_col, ERROR) << "jcn has a column index out of the matrix";
         throw std::range_error("Errornous information about the matrix");
     }
 
@@ -122,52 +189,60 @@ int abcd::initializeMatrix()
 
     LINFO << "Using " << start_index << "-based arrays";
 
-    /// @TODO CHeck that the matrix is not structurally singular
-    if(sym) {
-        //over estimate nz
-        int     *t_irn = new int[2*nz];
-        int     *t_jcn = new int[2*nz];
-        double  *t_val = new double[2*nz];
-        int     t_nz = 0;
-        for(int k = 0; k < nz; ++k) {
-            irn[k] -= start_index;
-            jcn[k] -= start_index;
-
-            t_irn[t_nz] = irn[k];
-            t_jcn[t_nz] = jcn[k];
-            t_val[t_nz] = val[k];
-            t_nz++;
-            if(irn[k] != jcn[k]){
-                t_irn[t_nz] = jcn[k];
-                t_jcn[t_nz] = irn[k];
-                t_val[t_nz] = val[k];
-                t_nz++;
-            }
-        }
-        nz = t_nz;
-        Coord_Mat_double t_A;
-        t_A = Coord_Mat_double(m, n, t_nz, t_val, t_irn, t_jcn, MV_Matrix_::ref);
-        t = MPI_Wtime();
-        A = CompRow_Mat_double(t_A);
+    int user_nz = nz;
 
-        LINFO << "> Local matrix initialized in " << setprecision(2) << MPI_Wtime() - t << "s.";
-        delete[] t_irn;
-        delete[] t_jcn;
-        delete[] t_val;
+    if(csr) {
+        for(int i = 0; i <= m; ++i) row_ptr[i] -= start_index;
     } else {
-        t = MPI_Wtime();
-        for(int i=0; i<nz; ++i){
-            irn[i] -= start_index;
-            jcn[i] -= start_index;
+        for(int k = 0; k < nz; ++k) irn[k] -= start_index;
+    }
+    for(int k = 0; k < nz; ++k) jcn[k] -= start_index;
 
+    /// @TODO CHeck that the matrix is not structurally singular
+    if(csr && !sym) {
+        // the user's arrays become the storage of A, the entries keep
+        // their order so that a_entries is not needed
+        CSR_reference(A, m, n, nz, val, row_ptr, jcn);
+        a_entries.clear();
+    } else {
+        // the entries are counted per row to fill A in a single pass,
+        // the symmetric ones are mirrored on the way
+        std::vector<int> tally(m + 1, 0);
+        for(int k = 0, r = 0; k < user_nz; ++k) {
+            r = entryRow(irn, row_ptr, k, r);
+            tally[r + 1]++;
+            if(sym && r != jcn[k]) tally[jcn[k] + 1]++;
+        }
+        for(int i = 0; i < m; ++i) tally[i + 1] += tally[i];
+
+        nz = tally[m];
+        A.newsize(m, n, nz);
+        std::copy(tally.begin(), tally.end(), A.rowptr_ptr());
+
+        // remember where each user entry went in A so that the values can
+        // be refreshed later, the entries keep their order per row
+        int *ci = A.colind_ptr();
+        double *v = A.val_ptr();
+        a_entries.resize(nz);
+        for(int k = 0, r = 0; k < user_nz; ++k) {
+            r = entryRow(irn, row_ptr, k, r);
+
+            int p = tally[r]++;
+            ci[p] = jcn[k];
+            v[p] = val[k];
+            a_entries[p] = k;
+
+            if(sym && r != jcn[k]) {
+                p = tally[jcn[k]]++;
+                ci[p] = r;
+                v[p] = val[k];
+                a_entries[p] = k;
+            }
         }
-        Coord_Mat_double t_A;
-        t_A = Coord_Mat_double(m, n, nz, val, irn, jcn, MV_Matrix_::ref);
-        A = CompRow_Mat_double(t_A);
-
-        LINFO << "> Local matrix initialized in " << setprecision(2) << MPI_Wtime() - t << "s.";
     }
-    
+
+    LINFO << "> Local matrix initialized in " << setprecision(2) << MPI_Wtime() - t << "s.";
+
     n_o = n;
     m_o = m;
     nz_o = nz;
@@ -185,34 +260,79 @@ int abcd::preprocessMatrix()
     double tot = t;
     int err = 0;
 
+    if(icntl[Controls::dist_input] != 0) {
+        int ckp = write_checkpoint.length() != 0 || read_checkpoint.length() != 0;
+        mpi::broadcast(comm, ckp, 0);
+        if(ckp) {
+            info[Controls::status] = -15;
+            throw std::runtime_error("The checkpoints need the matrix on the master, they are not available with a distributed matrix.");
+        }
+
+        abcd::preprocessDistributedMatrix();
+        LINFO << "> Total time to preprocess: " << MPI_Wtime() - tot << "s.";
+        LINFO << "*----------------------------------*";
+        return 0;
+    }
+
     if(comm.rank() != 0) {
-        mpi::broadcast(comm, err, 0);
-        if (err != 0) {
-            info[Controls::status] = err;
-            throw std::runtime_error("The master asked me to stop.");
+        // run the jobs of the distributed preprocessing until the
+        // master is done or fails
+        dist_prep = false;
+        dist_parts.clear();
+        for(;;) {
+            mpi::broadcast(comm, err, 0);
+            if (err < 0) {
+                info[Controls::status] = err;
+                throw std::runtime_error("The master asked me to stop.");
+            }
+            if (err == 0) break;
+
+            if (err == 1) {
+                abcd::distributedScaling();
+            } else if (err == 2) {
+                dist_prep = true;
+                abcd::distributedPartitions();
+            } else if (err == 3) {
+                abcd::distributedAugmentation();
+            }
         }
-        return err;
+        return 0;
     }
 
     if (parallel_cg == 0) {
         parallel_cg = icntl[Controls::nbparts] < comm.size() ? icntl[Controls::nbparts] : comm.size();
     }
+
+    dist_prep = false;
+    if(read_checkpoint.length() != 0) {
+        abcd::readCheckpoint();
+
+        // the checkpoint may hold fewer partitions than asked
+        if (parallel_cg > icntl[Controls::nbparts]) parallel_cg = icntl[Controls::nbparts];
+    } else {
+        // a checkpoint holds the partitions, they have to be on the master
+        dist_prep = icntl[Controls::dist_preprocess] != 0 && comm.size() > 1 &&
+            write_checkpoint.length() == 0;
     
-    t = MPI_Wtime();
+        t = MPI_Wtime();
     
-    abcd::scaling();
+        abcd::scaling();
 
-    LINFO << "> Time to scale the matrix: "
-          << MPI_Wtime() - t << "s.";
+        LINFO << "> Time to scale the matrix: "
+              << MPI_Wtime() - t << "s.";
 
-    t = MPI_Wtime();
+        t = MPI_Wtime();
     
-    abcd::partitionMatrix();
+        abcd::partitionMatrix();
+
+        LINFO << "> Time to partition the matrix: "
+              << MPI_Wtime() - t << "s.";
+
+        abcd::analyseFrame();
+    }
 
-    LINFO << "> Time to partition the matrix: "
-          << MPI_Wtime() - t << "s.";
+    if(write_checkpoint.length() != 0) abcd::writeCheckpoint();
 
-    abcd::analyseFrame();
     LINFO << "> Total time to preprocess: " << MPI_Wtime() - tot << "s.";
     LINFO << "*----------------------------------*";
 
@@ -249,6 +369,10 @@ int abcd::factorizeAugmentedSystems()
     }
     
     abcd::initializeDirectSolver();
+
+    // size the sumProject workspace once for all the iterations
+    if(instance_type == 0)
+        abcd::allocateWorkspace(icntl[Controls::block_size]);
     
     if(inter_comm.rank() == 0 && instance_type == 0)
         LINFO << "Launching MUMPS analysis";
@@ -272,6 +396,177 @@ int abcd::factorizeAugmentedSystems()
     return 0;
 }
 
+/// Refactorizes the augmented systems with new values for the same pattern
+int abcd::refactorizeMatrix()
+{
+    double t = MPI_Wtime();
+    int err = 0;
+    std::vector<std::vector<double> > part_vals;
+
+    if(icntl[Controls::dist_input] != 0) {
+        info[Controls::status] = -15;
+        throw std::runtime_error("The refactorization needs the matrix on the master, it is not available with a distributed matrix.");
+    }
+
+    if(comm.rank() == 0) {
+        LINFO << "*----------------------------------*";
+        LINFO << "> Starting Refactorization          ";
+
+        if(val == nullptr) {
+            LERROR << "val is not allocated";
+            err = -1;
+        }
+    }
+
+    // nothing is written before every check has passed, a failed job 7
+    // leaves A, the partitions and the factors of the previous matrix
+    CompRow_Mat_double new_A;
+    if(comm.rank() == 0 && err == 0) {
+        // the new values of A, with the scaling and the row permutation
+        // computed during the preprocessing
+        new_A = A;
+        int *rp = new_A.rowptr_ptr();
+        int *ci = new_A.colind_ptr();
+        double *v = new_A.val_ptr();
+
+        // the row pointers of A before the permutation
+        std::vector<int> a_ptr(m_o + 1, 0);
+        for(int i = 0; i < m_o; i++) {
+            int r = row_perm.size() != 0 ? row_perm[i] : i;
+            a_ptr[r + 1] = rp[i + 1] - rp[i];
+        }
+        for(int i = 0; i < m_o; i++) a_ptr[i + 1] += a_ptr[i];
+
+        #pragma omp parallel for
+        for(int i = 0; i < m_o; i++) {
+            int r = row_perm.size() != 0 ? row_perm[i] : i;
+            for(int j = 0; j < rp[i + 1] - rp[i]; j++) {
+                int k = a_entries.empty() ? a_ptr[r] + j : a_entries[a_ptr[r] + j];
+                v[rp[i] + j] = drow_[r] * val[k] * dcol_[ci[rp[i] + j]];
+            }
+        }
+
+        // the new values of the partitions, their structure is kept
+        err = refreshPartitions(new_A, part_vals);
+    }
+
+    mpi::broadcast(comm, err, 0);
+    if(err != 0) {
+        info[Controls::status] = err;
+        throw std::runtime_error("The matrix cannot be refactorized, its pattern has changed.");
+    }
+
+    std::vector<std::vector<double> > local_vals;
+    if(instance_type == 0) {
+        // the values are pushed to the masters
+        std::vector<int> local_parts;
+        if(comm.rank() == 0) {
+            for(int i = 1; i < parallel_cg; i++) {
+                for(unsigned int k = 0; k < partitionsSets[i].size(); k++) {
+                    int j = partitionsSets[i][k];
+
+                    inter_comm.send(i, 1, (int) part_vals[j].size());
+                    inter_comm.send(i, 5, &part_vals[j][0], part_vals[j].size());
+                }
+            }
+
+            if(parallel_cg != 1) local_parts = partitionsSets[0];
+            else for(int k = 0; k < nb_local_parts; k++) local_parts.push_back(k);
+        }
+
+        local_vals.resize(nb_local_parts);
+        for(int i = 0; i < nb_local_parts; i++) {
+            if(comm.rank() == 0) {
+                local_vals[i].swap(part_vals[local_parts[i]]);
+            } else {
+                int l_nz;
+                inter_comm.recv(0, 1, l_nz);
+                local_vals[i].resize(l_nz);
+                inter_comm.recv(0, 5, &local_vals[i][0], l_nz);
+            }
+
+            // a cancellation in the augmentation changes the pattern
+            if((int) local_vals[i].size() != partitions[i].NumNonzeros()) err = -14;
+        }
+        part_vals.clear();
+    }
+
+    int g_err;
+    mpi::all_reduce(comm, err, g_err, mpi::minimum<int>());
+    if(g_err != 0) {
+        info[Controls::status] = g_err;
+        throw std::runtime_error("The matrix cannot be refactorized, its pattern has changed.");
+    }
+
+    // every check has passed, the new values replace the old ones
+    if(comm.rank() == 0)
+        std::copy(new_A.val_ptr(), new_A.val_ptr() + new_A.NumNonzeros(), A.val_ptr());
+
+    if(instance_type == 0) {
+        for(int i = 0; i < nb_local_parts; i++)
+            std::copy(local_vals[i].begin(), local_vals[i].end(), partitions[i].val_ptr());
+        local_vals.clear();
+
+        // the user may have overwritten them with the global sizes
+        m = 0;
+        nz = 0;
+        for(int i = 0; i < nb_local_parts; i++){
+            m += partitions[i].dim(0);
+            nz += partitions[i].NumNonzeros();
+        }
+        n = n_l;
+    }
+
+    if(instance_type == 0) {
+        computeNrmMtx();
+
+        // same pattern, so only the values of the augmented systems change,
+        // in place: the analysis of MUMPS is kept
+        createAugmentedSystems(n_aug, nz_aug, irn_aug, jcn_aug, val_aug);
+    }
+
+    // S depends on the values, it is rebuilt during the next solve
+    int s_built = mumps_S.initialized ? 1 : 0;
+    mpi::broadcast(comm, s_built, 0);
+    if(s_built) {
+        mumps_S(-2);
+        mumps_S.initialized = false;
+        S_rows.clear();
+        S_cols.clear();
+        S_vals.clear();
+    }
+
+    if(instance_type == 0 && mumps_M.initialized) {
+        mumps_M(-2);
+        mumps_M.initialized = false;
+    }
+
+    // so does the coarse matrix
+    if(instance_type == 0 && mumps_E.initialized) {
+        mumps_E(-2);
+        mumps_E.initialized = false;
+    }
+
+    // the recycled basis belongs to the previous operator
+    rec_W.newsize(0, 0);
+    rec_HW.newsize(0, 0);
+    rec_size = 0;
+
+    if(IRANK == 0){
+        LINFO << "Values update time : " << MPI_Wtime() - t;
+        LINFO << "Launching MUMPS factorization";
+    }
+
+    t = MPI_Wtime();
+    abcd::factorizeAugmentedSystems(mumps);
+
+    if(IRANK == 0){
+        LINFO << "Factorization time : " << MPI_Wtime() - t;
+    }
+
+    return 0;
+}
+
 /// Runs either BCG or ABCD solve depending on what we want
 int abcd::solveSystem()
 {
@@ -283,6 +578,16 @@ int abcd::solveSystem()
         info[Controls::status] = -10;
         throw std::runtime_error("Block size should be at least one (1)");
     } 
+
+    // without a right-hand side, the master builds one from the whole matrix
+    if(icntl[Controls::dist_input] != 0) {
+        int no_rhs = comm.rank() == 0 && rhs == nullptr;
+        mpi::broadcast(comm, no_rhs, 0);
+        if(no_rhs) {
+            info[Controls::status] = -15;
+            throw std::runtime_error("The right-hand side has to be given with a distributed matrix");
+        }
+    }
     
     if(instance_type == 0) inter_comm.barrier();
     if(inter_comm.rank() == 0 && instance_type == 0){
@@ -298,13 +603,15 @@ int abcd::solveSystem()
             icntl[Controls::aug_type] = 0;
         }
 
-        // If we are running ABCD, we have to ensure that we have no block-size > 1
+        // ABCD is a direct solve, the block is exactly the nrhs columns
+        // (distributeRhs raises the block-size to nrhs)
         if(icntl[Controls::aug_type] == 0 ||
 #ifdef WIP
            icntl[Controls::aug_project] != 0 ||
 #endif //WIP
            runSolveS){
             abcd::distributeRhs();
+            abcd::distributeX0();
             abcd::bcg(B);
         } else{
             int temp_bs = icntl[Controls::block_size];
@@ -363,6 +670,11 @@ int abcd::operator()(int job_id)
         throw std::runtime_error("Did you forget to call job_id = 2? ");
     }
 
+    if ( job_id == 7 && last_called_job != 2 && last_called_job != 3 ) {
+        info[Controls::status] = -2;
+        throw std::runtime_error("Did you forget to call job_id = 2? ");
+    }
+
     if ( job_id < last_called_job && job_id != 3) {
         info[Controls::status] = -2;
         throw std::runtime_error("You cannot go back in time");
@@ -453,6 +765,14 @@ int abcd::operator()(int job_id)
 
         break;
 
+    case 7:
+        refactorizeMatrix();
+
+        // the solve can be called again, as well as a new refactorization
+        last_called_job = 2;
+
+        break;
+
     default:
         // Wrong job id
         info[Controls::status] = -1;
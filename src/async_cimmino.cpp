@@ -0,0 +1,317 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#include <abcd.h>
+
+#include <iostream>
+
+namespace {
+
+/// The exchanges of the contributions with the masters sharing columns
+///
+/// One message in flight per neighbour and direction, the contributions
+/// produced meanwhile are summed in acc. The first entry of a message is
+/// set on the last message of the solve.
+struct AsyncExchange {
+    MPI_Comm comm;
+    int tag;
+    int nrhs;
+    std::vector<int> nbrs;
+    std::vector<std::vector<int> *> cols;
+    std::vector<std::vector<double> > acc, sbuf, rbuf;
+    std::vector<MPI_Request> sreq, rreq;
+    std::vector<bool> pending, finished;
+
+    /// Posts the first receives, the neighbours and their columns are set
+    void start()
+    {
+        int nb = nbrs.size();
+        acc.resize(nb);
+        sbuf.resize(nb);
+        rbuf.resize(nb);
+        sreq.assign(nb, MPI_REQUEST_NULL);
+        rreq.assign(nb, MPI_REQUEST_NULL);
+        pending.assign(nb, false);
+        finished.assign(nb, false);
+        for(int k = 0; k < nb; k++) {
+            int len = cols[k]->size() * nrhs;
+            acc[k].assign(len, 0);
+            sbuf[k].assign(len + 1, 0);
+            rbuf[k].assign(len + 1, 0);
+            MPI_Irecv(&rbuf[k][0], len + 1, MPI_DOUBLE, nbrs[k], tag, comm, &rreq[k]);
+        }
+    }
+
+    /// Applies to x the contributions of the neighbours that arrived,
+    /// weighted by wgt, returns the number of neighbours whose last
+    /// message arrived
+    int receive(bool wait, double *xp, int xlda, const std::vector<double> &wgt)
+    {
+        int nb_finished = 0;
+        for(size_t k = 0; k < nbrs.size(); k++) {
+            while(!finished[k]) {
+                int flag = 0;
+                if(wait) {
+                    MPI_Wait(&rreq[k], MPI_STATUS_IGNORE);
+                    flag = 1;
+                } else {
+                    MPI_Test(&rreq[k], &flag, MPI_STATUS_IGNORE);
+                }
+                if(!flag) break;
+
+                std::vector<int> &c_k = *cols[k];
+                int len = c_k.size();
+                for(int j = 0; j < nrhs; j++) {
+                    for(int i = 0; i < len; i++) {
+                        int c = c_k[i];
+                        xp[c + j * xlda] += wgt[c] * rbuf[k][1 + i + j * len];
+                    }
+                }
+
+                if(rbuf[k][0] != 0) {
+                    finished[k] = true;
+                } else {
+                    MPI_Irecv(&rbuf[k][0], len * nrhs + 1, MPI_DOUBLE, nbrs[k], tag,
+                              comm, &rreq[k]);
+                }
+            }
+            if(finished[k]) nb_finished++;
+        }
+        return nb_finished;
+    }
+
+    /// Sends the accumulated contributions to the neighbours that are
+    /// not busy with the previous message
+    void send(bool last)
+    {
+        for(size_t k = 0; k < nbrs.size(); k++) {
+            if(sreq[k] != MPI_REQUEST_NULL) {
+                if(last) {
+                    MPI_Wait(&sreq[k], MPI_STATUS_IGNORE);
+                } else {
+                    int flag = 0;
+                    MPI_Test(&sreq[k], &flag, MPI_STATUS_IGNORE);
+                    if(!flag) continue;
+                }
+            }
+            if(!pending[k] && !last) continue;
+
+            int len = acc[k].size();
+            sbuf[k][0] = last ? 1 : 0;
+            std::copy(acc[k].begin(), acc[k].end(), sbuf[k].begin() + 1);
+            std::fill(acc[k].begin(), acc[k].end(), 0);
+            pending[k] = false;
+
+            MPI_Isend(&sbuf[k][0], len + 1, MPI_DOUBLE, nbrs[k], tag, comm, &sreq[k]);
+        }
+    }
+};
+
+} // namespace
+
+/// Uses asynchronous relaxed block Cimmino to solve Hx = k where H is
+/// the sum of projectors
+///
+/// Each master iterates at its own pace on its copy of its columns:
+/// x_j += omega / s_j * Delta_j, s_j being the number of partitions
+/// sharing the column j. Its own projections are applied at once and
+/// sent to the masters sharing the columns, coalesced while the
+/// previous message is in flight, the ones of the other masters are
+/// applied when they arrive. As the updates are additive, all the
+/// copies of a column get the same updates and agree once the messages
+/// are drained. A round of non-blocking reductions of the local
+/// backward errors replaces the global rho check, all the masters stop
+/// at the end of the same round.
+/// \param b The right-hand side
+void abcd::asyncCimmino(MV_ColMat_double &b)
+{
+    std::streamsize oldprec = std::cout.precision();
+
+    const double threshold = dcntl[Controls::threshold];
+    const int itmax = icntl[Controls::itmax];
+    const double omega = dcntl[Controls::async_omega] > 0 ? dcntl[Controls::async_omega] : 1;
+    const int tag = 81;
+
+    MV_ColMat_double u(m, nrhs, 0);
+    startAcceleration(b, u);
+
+    allocateWorkspace(nrhs);
+
+    // the neighbours and the columns shared with each of them
+    AsyncExchange ex;
+    ex.comm = (MPI_Comm) inter_comm;
+    ex.tag = tag;
+    ex.nrhs = nrhs;
+    for(std::map<int, std::vector<int> >::iterator it = col_interconnections.begin();
+            it != col_interconnections.end(); ++it) {
+        if(it->second.size() == 0) continue;
+        ex.nbrs.push_back(it->first);
+        ex.cols.push_back(&it->second);
+    }
+    std::vector<int> &nbrs = ex.nbrs;
+    std::vector<std::vector<int> *> &nbr_cols = ex.cols;
+    int nb_nbrs = nbrs.size();
+
+    // the relaxation weights omega / s_j
+    std::vector<double> wgt(n);
+    {
+        std::vector<std::vector<double> > mine(nb_nbrs), theirs(nb_nbrs);
+        std::vector<mpi::request> reqs;
+        for(int k = 0; k < nb_nbrs; k++) {
+            for(size_t i = 0; i < nbr_cols[k]->size(); i++) {
+                int c = (*nbr_cols[k])[i];
+                mine[k].push_back(delta_src_ptr[c + 1] - delta_src_ptr[c]);
+            }
+            theirs[k].resize(mine[k].size());
+            reqs.push_back(inter_comm.irecv(nbrs[k], tag, &theirs[k][0], theirs[k].size()));
+            reqs.push_back(inter_comm.isend(nbrs[k], tag, &mine[k][0], mine[k].size()));
+        }
+        mpi::wait_all(reqs.begin(), reqs.end());
+
+        for(int i = 0; i < n; i++) wgt[i] = delta_src_ptr[i + 1] - delta_src_ptr[i];
+        for(int k = 0; k < nb_nbrs; k++) {
+            for(size_t i = 0; i < nbr_cols[k]->size(); i++) {
+                wgt[(*nbr_cols[k])[i]] += theirs[k][i];
+            }
+        }
+        for(int i = 0; i < n; i++) wgt[i] = wgt[i] > 0 ? omega / wgt[i] : 0;
+    }
+
+    ex.start();
+
+    double *xp = Xk.ptr();
+    int xlda = Xk.lda();
+    double *dpt = &ws_delta[0];
+
+    // [rho_1 ... rho_nrhs | busy], reduced with a maximum
+    std::vector<double> loc(nrhs + 1, 0), glob(nrhs + 1, 0);
+    MPI_Request term_req = MPI_REQUEST_NULL;
+    VECTOR_double nrmR(nrhs, 0);
+
+    int it = 0;
+    int rounds = 0;
+    double rho = 1;
+    double t1_total = 0;
+    double t_idle = 0;
+    double ti = MPI_Wtime();
+
+    while(true) {
+        if(it < itmax) {
+            // Delta = A^+ (b - A x) on the local partitions
+            double t1 = MPI_Wtime();
+            solveLocalProjections(1e0, u, -1e0, Xk, nrhs, &nrmR);
+            gatherDelta(boundary_cols, nrhs);
+            gatherDelta(interior_cols, nrhs);
+            t1_total += MPI_Wtime() - t1;
+
+            for(int j = 0; j < nrhs; j++) {
+                for(int i = 0; i < n; i++) {
+                    xp[i + j * xlda] += wgt[i] * dpt[i + j * n];
+                }
+            }
+
+            for(int k = 0; k < nb_nbrs; k++) {
+                std::vector<int> &cols = *nbr_cols[k];
+                int len = cols.size();
+                for(int j = 0; j < nrhs; j++) {
+                    for(int i = 0; i < len; i++) {
+                        ex.acc[k][i + j * len] += dpt[cols[i] + j * n];
+                    }
+                }
+                ex.pending[k] = true;
+            }
+            it++;
+        } else {
+            double t = MPI_Wtime();
+            ex.receive(false, xp, xlda, wgt);
+            t_idle += MPI_Wtime() - t;
+        }
+
+        ex.send(false);
+        ex.receive(false, xp, xlda, wgt);
+
+        // termination
+        if(term_req != MPI_REQUEST_NULL) {
+            int flag = 0;
+            MPI_Test(&term_req, &flag, MPI_STATUS_IGNORE);
+            if(!flag) continue;
+
+            rounds++;
+            rho = glob[0];
+            for(int j = 1; j < nrhs; j++) rho = std::min(rho, glob[j]);
+
+            if(comm.rank() == 0 && icntl[Controls::verbose_level] >= 2) {
+                int ev = icntl[Controls::verbose_level] >= 3 ? 1 : 10;
+                LOG_EVERY_N(ev, INFO) << "ROUND " << rounds << " (local iteration " << it <<
+                    ") rho <= " << scientific << rho << setprecision(oldprec);
+            }
+
+            if(rho < threshold || glob[nrhs] == 0) break;
+        }
+
+        // the local backward error of the last projections, an upper
+        // bound on the contribution of this master to the global one
+        for(int j = 0; j < nrhs; j++) {
+            double x_j = 0;
+            for(int i = 0; i < n; i++) {
+                if(comm_map[i] == 1) x_j += abs(xp[i + j * xlda]);
+            }
+            loc[j] = nrmR(j) / (nrmMtx * x_j + nrmB[j]);
+        }
+        loc[nrhs] = it < itmax ? 1 : 0;
+
+        MPI_Iallreduce(&loc[0], &glob[0], nrhs + 1, MPI_DOUBLE, MPI_MAX,
+                       (MPI_Comm) inter_comm, &term_req);
+    }
+
+    // drain the exchanges so that all the copies agree
+    ex.send(true);
+    ex.receive(true, xp, xlda, wgt);
+    for(int k = 0; k < nb_nbrs; k++) MPI_Wait(&ex.sreq[k], MPI_STATUS_IGNORE);
+
+    rho = compute_rho(Xk, u);
+    normres.push_back(rho);
+
+    int it_max = 0, it_min = 0;
+    mpi::all_reduce(inter_comm, it, it_max, mpi::maximum<int>());
+    mpi::all_reduce(inter_comm, it, it_min, mpi::minimum<int>());
+
+    if(inter_comm.rank() == 0) {
+        LINFO2 << "Async Rho: " << scientific << rho ;
+        LINFO2 << "Async Iterations : " << it_min << " to " << it_max ;
+        LINFO2 << "Async Termination rounds : " << rounds ;
+        LINFO2 << "Async TIME : " << setprecision(2) << MPI_Wtime() - ti ;
+        LINFO2 << "SumProject time : " << t1_total ;
+        LINFO2 << "Idle time : " << t_idle ;
+    }
+    endAcceleration(it_max);
+}
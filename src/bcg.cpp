@@ -35,19 +35,55 @@
 
 #include <iostream>
 
+/// The 2-norms of the columns of prod_gamma, as the columns of r are
+/// orthonormal they are the norms of the residuals of the projected system
+static void gammaNorms(MV_ColMat_double &prod_gamma, std::vector<double> &nrm)
+{
+    for(int j = 0; j < prod_gamma.dim(1); j++) {
+        double s = 0;
+        for(int i = 0; i < prod_gamma.dim(0); i++)
+            s += prod_gamma(i, j) * prod_gamma(i, j);
+        nrm[j] = sqrt(s);
+    }
+}
+
 /// Uses Block-CG to solve Hx = k where H is the sum of projectors
 ///  and k is \sum A_i^+ b_i
 ///
-/// The block-size is defined in icntl[Controls::block_size]
+/// The block-size is defined in icntl[Controls::block_size], the
+/// other accelerations are selected with icntl[Controls::acceleration]
 /// \param b The right-hand side
 void abcd::bcg(MV_ColMat_double &b)
 {
+    if(icntl[Controls::kaczmarz] == 2 && icntl[Controls::aug_type] == 0) {
+        abcd::kaczmarzSweeps(b);
+        return;
+    }
+    if(icntl[Controls::two_level] != 0 && icntl[Controls::kaczmarz] == 0) {
+        abcd::twoLevelCG(b);
+        return;
+    }
+    if(icntl[Controls::acceleration] == 1) {
+        abcd::pipelinedCG(b);
+        return;
+    }
+    if(icntl[Controls::acceleration] == 2) {
+        abcd::chebyshev(b);
+        return;
+    }
+    if(icntl[Controls::acceleration] == 3) {
+        abcd::asyncCimmino(b);
+        return;
+    }
+
     std::streamsize oldprec = std::cout.precision();
     double t1_total, t2_total;
     
     const double threshold = dcntl[Controls::threshold];
     const int block_size = icntl[Controls::block_size];
     const int itmax = icntl[Controls::itmax];
+    const int check_interval = std::max(1, icntl[Controls::check_interval]);
+    const bool recycling = icntl[Controls::recycle] > 0;
 
     // s is the block size of the current run
     int s = std::max<int>(block_size, nrhs);
@@ -111,7 +147,10 @@ void abcd::bcg(MV_ColMat_double &b)
 
     t1_total = MPI_Wtime();
     if(use_xk) {
-        MV_ColMat_double sp = sumProject(1e0, b, -1e0, Xk);
+        // Xk has nrhs columns and b has s, the extra columns start from 0
+        MV_ColMat_double xs(n, s, 0);
+        xs.setCols(Xk, 0, nrhs);
+        MV_ColMat_double sp = sumProject(1e0, b, -1e0, xs);
         r.setCols(sp, 0, s);
     } else {
         MV_ColMat_double sp = sumProject(1e0, b, 0, Xk);
@@ -120,6 +159,14 @@ void abcd::bcg(MV_ColMat_double &b)
 
     t1_total = MPI_Wtime() - t1_total;
 
+    // start from the projection on the recycled basis
+    bool deflate = recycling && rec_size > 0;
+    if(deflate) deflateStart(r);
+
+    // room for the directions gathered to extract the next basis
+    std::vector<MV_ColMat_double> rec_p, rec_qp;
+    int rec_room = recycling ? recycleBudget() - rec_size : 0;
+
     // orthogonalize
     // r = r*gamma^-1
 #ifdef WIP
@@ -132,6 +179,7 @@ void abcd::bcg(MV_ColMat_double &b)
     }
 
     p = r;
+    if(deflate) deflateDirection(r, p);
     {
         MV_ColMat_double gu = gammak(MV_VecIndex(0, nrhs -1), MV_VecIndex(0, nrhs -1));
         prod_gamma = upperMat(gu);
@@ -151,9 +199,19 @@ void abcd::bcg(MV_ColMat_double &b)
         LINFO2 << "ITERATION 0  rho = " << scientific << rho << setprecision(oldprec);
     }
         
+    // the workspace is sized by now, the iterations should not allocate
+    double ws_iter_max = 0;
+
+    // last exact rho and the projected residual norms at that time
+    double rho_ref = rho;
+    int nb_checks = 1;
+    std::vector<double> est(nrhs), est_ref(nrhs);
+    gammaNorms(prod_gamma, est_ref);
+
     while(true) {
         it++;
         double t = MPI_Wtime();
+        double ws_before = ws_bytes;
 
         // qp = Hp
         qp = sumProject(0e0, b, 1e0, p);
@@ -169,6 +227,13 @@ void abcd::bcg(MV_ColMat_double &b)
         if(gqr(p, qp, betak, s, true) != 0){
             gmgs2(p, qp, betak, s, true);
         }
+
+        // p is now H-orthonormal and qp = Hp
+        if(rec_room >= s) {
+            rec_p.push_back(p);
+            rec_qp.push_back(qp);
+            rec_room -= s;
+        }
         lambdak = e1;
 
         dtrsm_(&left, &up, &tr, &notr, &s, &nrhs, &alpha, betak_ptr, &s, l_ptr, &s);
@@ -182,11 +247,33 @@ void abcd::bcg(MV_ColMat_double &b)
             pl(MV_VecIndex(0, pl.dim(0)-1), MV_VecIndex(0, nrhs - 1));
 
         double t2 = MPI_Wtime();
-        rho = abcd::compute_rho(Xk, u);
+        bool exact = (it % check_interval == 0) || (it >= itmax);
+        if(!exact) {
+            // scale the last exact rho by the reduction of the projected
+            // residual since then, prod_gamma is one iteration behind Xk
+            gammaNorms(prod_gamma, est);
+            double red = 1;
+            for(int j = 0; j < nrhs; ++j) {
+                double rj = est_ref[j] > 0 ? est[j] / est_ref[j] : 0;
+                red = j == 0 ? rj : std::min(red, rj);
+            }
+            rho = rho_ref * red;
+
+            // confirm a convergence with the exact value
+            exact = rho < thresh;
+        }
+        if(exact) {
+            rho = abcd::compute_rho(Xk, u);
+            rho_ref = rho;
+            gammaNorms(prod_gamma, est_ref);
+            nb_checks++;
+        }
         t2 = MPI_Wtime() - t2;
         normres.push_back(rho);
 
-        if((rho < thresh) || (it >= itmax)) break;
+        ws_iter_max = std::max(ws_iter_max, ws_bytes - ws_before);
+
+        if(exact && ((rho < thresh) || (it >= itmax))) break;
 
         // R = R - QP * B^-T
         dtrsm_(&right, &up, &tr, &notr, &n, &s, &alpha, betak_ptr, &s, qp_ptr, &n);
@@ -213,6 +300,7 @@ void abcd::bcg(MV_ColMat_double &b)
         betak = gemmColMat(bu, gammak, false, true);
 
         p = r + gemmColMat(p, betak);
+        if(deflate) deflateDirection(r, p);
 
         //mpi::all_gather(inter_comm, rho, grho);
         //mrho = *std::max_element(grho.begin(), grho.end());
@@ -230,13 +318,23 @@ void abcd::bcg(MV_ColMat_double &b)
         t2_total += t2;
     }
 
+    if(recycling) updateRecycleBasis(rec_p, rec_qp);
+
     if(inter_comm.rank() == 0) {
         LINFO2 << "BCG Rho: " << scientific << rho ;
         LINFO2 << "BCG Iterations : " << setprecision(2) << it ;
         LINFO2 << "BCG TIME : " << MPI_Wtime() - ti ;
         LINFO2 << "SumProject time : " << t1_total ;
         LINFO2 << "Rho Computation time : " << t2_total ;
+        LINFO2 << "Exact Rho computations : " << nb_checks ;
+        if(recycling)
+            LINFO2 << "Recycled vectors : " << rec_size ;
+        LINFO2 << "Workspace bytes : " << ws_bytes
+               << " (max per iteration: " << ws_iter_max << ")";
     }
+    dinfo[Controls::ws_bytes] = ws_bytes;
+    dinfo[Controls::ws_iter_bytes] = ws_iter_max;
+    info[Controls::nb_backward] = nb_checks;
     if (icntl[Controls::aug_type] != 0)
         return;
 
@@ -252,13 +350,19 @@ void abcd::bcg(MV_ColMat_double &b)
 
 double abcd::compute_rho(MV_ColMat_double &x, MV_ColMat_double &u)
 {
-    double rho = 999.999, minNrmR = 999.999;
-    int min_j = 0;
-    
     VECTOR_double nrmX(nrhs, 0);
     VECTOR_double nrmR(nrhs, 0);
 
     abcd::get_nrmres(x, u, nrmR, nrmX);
+
+    return compute_rho(nrmR, nrmX);
+}
+
+/// Computes the backward error from the already reduced norms
+double abcd::compute_rho(VECTOR_double &nrmR, VECTOR_double &nrmX)
+{
+    double rho = 999.999, minNrmR = 999.999;
+    int min_j = 0;
     
     double temp_rho = 0;
     for(int j = 0; j < nrhs; ++j) {
@@ -277,6 +381,89 @@ double abcd::compute_rho(MV_ColMat_double &x, MV_ColMat_double &u)
     return rho;
 }
 
+/// The common start of the accelerations other than the block-CG: checks
+/// itmax, starts Xk from zero unless it is given, takes the nrhs first
+/// columns of b in u and syncs their norms in nrmB and the norm of the
+/// matrix
+void abcd::startAcceleration(MV_ColMat_double &b, MV_ColMat_double &u)
+{
+    if (icntl[Controls::itmax] < 0) {
+        info[Controls::status] = -11;
+        mpi::broadcast(intra_comm, info[Controls::status], 0);
+
+        throw std::runtime_error("Max iter number should be at least zero (0)");
+    }
+
+    if(!use_xk) {
+        Xk = MV_ColMat_double(n, nrhs, 0);
+    }
+
+    // get a reference to the nrhs first columns
+    u = b(MV_VecIndex(0, b.dim(0)-1), MV_VecIndex(0,nrhs-1));
+
+    nrmB = std::vector<double>(nrhs, 0);
+
+    for(int j = 0; j < nrhs; ++j) {
+        VECTOR_double u_j = u(j);
+        double lnrmBs = infNorm(u_j);
+
+        // Sync B norm :
+        mpi::all_reduce(inter_comm, &lnrmBs, 1,  &nrmB[0] + j, mpi::maximum<double>());
+    }
+
+    mpi::broadcast(inter_comm, nrmMtx, 0);
+}
+
+/// The common end of the accelerations other than the block-CG: ABCD
+/// goes on with Xk, otherwise the solution is centralized on the master
+/// \param it The number of iterations to report
+void abcd::endAcceleration(int it)
+{
+    if (icntl[Controls::aug_type] != 0)
+        return;
+
+    info[Controls::nb_iter] = it;
+
+    if(IRANK == 0) {
+        solution = MV_ColMat_double(n_o, nrhs, 0);
+        sol = solution.ptr();
+    }
+
+    centralizeVector(sol, n_o, nrhs, Xk.ptr(), n, nrhs, glob_to_local_ind, &dcol_[0]);
+}
+
+/// The global inner products of the columns of W and V, each master
+/// contributes its owned rows
+/// \param dots W^T V in column-major order, or with diag only the
+/// products of the columns with the same index
+void abcd::globalDot(MV_ColMat_double &W, MV_ColMat_double &V, double *dots, bool diag)
+{
+    int k = W.dim(1);
+    int s = V.dim(1);
+    int len = diag ? s : k * s;
+    std::vector<double> loc(len, 0);
+
+    double *w_ptr = W.ptr();
+    double *v_ptr = V.ptr();
+    int lda_w = W.lda();
+    int lda_v = V.lda();
+    int nr = W.dim(0);
+
+    for(int j = 0; j < s; j++) {
+        int first = diag ? j : 0;
+        int last = diag ? j + 1 : k;
+        for(int c = first; c < last; c++) {
+            double d = 0;
+            for(int i = 0; i < nr; i++) {
+                if(comm_map[i] == 1) d += w_ptr[i + c * lda_w] * v_ptr[i + j * lda_v];
+            }
+            loc[diag ? j : c + j * k] = d;
+        }
+    }
+
+    mpi::all_reduce(inter_comm, &loc[0], len, dots, std::plus<double>());
+}
+
 void abcd::gmgs2(MV_ColMat_double &P, MV_ColMat_double &AP, MV_ColMat_double &R, int s, bool use_a)
 {
 
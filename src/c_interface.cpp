@@ -26,9 +26,14 @@ struct abcd_solver* new_solver()
     solver->irn = obj->irn;
     solver->jcn = obj->jcn;
     solver->val = obj->val;
+    solver->row_ptr = obj->row_ptr;
+    solver->write_checkpoint = NULL;
+    solver->read_checkpoint = NULL;
     solver->rhs = obj->rhs;
+    solver->x0 = obj->x0;
     solver->nrhs = obj->nrhs;
     solver->start_index = obj->start_index;
+    solver->row_offset = obj->row_offset;
 
     return solver;
 }
@@ -42,11 +47,16 @@ void call_solver(struct abcd_solver* solver, int job_id)
     obj->irn = solver->irn;
     obj->jcn = solver->jcn;
     obj->val = solver->val;
+    obj->row_ptr = solver->row_ptr;
     obj->rhs = solver->rhs;
+    obj->x0 = solver->x0;
     obj->nrhs = solver->nrhs;
     obj->start_index = solver->start_index;
+    obj->row_offset = solver->row_offset;
     
     // obj->write_problem = string(solver->write_problem);
+    if(solver->write_checkpoint != NULL) obj->write_checkpoint = solver->write_checkpoint;
+    if(solver->read_checkpoint != NULL) obj->read_checkpoint = solver->read_checkpoint;
 
     for(size_t i = 0; i < obj -> icntl.size(); i++){
         obj -> icntl[i] = solver -> icntl[i];
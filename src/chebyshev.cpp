@@ -0,0 +1,292 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#include <abcd.h>
+#include "blas.h"
+
+#include <iostream>
+
+/// The extreme eigenvalues of the Lanczos tridiagonal matrix built from
+/// the CG coefficients alpha and beta
+static void lanczosBounds(std::vector<double> &alpha, std::vector<double> &beta,
+                          double &lmin, double &lmax)
+{
+    int k = alpha.size();
+    std::vector<double> T(k * k, 0);
+
+    for(int j = 0; j < k; j++) {
+        T[j + j * k] = 1 / alpha[j];
+        if(j > 0) T[j + j * k] += beta[j - 1] / alpha[j - 1];
+        if(j < k - 1) {
+            T[j + 1 + j * k] = sqrt(beta[j]) / alpha[j];
+            T[j + (j + 1) * k] = T[j + 1 + j * k];
+        }
+    }
+
+    char novec = 'N';
+    char low = 'L';
+    int ierr = 0;
+    int lwork = 3 * k;
+    std::vector<double> ev(k), work(lwork);
+    dsyev_(&novec, &low, &k, &T[0], &k, &ev[0], &work[0], &lwork, &ierr);
+
+    lmin = ev[0];
+    lmax = ev[k - 1];
+}
+
+/// Uses Chebyshev semi-iterations to solve Hx = k where H is the sum
+/// of projectors
+///
+/// A few CG steps estimate the extreme eigenvalues of H through their
+/// Lanczos tridiagonal matrix, then the Chebyshev iterations need
+/// only the sums of projections. The Ritz values overestimate the
+/// bottom of the spectrum, the lower bound is lowered from the observed
+/// reduction when it is too slow. The global reductions are limited to
+/// the backward error, computed every icntl[Controls::check_interval]
+/// iterations, 10 by default. All the right-hand sides share the same polynomial.
+/// \param b The right-hand side
+void abcd::chebyshev(MV_ColMat_double &b)
+{
+    std::streamsize oldprec = std::cout.precision();
+
+    const double threshold = dcntl[Controls::threshold];
+    const int itmax = icntl[Controls::itmax];
+    // by default do not pay a reduction per iteration for the stopping
+    // criterion only, the iterations themselves need none
+    const int check_interval = icntl[Controls::check_interval] > 0 ? icntl[Controls::check_interval] : 10;
+    const int nb_lanczos = icntl[Controls::cheb_lanczos] > 0 ? icntl[Controls::cheb_lanczos] : 20;
+
+    // the sum of nbparts projectors has its spectrum in [0, nbparts]
+    const double lmax_bound = icntl[Controls::nbparts];
+
+    MV_ColMat_double u(m, nrhs, 0);
+    startAcceleration(b, u);
+
+    MV_ColMat_double r(n, nrhs, 0);
+    MV_ColMat_double d(n, nrhs, 0);
+    MV_ColMat_double q(n, nrhs, 0);
+
+    double t1_total = MPI_Wtime();
+
+    // r = k - Hx
+    if(use_xk) {
+        r = sumProject(1e0, u, -1e0, Xk);
+    } else {
+        r = sumProject(1e0, u, 0, Xk);
+    }
+    t1_total = MPI_Wtime() - t1_total;
+    double t2_total = 0;
+
+    double *xp = Xk.ptr(), *rp = r.ptr(), *dp = d.ptr(), *qp = q.ptr();
+    int xlda = Xk.lda();
+
+    int it = 0;
+    double rho = 1;
+    int nb_checks = 0;
+    double ti = MPI_Wtime();
+
+    // **************************************************
+    // CG steps, their coefficients give the spectrum  *
+    // **************************************************
+
+    std::vector<std::vector<double> > alphas(nrhs), betas(nrhs);
+    std::vector<double> gamma(nrhs), delta(nrhs), gamma_new(nrhs);
+    std::vector<bool> active(nrhs, true);
+
+    d = r;
+    globalDot(r, r, &gamma[0], true);
+
+    for(int l = 0; l < nb_lanczos && it < itmax; l++) {
+        double t1 = MPI_Wtime();
+        q = sumProject(0e0, u, 1e0, d);
+        t1_total += MPI_Wtime() - t1;
+
+        globalDot(d, q, &delta[0], true);
+
+        bool any = false;
+        for(int j = 0; j < nrhs; j++) {
+            if(gamma[j] == 0 || delta[j] <= 0) active[j] = false;
+            any = any || active[j];
+        }
+        if(!any) break;
+
+        for(int j = 0; j < nrhs; j++) {
+            double a = active[j] ? gamma[j] / delta[j] : 0;
+            if(active[j]) alphas[j].push_back(a);
+            for(int i = 0; i < n; i++) {
+                xp[i + j * xlda] += a * dp[i + j * n];
+                rp[i + j * n] -= a * qp[i + j * n];
+            }
+        }
+        it++;
+
+        globalDot(r, r, &gamma_new[0], true);
+        for(int j = 0; j < nrhs; j++) {
+            if(!active[j]) continue;
+            double be = gamma_new[j] / gamma[j];
+            betas[j].push_back(be);
+            for(int i = 0; i < n; i++) {
+                dp[i + j * n] = rp[i + j * n] + be * dp[i + j * n];
+            }
+            gamma[j] = gamma_new[j];
+        }
+    }
+
+    // the interval covering the spectra of all the columns
+    double lmin = lmax_bound, lmax = 0;
+    for(int j = 0; j < nrhs; j++) {
+        if(alphas[j].size() == 0) continue;
+        double cmin, cmax;
+        lanczosBounds(alphas[j], betas[j], cmin, cmax);
+        lmin = std::min(lmin, cmin);
+        lmax = std::max(lmax, cmax);
+    }
+
+    // the Ritz values are inside the spectrum, a small lmin only slows
+    // down the convergence while a small lmax makes it diverge
+    lmax = std::min(lmax_bound, 1.05 * lmax);
+    if(lmin <= 0 || lmin >= lmax) lmin = lmax * 1e-3;
+
+    if(comm.rank() == 0) {
+        LINFO2 << "Chebyshev interval : [" << scientific << lmin << ", " << lmax << "]"
+               << setprecision(oldprec);
+    }
+
+    // **************************************************
+    // Chebyshev iterations                            *
+    // **************************************************
+
+    double t2 = MPI_Wtime();
+    rho = compute_rho(Xk, u);
+    t2_total += MPI_Wtime() - t2;
+    nb_checks++;
+    normres.push_back(rho);
+
+    double rho_check = rho;
+    bool restart = true;
+    double theta = 0, dlt = 0, sigma = 0, rho_k = 0;
+    // the checks since the last restart, the first one is a transient
+    int nb_since = 0;
+
+    while(!(rho < threshold) && it < itmax) {
+        double t = MPI_Wtime();
+
+        if(restart) {
+            theta = (lmax + lmin) / 2;
+            dlt = (lmax - lmin) / 2;
+            sigma = theta / dlt;
+            rho_k = 1 / sigma;
+
+            // d = r / theta
+            for(int i = 0; i < n * nrhs; i++) dp[i] = rp[i] / theta;
+            restart = false;
+            nb_since = 0;
+        }
+
+        // x = x + d, r = r - Hd
+        double t1 = MPI_Wtime();
+        q = sumProject(0e0, u, 1e0, d);
+        t1 = MPI_Wtime() - t1;
+
+        double rho_n = 1 / (2 * sigma - rho_k);
+        for(int j = 0; j < nrhs; j++) {
+            for(int i = 0; i < n; i++) {
+                xp[i + j * xlda] += dp[i + j * n];
+                rp[i + j * n] -= qp[i + j * n];
+                dp[i + j * n] = rho_n * rho_k * dp[i + j * n] + 2 * rho_n / dlt * rp[i + j * n];
+            }
+        }
+        rho_k = rho_n;
+        it++;
+
+        t2 = MPI_Wtime();
+        if(it % check_interval == 0 || it >= itmax) {
+            rho = compute_rho(Xk, u);
+            nb_checks++;
+            normres.push_back(rho);
+
+            // the interval misses the top of the spectrum, widen it and
+            // restart the recurrence from the true residual
+            if(rho > 2 * rho_check && lmax < lmax_bound) {
+                if(comm.rank() == 0)
+                    LWARNING << "Chebyshev diverges, raising the upper bound to " << lmax_bound;
+                lmax = lmax_bound;
+
+                double tr = MPI_Wtime();
+                r = sumProject(1e0, u, -1e0, Xk);
+                t1 += MPI_Wtime() - tr;
+                restart = true;
+            } else if(nb_since++ > 0 && rho < rho_check) {
+                // the Ritz values are above the bottom of the spectrum,
+                // an eigenvalue l below lmin is reduced by about
+                // exp(-l / sqrt(lmin lmax)) per iteration. When the
+                // reduction is much slower than the one of the interval,
+                // lower lmin to that l and restart the recurrence
+                double rate = std::log(rho_check / rho) / check_interval;
+                double expected = 2 * std::sqrt(lmin / lmax);
+                double l = rate * std::sqrt(lmin * lmax);
+                if(rate < expected / 4 && l < lmin / 2) {
+                    if(comm.rank() == 0)
+                        LINFO2 << "Chebyshev stalls, lowering the lower bound to "
+                               << scientific << l << setprecision(oldprec);
+                    lmin = l;
+                    restart = true;
+                }
+            }
+            rho_check = rho;
+        }
+        t2 = MPI_Wtime() - t2;
+
+        t1_total += t1;
+        t2_total += t2;
+
+        t = MPI_Wtime() - t;
+        if(comm.rank() == 0 && icntl[Controls::verbose_level] >= 2) {
+            int ev = icntl[Controls::verbose_level] >= 3 ? 1 : 10;
+            LOG_EVERY_N(ev, INFO) << "ITERATION " << it <<
+                " rho = " << scientific << rho <<
+                "  Timings: " << setprecision(2) << t <<
+                setprecision(oldprec); // put precision back to what it was before
+        }
+    }
+
+    if(inter_comm.rank() == 0) {
+        LINFO2 << "Chebyshev Rho: " << scientific << rho ;
+        LINFO2 << "Chebyshev Iterations : " << setprecision(2) << it ;
+        LINFO2 << "Chebyshev TIME : " << MPI_Wtime() - ti ;
+        LINFO2 << "SumProject time : " << t1_total ;
+        LINFO2 << "Rho Computation time : " << t2_total ;
+        LINFO2 << "Exact Rho computations : " << nb_checks ;
+    }
+    info[Controls::nb_backward] = nb_checks;
+    endAcceleration(it);
+}
@@ -35,9 +35,8 @@
 
 void abcd::initializeDirectSolver()
 {
-    int *sym_perm;
-
     mpi::broadcast(comm, icntl[Controls::nbparts], 0);
+    info[Controls::nb_orderings] = 0;
     
     if(comm.size() > parallel_cg) {
         if(instance_type == 0) {
@@ -55,9 +54,9 @@ void abcd::initializeDirectSolver()
             if(inter_comm.rank() == 0 && instance_type == 0)
                 LINFO << "Launching Initial MUMPS analysis";
             analyseAugmentedSystems(mumps);
-            
-            sym_perm = new int[mumps.n];
-            std::copy(mumps.sym_perm, mumps.sym_perm + mumps.n, sym_perm);
+
+            // keep the ordering, it is freed with the instance
+            aug_perm.assign(mumps.sym_perm, mumps.sym_perm + mumps.n);
 
         }
 
@@ -72,6 +71,14 @@ void abcd::initializeDirectSolver()
         allocateMumpsSlaves(mumps);
         initializeMumps(mumps);
 
+        // do not compute the ordering twice, give the previous one
+        if(instance_type == 0) {
+            mumps.setIcntl(7, 1);
+            mumps.setIcntl(12, 1);
+            mumps.setIcntl(28, 1);
+            mumps.perm_in = &aug_perm[0];
+        }
+
     } else {
         allocateMumpsSlaves(mumps);
         initializeMumps(mumps);
@@ -249,3 +249,59 @@ void abcd::distributeRhs()
 
     // A = CompRow_Mat_double();
 }
+
+/// Scatters the starting point of the solve, given in the original
+/// numbering, into Xk: the reverse of centralizeVector
+void abcd::distributeX0()
+{
+    double *start = nullptr;
+    if(comm.rank() == 0) {
+        if(icntl[Controls::warm_start] != 0 && sol != nullptr &&
+           solution.dim(0) == n_o && solution.dim(1) == nrhs) {
+            LINFO << "Starting from the previous solution";
+            start = sol;
+        } else if(x0 != nullptr) {
+            LINFO << "Starting from the given x0";
+            start = x0;
+        }
+    }
+
+    int has_start = start != nullptr ? 1 : 0;
+    mpi::broadcast(inter_comm, has_start, 0);
+    use_xk = has_start != 0;
+    if(!use_xk) return;
+
+    // only the root has the column scaling, each master gets the scaled
+    // entries of its own columns, n is still the global number of columns
+    int nl = glob_to_local_ind.size();
+    std::vector<double> xs;
+    if(comm.rank() == 0) {
+        for(int k = 1; k < inter_comm.size(); k++) {
+            std::vector<int> io;
+            inter_comm.recv(k, 74, io);
+
+            std::vector<double> xo(io.size() * nrhs, 0);
+            for(int j = 0; j < nrhs; j++)
+                for(size_t i = 0; i < io.size(); i++)
+                    if(io[i] < n_o)
+                        xo[i + j * io.size()] = start[io[i] + j * n_o] / dcol_[io[i]];
+            inter_comm.send(k, 75, xo);
+        }
+
+        xs.assign(nl * nrhs, 0);
+        for(int j = 0; j < nrhs; j++)
+            for(int i = 0; i < nl; i++) {
+                int g = glob_to_local_ind[i];
+                if(g < n_o) xs[i + j * nl] = start[g + j * n_o] / dcol_[g];
+            }
+    } else {
+        inter_comm.send(0, 74, glob_to_local_ind);
+        inter_comm.recv(0, 75, xs);
+    }
+
+    // nrhs columns like the Xk of the solvers, bcg pads it to its block size
+    Xk = MV_ColMat_double(n, nrhs, 0);
+    for(int j = 0; j < nrhs; j++)
+        for(int i = 0; i < nl; i++)
+            Xk(i, j) = xs[i + j * nl];
+}
@@ -35,11 +35,21 @@
 
 void abcd::distributeData()
 {
-    if(comm.rank() == 0) {
+    std::vector<int> colours;
+    parts_id.clear();
+
+    if(icntl[Controls::dist_input] != 0 || dist_prep) {
+        // the partitions were built on their masters
+        abcd::adoptDistributedPartitions(colours);
+    } else if(comm.rank() == 0) {
         std::vector<int> nnz_parts;
         std::vector<int> m_parts;
         std::vector<int> groups;
 
+        // colour the partitions while all the column indices are here
+        if(icntl[Controls::kaczmarz] != 0 && icntl[Controls::aug_type] == 0)
+            abcd::colourPartitions(colours);
+
         for(int k = 0; k < icntl[Controls::nbparts]; k++) {
             nnz_parts.push_back(parts[k].NumNonzeros());
             m_parts.push_back(parts[k].dim(0));
@@ -100,6 +110,7 @@ void abcd::distributeData()
             parts.clear();
             column_index.clear();
             nb_local_parts = partitions.size();
+            parts_id = partitionsSets[0];
 	    
             if(icntl[Controls::aug_type] != 0) stC.clear();
             for(int i = 0; i < nb_local_parts; i++){
@@ -110,6 +121,7 @@ void abcd::distributeData()
         } else {
             for(unsigned int i = 0; i < parts.size(); i++){
                 partitions.push_back(parts[i]);
+                parts_id.push_back(i);
             }
             parts.clear();
             nb_local_parts = partitions.size();
@@ -126,6 +138,7 @@ void abcd::distributeData()
     } else {
         std::vector<int> se;
         inter_comm.recv(0, 0, se);
+        parts_id = se;
         int sm = 0, snz = 0;
         for(unsigned int i = 0; i < se.size(); i++) {
 
@@ -179,6 +192,15 @@ void abcd::distributeData()
     mpi::broadcast(inter_comm, m_l, 0);
     mpi::broadcast(inter_comm, n_l, 0);
 
+    if(icntl[Controls::kaczmarz] != 0 && icntl[Controls::aug_type] == 0)
+        abcd::distributeColours(colours);
+
+    computeNrmMtx();
+}
+
+/// Computes the inf-norm of the distributed matrix
+void abcd::computeNrmMtx()
+{
     // compute the matrix inf-norm in a distributed maner
     nrmMtx = 0;
     double nrmP = 0;
@@ -286,7 +308,205 @@ void abcd::createInterconnections()
         }
     }
 
+    // Map each local column to the entries of the augmented systems'
+    // solution that sum into it, used to gather subsets of the columns
+    delta_src_ptr.assign(n + 1, 0);
+    for(int p = 0; p < nb_local_parts; p++) {
+        for(size_t i = 0; i < local_column_index[p].size(); i++) {
+            delta_src_ptr[local_column_index[p][i] + 1]++;
+        }
+    }
+    for(int i = 0; i < n; i++) delta_src_ptr[i + 1] += delta_src_ptr[i];
+
+    delta_src.resize(delta_src_ptr[n]);
+    {
+        std::vector<int> fill(delta_src_ptr.begin(), delta_src_ptr.end() - 1);
+        int x_pos = 0;
+        for(int p = 0; p < nb_local_parts; p++) {
+            for(size_t i = 0; i < local_column_index[p].size(); i++) {
+                delta_src[fill[local_column_index[p][i]]++] = x_pos;
+                x_pos++;
+            }
+            x_pos += partitions[p].dim(0);
+        }
+    }
+
+    // Split the local columns between the shared and the private ones
+    std::vector<int> shared(n, 0);
+    for(std::map<int, std::vector<int> >::iterator it = col_interconnections.begin();
+            it != col_interconnections.end(); ++it) {
+        for(std::vector<int>::iterator i = it->second.begin(); i != it->second.end(); ++i) {
+            shared[*i] = 1;
+        }
+    }
+    boundary_cols.clear();
+    interior_cols.clear();
+    for(int i = 0; i < n; i++) {
+        if(shared[i]) boundary_cols.push_back(i);
+        else interior_cols.push_back(i);
+    }
+
+    if (inter_comm.size() > 1)
+        abcd::createHaloGraph();
+
+    if (icntl[Controls::aug_type] != 0)
+        abcd::createCLayout();
+
     if (inter_comm.rank() == 0) 
         LINFO << "Interconnections created";
     
 }
+
+/// Builds the distributed graph of the masters sharing columns
+///
+/// Each master is linked to the masters in abcd::col_interconnections with
+/// whom it shares at least one column, the exchanged columns are packed in
+/// the neighbours order so that a single neighbourhood all-to-all does the
+/// whole exchange.
+void abcd::createHaloGraph()
+{
+    // a persistent exchange built on the previous graph is released
+    // before its communicator goes away
+    if(halo_req != MPI_REQUEST_NULL) MPI_Request_free(&halo_req);
+    halo_req_s = 0;
+
+    halo_nbrs.clear();
+    halo_idx.clear();
+    halo_ptr.assign(1, 0);
+
+    for(std::map<int, std::vector<int> >::iterator it = col_interconnections.begin();
+            it != col_interconnections.end(); ++it) {
+        if(it->second.size() == 0) continue;
+
+        halo_nbrs.push_back(it->first);
+        std::copy(it->second.begin(), it->second.end(), std::back_inserter(halo_idx));
+        halo_ptr.push_back(halo_idx.size());
+    }
+
+    int nb_nbrs = halo_nbrs.size();
+    int no_nbr;
+    int *nbrs = nb_nbrs == 0 ? &no_nbr : &halo_nbrs[0];
+
+    // the relation is symmetric, the sources are also the destinations
+    MPI_Comm graph;
+    MPI_Dist_graph_create_adjacent((MPI_Comm) inter_comm,
+                                   nb_nbrs, nbrs, MPI_UNWEIGHTED,
+                                   nb_nbrs, nbrs, MPI_UNWEIGHTED,
+                                   MPI_INFO_NULL, 0, &graph);
+
+    halo_comm = mpi::communicator(graph, mpi::comm_take_ownership);
+
+    // keep at least one element so that the arrays can be handed to MPI
+    halo_counts.assign(std::max(nb_nbrs, 1), 0);
+    halo_displs.assign(std::max(nb_nbrs, 1), 0);
+}
+
+/// Builds the layout used to move the C part of the solution
+///
+/// Each entry of f = -Y w is sent to the first master by the single
+/// master owning it (see abcd::comm_map), and each master receives back
+/// only the entries of z for the C columns it holds.
+void abcd::createCLayout()
+{
+    c_idx.clear();
+    c_loc.clear();
+
+    // owned columns first, the local columns stop at the merge of the
+    // column indices, n is still the global number of columns here
+    int nb_local_cols = glob_to_local_ind.size();
+    for(int pass = 0; pass < 2; pass++) {
+        for(int j = st_c_part; j < nb_local_cols; j++) {
+            if((comm_map[j] == 1) == (pass == 0)) {
+                c_idx.push_back(glob_to_local_ind[j] - n_o);
+                c_loc.push_back(j);
+            }
+        }
+        if(pass == 0) c_nb_owned = c_idx.size();
+    }
+
+    int nb_c = c_idx.size();
+    int np = inter_comm.size();
+    int root = inter_comm.rank() == 0;
+
+    c_counts.assign(root ? np : 1, 0);
+    c_owned_counts.assign(root ? np : 1, 0);
+    c_displs.assign(root ? np : 1, 0);
+
+    MPI_Gather(&nb_c, 1, MPI_INT, &c_counts[0], 1, MPI_INT, 0, (MPI_Comm) inter_comm);
+    MPI_Gather(&c_nb_owned, 1, MPI_INT, &c_owned_counts[0], 1, MPI_INT, 0, (MPI_Comm) inter_comm);
+
+    if(root) {
+        for(int k = 1; k < np; k++) c_displs[k] = c_displs[k - 1] + c_counts[k - 1];
+        c_all_idx.resize(c_displs[np - 1] + c_counts[np - 1]);
+    }
+
+    MPI_Gatherv(c_idx.data(), nb_c, MPI_INT,
+                c_all_idx.data(), &c_counts[0], &c_displs[0], MPI_INT,
+                0, (MPI_Comm) inter_comm);
+}
+
+/// Builds f = -Y w on the first master from the owned C columns of w
+void abcd::gatherF(MV_ColMat_double &w, MV_ColMat_double &f)
+{
+    int s = w.dim(1);
+    int np = inter_comm.size();
+    int root = inter_comm.rank() == 0;
+
+    std::vector<double> sbuf(c_nb_owned * s);
+    for(int i = 0; i < c_nb_owned; i++)
+        for(int j = 0; j < s; j++)
+            sbuf[i * s + j] = -1 * w(c_loc[i], j);
+
+    std::vector<int> counts(c_counts.size(), 0), displs(c_displs.size(), 0);
+    std::vector<double> rbuf;
+    if(root) {
+        for(int k = 0; k < np; k++) {
+            counts[k] = c_owned_counts[k] * s;
+            displs[k] = c_displs[k] * s;
+        }
+        rbuf.resize(c_all_idx.size() * s);
+    }
+
+    MPI_Gatherv(sbuf.data(), c_nb_owned * s, MPI_DOUBLE,
+                rbuf.data(), &counts[0], &displs[0], MPI_DOUBLE,
+                0, (MPI_Comm) inter_comm);
+
+    if(root) {
+        f = MV_ColMat_double(size_c, s, 0);
+        for(int k = 0; k < np; k++)
+            for(int i = c_displs[k]; i < c_displs[k] + c_owned_counts[k]; i++)
+                for(int j = 0; j < s; j++)
+                    f(c_all_idx[i], j) = rbuf[i * s + j];
+    }
+}
+
+/// Sets the C columns of x held by each master from z, given on the
+/// first master
+void abcd::scatterZ(MV_ColMat_double &z, MV_ColMat_double &x)
+{
+    int s = x.dim(1);
+    int np = inter_comm.size();
+    int root = inter_comm.rank() == 0;
+
+    std::vector<int> counts(c_counts.size(), 0), displs(c_displs.size(), 0);
+    std::vector<double> sbuf;
+    if(root) {
+        sbuf.resize(c_all_idx.size() * s);
+        for(int k = 0; k < np; k++) {
+            counts[k] = c_counts[k] * s;
+            displs[k] = c_displs[k] * s;
+        }
+        for(size_t i = 0; i < c_all_idx.size(); i++)
+            for(int j = 0; j < s; j++)
+                sbuf[i * s + j] = z(c_all_idx[i], j);
+    }
+
+    std::vector<double> rbuf(c_idx.size() * s);
+    MPI_Scatterv(sbuf.data(), &counts[0], &displs[0], MPI_DOUBLE,
+                 rbuf.data(), c_idx.size() * s, MPI_DOUBLE,
+                 0, (MPI_Comm) inter_comm);
+
+    for(size_t i = 0; i < c_idx.size(); i++)
+        for(int j = 0; j < s; j++)
+            x(c_loc[i], j) = rbuf[i * s + j];
+}
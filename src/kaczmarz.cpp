@@ -0,0 +1,227 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#include <abcd.h>
+
+#include <iostream>
+
+/// Orders the partitions by decreasing number of neighbours
+struct MoreNeighbours {
+    const std::vector<std::vector<int> > &nbrs;
+
+    explicit MoreNeighbours(const std::vector<std::vector<int> > &n) : nbrs(n) {}
+
+    bool operator()(int a, int b) const { return nbrs[a].size() > nbrs[b].size(); }
+};
+
+/// Colours the partitions so that two partitions sharing a column have
+/// different colours
+///
+/// Greedy colouring of the partitions' graph, the partitions with the
+/// most neighbours first. Called by the root while it holds the column
+/// indices of all the partitions.
+/// \param colours The colour of each partition
+void abcd::colourPartitions(std::vector<int> &colours)
+{
+    int nb = icntl[Controls::nbparts];
+
+    // the partitions touching each column
+    std::vector<int> col_ptr(n + 1, 0);
+    for(int p = 0; p < nb; p++) {
+        for(size_t i = 0; i < column_index[p].size(); i++) {
+            col_ptr[column_index[p][i] + 1]++;
+        }
+    }
+    for(int i = 0; i < n; i++) col_ptr[i + 1] += col_ptr[i];
+
+    std::vector<int> col_parts(col_ptr[n]);
+    {
+        std::vector<int> fill(col_ptr.begin(), col_ptr.end() - 1);
+        for(int p = 0; p < nb; p++) {
+            for(size_t i = 0; i < column_index[p].size(); i++) {
+                col_parts[fill[column_index[p][i]]++] = p;
+            }
+        }
+    }
+
+    // the neighbours of each partition
+    std::vector<std::vector<int> > nbrs(nb);
+    std::vector<int> mark(nb, -1);
+    for(int p = 0; p < nb; p++) {
+        mark[p] = p;
+        for(size_t i = 0; i < column_index[p].size(); i++) {
+            int c = column_index[p][i];
+            for(int k = col_ptr[c]; k < col_ptr[c + 1]; k++) {
+                int q = col_parts[k];
+                if(mark[q] == p) continue;
+                mark[q] = p;
+                nbrs[p].push_back(q);
+            }
+        }
+    }
+
+    std::vector<int> order(nb);
+    for(int p = 0; p < nb; p++) order[p] = p;
+    std::stable_sort(order.begin(), order.end(), MoreNeighbours(nbrs));
+
+    colours.assign(nb, -1);
+    std::fill(mark.begin(), mark.end(), -1);
+    nb_colours = 0;
+    for(int o = 0; o < nb; o++) {
+        int p = order[o];
+        for(size_t i = 0; i < nbrs[p].size(); i++) {
+            int c = colours[nbrs[p][i]];
+            if(c >= 0) mark[c] = p;
+        }
+        int c = 0;
+        while(mark[c] == p) c++;
+        colours[p] = c;
+        nb_colours = std::max(nb_colours, c + 1);
+    }
+
+    LINFO << "Partitions coloured with " << nb_colours << " colours";
+}
+
+/// Gives each master the colours of its partitions
+void abcd::distributeColours(std::vector<int> &colours)
+{
+    int nb = icntl[Controls::nbparts];
+    colours.resize(nb);
+    mpi::broadcast(inter_comm, &colours[0], nb, 0);
+
+    nb_colours = *std::max_element(colours.begin(), colours.end()) + 1;
+    part_colour.resize(nb_local_parts);
+    for(int k = 0; k < nb_local_parts; k++) {
+        part_colour[k] = colours[parts_id[k]];
+    }
+}
+
+/// Computes alpha * g(Rhs) + beta * (I - Q) X, the block Kaczmarz
+/// counterpart of abcd::sumProject
+///
+/// Q is the product of the (I - P_c) over the colours in a forward then
+/// a backward sweep, P_c being the sum of the projectors of the colour
+/// c, and g(Rhs) is the sweep started from zero. Each colour is a sum of
+/// projections restricted to its partitions, which share no column. The
+/// last colour of the forward sweep is not repeated, P_c is a
+/// projector. As (I - Q) is symmetric, it can replace H in the
+/// accelerations.
+MV_ColMat_double abcd::sweepProject(double alpha, MV_ColMat_double &Rhs, double beta, MV_ColMat_double &X)
+{
+    int s = alpha != 0 ? Rhs.dim(1) : X.dim(1);
+
+    // y = Q (-beta x) + g(alpha Rhs)
+    MV_ColMat_double y(n, s, 0);
+    if(beta != 0) {
+        for(int j = 0; j < s; j++) {
+            for(int i = 0; i < n; i++) y(i, j) = -beta * X(i, j);
+        }
+    }
+
+    for(int k = 0; k < 2 * nb_colours - 1; k++) {
+        active_colour = k < nb_colours ? k : 2 * nb_colours - 2 - k;
+
+        MV_ColMat_double d = sumProject(alpha, Rhs, -1e0, y);
+        y += d;
+    }
+    active_colour = -1;
+
+    // return it in the workspace, as sumProject
+    allocateWorkspace(s);
+    double *dpt = &ws_delta[0];
+    for(int j = 0; j < s; j++) {
+        for(int i = 0; i < n; i++) {
+            dpt[i + j * n] = y(i, j) + (beta != 0 ? beta * X(i, j) : 0);
+        }
+    }
+
+    return MV_ColMat_double(dpt, n, s, MV_Matrix_::ref);
+}
+
+/// Solves Ax = b with forward block Kaczmarz sweeps over the colours of
+/// the partitions, without acceleration
+///
+/// The partitions of a colour project in parallel and the colours are
+/// applied one after the other. The backward error is computed every
+/// icntl[Controls::check_interval] sweeps.
+/// \param b The right-hand side
+void abcd::kaczmarzSweeps(MV_ColMat_double &b)
+{
+    std::streamsize oldprec = std::cout.precision();
+
+    const double threshold = dcntl[Controls::threshold];
+    const int itmax = icntl[Controls::itmax];
+    const int check_interval = std::max(1, icntl[Controls::check_interval]);
+
+    MV_ColMat_double u(m, nrhs, 0);
+    startAcceleration(b, u);
+
+    int it = 0;
+    double rho = compute_rho(Xk, u);
+    double t1_total = 0;
+    double ti = MPI_Wtime();
+
+    while(rho > threshold && it < itmax) {
+        double t1 = MPI_Wtime();
+        for(int c = 0; c < nb_colours; c++) {
+            active_colour = c;
+
+            MV_ColMat_double d = sumProject(1e0, u, -1e0, Xk);
+            Xk += d;
+        }
+        active_colour = -1;
+        t1_total += MPI_Wtime() - t1;
+
+        it++;
+
+        if(it % check_interval == 0 || it >= itmax) {
+            rho = compute_rho(Xk, u);
+            normres.push_back(rho);
+
+            if(comm.rank() == 0 && icntl[Controls::verbose_level] >= 2) {
+                int ev = icntl[Controls::verbose_level] >= 3 ? 1 : 10;
+                LOG_EVERY_N(ev, INFO) << "ITERATION " << it <<
+                    " rho = " << scientific << rho << setprecision(oldprec);
+            }
+        }
+    }
+
+    if(inter_comm.rank() == 0) {
+        LINFO2 << "Kaczmarz Rho: " << scientific << rho ;
+        LINFO2 << "Kaczmarz Sweeps : " << setprecision(2) << it ;
+        LINFO2 << "Kaczmarz Colours : " << nb_colours ;
+        LINFO2 << "Kaczmarz TIME : " << MPI_Wtime() - ti ;
+        LINFO2 << "SumProject time : " << t1_total ;
+    }
+
+    endAcceleration(it);
+}
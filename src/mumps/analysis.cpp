@@ -56,6 +56,9 @@ void abcd::analyseAugmentedSystems(MUMPS &mu)
   }
 
   if(instance_type == 0) {
+    // INFOG(7) is 1 when the ordering given in perm_in was used
+    if(mu.getInfoG(7) != 1) info[Controls::nb_orderings]++;
+
     double flop = mu.getRinfo(1);
     int prec = cout.precision();
     cout.precision(2);
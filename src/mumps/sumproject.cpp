@@ -33,96 +33,42 @@
 #include<abcd.h>
 #include<mumps.h>
 
+/// Computes alpha * A^+ Rhs + beta * H X, H being the sum of projectors
+///
+/// All the buffers come from the solver's workspace (see
+/// abcd::allocateWorkspace), the returned matrix is a reference to it and
+/// is only valid until the next call to sumProject.
 MV_ColMat_double abcd::sumProject(double alpha, MV_ColMat_double &Rhs, double beta, MV_ColMat_double &X)
 {
     //int s = X.dim(1);
     if (alpha!=0 && beta!=0) assert(X.dim(1) == Rhs.dim(1));
 
+    if(icntl[Controls::kaczmarz] == 1 && icntl[Controls::aug_type] == 0 && active_colour < 0)
+        return sweepProject(alpha, Rhs, beta, X);
+
     int s = alpha != 0 ? Rhs.dim(1) : X.dim(1);
 
-    // Build the mumps rhs
-    mumps.rhs = new double[mumps.n * s];
-    for(int i = 0; i < mumps.n * s; i++) mumps.rhs[i] = 0;
-    MV_ColMat_double mumps_rhs(mumps.rhs, mumps.n, s, MV_Matrix_::ref);
+    allocateWorkspace(s);
 
-    int pos = 0;
-    int b_pos = 0;
-    MV_ColMat_double Delta(n, s, 0);
-    double *xpt = X.ptr();
-    int xlda = X.lda();
-    int dlda = Delta.lda();
+    double *dpt = &ws_delta[0];
+    int dlda = n;
+    std::fill(ws_delta.begin(), ws_delta.begin() + n * s, 0);
 
     if(beta != 0 || alpha != 0){
-        for(int k = 0; k < nb_local_parts; k++) {
-
-            CompRow_Mat_double *part = &partitions[k];
-
-            MV_ColMat_double r(part->dim(0), s, 0);
-            double *rpt = r.ptr();
-            int rlda = r.lda();
-            MV_ColMat_double compressed_x(part->dim(1), s, 0);
-            double *cxpt = compressed_x.ptr();
-            int cxlda = compressed_x.lda();
-
-            // avoid useless operations
-            if(beta != 0){
-                int x_pos = 0;
-                for(size_t i = 0; i < local_column_index[k].size(); i++) {
-                    int ci = local_column_index[k][i];
-                    for(int j = 0; j < s; j++) {
-                        cxpt[x_pos + j * cxlda] = xpt[ci + j * xlda];
-                    }
-                    x_pos++;
-                }
-
-                r = smv(*part, compressed_x) * beta;
-            }
+        solveLocalProjections(alpha, Rhs, beta, X, s);
 
-            if(alpha != 0 && beta !=0){
-                MV_ColMat_double rr(part->dim(0), s);
-
-                for (int i = b_pos; i < b_pos + part->dim(0); ++i)
-                    for (int j = 0; j < s; ++j) 
-                        rr(i - b_pos, j) = Rhs(i, j);
-
-                r = r + rr * alpha;
-            }
-
-            if(alpha != 0 && beta ==0){
-                for (int i = b_pos; i < b_pos + part->dim(0); ++i)
-                    for (int j = 0; j < s; ++j) 
-                        r(i - b_pos, j) = Rhs(i, j) * alpha;
-            }
-
-            b_pos += part->dim(0);
-
-            //to = MPI_Wtime();
-
-            int j = 0;
-            for(int i = pos + part->dim(1); i < pos + part->dim(1) + part->dim(0); i++) {
-                //for(int r_p = 0; r_p < s; r_p++) mumps_rhs(i, r_p) = r(j, r_p);
-                for(int r_p = 0; r_p < s; r_p++) mumps.rhs[i + r_p * mumps.n] = rpt[j + r_p * rlda];
-                j++;
-            }
-            //ti += MPI_Wtime() - to;
-
-            pos += part->dim(1) + part->dim(0);
+        // Sum the shared columns first, send them and sum the others
+        // while the messages are in flight
+        if(icntl[Controls::halo_exchange] != 0 && inter_comm.size() > 1) {
+            gatherDelta(boundary_cols, s);
+            postDeltaExchange(s);
+            gatherDelta(interior_cols, s);
+            finishDeltaExchange(s);
 
+            return MV_ColMat_double(dpt, n, s, MV_Matrix_::ref);
         }
 
-        int job = 1;
-        mpi::broadcast(intra_comm, job, 0);
-
-        mumps.nrhs = s;
-        mumps.lrhs = mumps.n;
-        mumps.job = 3;
-
-        double t = MPI_Wtime();
-        dmumps_c(&mumps);
-        t = MPI_Wtime() - t;
-
         int x_pos = 0;
-        double *dpt = Delta.ptr();
         if(nb_local_parts > 1)
         {
             for(int k = 0; k < nb_local_parts; k++) {
@@ -152,70 +98,222 @@ MV_ColMat_double abcd::sumProject(double alpha, MV_ColMat_double &Rhs, double be
     }
 
     if(inter_comm.size() == 1) {
-        delete[] mumps.rhs;
-        return Delta;
+        return MV_ColMat_double(dpt, n, s, MV_Matrix_::ref);
     }
 
     // Where the other Deltas are going to be summed
+    postDeltaExchange(s);
+    finishDeltaExchange(s);
+
+    return MV_ColMat_double(dpt, n, s, MV_Matrix_::ref);
+}
+
+/// Solves the augmented systems of the local partitions for the
+/// right-hand sides alpha * Rhs + beta * A_k X, the projections are
+/// left in mumps.rhs
+///
+/// When nrmR is given, it receives the inf-norm of the local part of
+/// each right-hand side, the local residual when alpha = 1 and beta = -1.
+void abcd::solveLocalProjections(double alpha, MV_ColMat_double &Rhs, double beta,
+                                 MV_ColMat_double &X, int s, VECTOR_double *nrmR)
+{
+    // Build the mumps rhs
+    mumps.rhs = &ws_rhs[0];
+    std::fill(ws_rhs.begin(), ws_rhs.begin() + mumps.n * s, 0);
+
+    if(nrmR != nullptr) *nrmR = 0;
+
+    // only the partitions of the active colour project, the others keep
+    // a zero rhs and a zero projection
+    bool any = active_colour < 0;
+
+    int pos = 0;
+    int b_pos = 0;
+
+    double *xpt = X.ptr();
+    int xlda = X.lda();
+
+    for(int k = 0; k < nb_local_parts; k++) {
+
+        CompRow_Mat_double *part = &partitions[k];
+        int *rp = part->rowptr_ptr();
+        int *cp = part->colind_ptr();
+        double *vp = part->val_ptr();
+        std::vector<int> &lci = local_column_index[k];
+
+        if(active_colour >= 0 && part_colour[k] != active_colour) {
+            b_pos += part->dim(0);
+            pos += part->dim(1) + part->dim(0);
+            continue;
+        }
+        any = true;
 
-    std::vector<double *>itcp(icntl[Controls::nbparts]);
-    std::vector<double *>otcp(icntl[Controls::nbparts]);
+        // r = beta * A_k x + alpha * b_k, written in place in the
+        // lower part of the augmented system's rhs
+        double *rpt = mumps.rhs + pos + part->dim(1);
 
-    std::vector<mpi::status> sts;
-    std::vector<mpi::request> reqs;
+        for(int j = 0; j < s; j++) {
+            for(int i = 0; i < part->dim(0); i++) {
+                double r = 0;
+
+                // avoid useless operations
+                if(beta != 0){
+                    for(int c = rp[i]; c < rp[i + 1]; c++) {
+                        r += vp[c] * xpt[lci[cp[c]] + j * xlda];
+                    }
+                    r *= beta;
+                }
+
+                if(alpha != 0){
+                    r += Rhs(b_pos + i, j) * alpha;
+                }
+
+                rpt[i + j * mumps.n] = r;
+                if(nrmR != nullptr && abs(r) > (*nrmR)(j)) (*nrmR)(j) = abs(r);
+            }
+        }
+
+        b_pos += part->dim(0);
+        pos += part->dim(1) + part->dim(0);
+    }
+
+    // nothing to project on this master for this colour
+    if(!any) return;
+
+    int job = 1;
+    mpi::broadcast(intra_comm, job, 0);
+
+    mumps.nrhs = s;
+    mumps.lrhs = mumps.n;
+    mumps.job = 3;
+
+    dmumps_c(&mumps);
+}
+
+/// Sums the local projections into the columns cols of Delta
+void abcd::gatherDelta(std::vector<int> &cols, int s)
+{
+    double *dpt = &ws_delta[0];
+    int *sp = &delta_src_ptr[0];
+    int *src = &delta_src[0];
+
+    for(int j = 0; j < s; j++) {
+        double *rhs = mumps.rhs + j * mumps.n;
+        double *d = dpt + j * n;
+        for(std::vector<int>::iterator i = cols.begin(); i != cols.end(); ++i) {
+            double v = 0;
+            for(int k = sp[*i]; k < sp[*i + 1]; k++) v += rhs[src[k]];
+            d[*i] = v;
+        }
+    }
+}
+
+/// Packs the shared columns of Delta and posts their exchange
+void abcd::postDeltaExchange(int s)
+{
+    double *dpt = &ws_delta[0];
+
+    if(icntl[Controls::halo_exchange] == 2) {
+        int nb_nbrs = halo_nbrs.size();
+        double *sbuf = halo_sbuf.empty() ? nullptr : &halo_sbuf[0];
+        double *rbuf = halo_rbuf.empty() ? nullptr : &halo_rbuf[0];
+
+        int kp = 0;
+        for(int k = 0; k < nb_nbrs; k++) {
+            for(int j = 0; j < s; j++) {
+                for(int i = halo_ptr[k]; i < halo_ptr[k + 1]; i++) {
+                    sbuf[kp++] = dpt[halo_idx[i] + j * n];
+                }
+            }
+        }
+
+#if MPI_VERSION >= 4
+        // the buffers only move when the block grows, which changes s
+        if(halo_req_s != s) {
+            if(halo_req != MPI_REQUEST_NULL) MPI_Request_free(&halo_req);
+
+            for(int k = 0; k < nb_nbrs; k++) {
+                halo_counts[k] = (halo_ptr[k + 1] - halo_ptr[k]) * s;
+                halo_displs[k] = halo_ptr[k] * s;
+            }
+            MPI_Neighbor_alltoallv_init(sbuf, &halo_counts[0], &halo_displs[0], MPI_DOUBLE,
+                                        rbuf, &halo_counts[0], &halo_displs[0], MPI_DOUBLE,
+                                        (MPI_Comm) halo_comm, MPI_INFO_NULL, &halo_req);
+            halo_req_s = s;
+        }
+        MPI_Start(&halo_req);
+#else
+        if(halo_req_s != s) {
+            for(int k = 0; k < nb_nbrs; k++) {
+                halo_counts[k] = (halo_ptr[k + 1] - halo_ptr[k]) * s;
+                halo_displs[k] = halo_ptr[k] * s;
+            }
+            halo_req_s = s;
+        }
+        MPI_Ineighbor_alltoallv(sbuf, &halo_counts[0], &halo_displs[0], MPI_DOUBLE,
+                                rbuf, &halo_counts[0], &halo_displs[0], MPI_DOUBLE,
+                                (MPI_Comm) halo_comm, &halo_req);
+#endif
+        return;
+    }
+
+    std::vector<mpi::request> &reqs = ws_reqs;
+    reqs.clear();
 
-    double t = MPI_Wtime();
-    double t1 = t;
-    double t2 = 0;
     for(std::map<int, std::vector<int> >::iterator it = col_interconnections.begin();
             it != col_interconnections.end(); ++it) {
 
         if(it->second.size() == 0) continue;
         // Prepare the data to be sent
-        //
-        //create it if does not exist
-        itcp[it->first] = new double[it->second.size()*s];
-        otcp[it->first] = new double[it->second.size()*s];
+        double *itcp = &ws_itcp[it->first][0];
+        double *otcp = &ws_otcp[it->first][0];
 
-        double t3 = MPI_Wtime();
         int kp = 0;
         for(int j = 0; j < s; j++) {
             for(std::vector<int>::iterator i = it->second.begin(); i != it->second.end(); ++i) {
-                //itc[it->first].push_back(Delta(*i, j));
-                itcp[it->first][kp] = Delta(*i,j);
+                itcp[kp] = dpt[*i + j * n];
                 kp++;
             }
         }
-        t2 += MPI_Wtime() - t3;
 
-        reqs.push_back(inter_comm.irecv(it->first, 31, otcp[it->first], kp));
-        reqs.push_back(inter_comm.isend(it->first, 31, itcp[it->first], kp));
+        reqs.push_back(inter_comm.irecv(it->first, 31, otcp, kp));
+        reqs.push_back(inter_comm.isend(it->first, 31, itcp, kp));
     }
+}
 
-    mpi::wait_all(reqs.begin(), reqs.end());
-    t1 = MPI_Wtime() - t1;
+/// Waits for the exchange of the shared columns and sums them into Delta
+void abcd::finishDeltaExchange(int s)
+{
+    double *dpt = &ws_delta[0];
+
+    if(icntl[Controls::halo_exchange] == 2) {
+        MPI_Wait(&halo_req, MPI_STATUS_IGNORE);
+
+        int kp = 0;
+        for(size_t k = 0; k < halo_nbrs.size(); k++) {
+            for(int j = 0; j < s; j++) {
+                for(int i = halo_ptr[k]; i < halo_ptr[k + 1]; i++) {
+                    dpt[halo_idx[i] + j * n] += halo_rbuf[kp++];
+                }
+            }
+        }
+        return;
+    }
+
+    mpi::wait_all(ws_reqs.begin(), ws_reqs.end());
 
     for(std::map<int, std::vector<int> >::iterator it = col_interconnections.begin();
             it != col_interconnections.end(); ++it) {
 
         if(it->second.size() == 0) continue;
+        double *otcp = &ws_otcp[it->first][0];
         int p = 0;
         for(int j = 0; j < s; j++) {
             for(std::vector<int>::iterator i = it->second.begin(); i != it->second.end(); ++i) {
-                //Others(*i, j) += otcp[it->first][p];
-                Delta(*i, j) += otcp[it->first][p];
+                dpt[*i + j * n] += otcp[p];
                 p++;
             }
         }
 
     }
-
-    for(size_t i = 0; i < itcp.size(); i ++) {
-        delete[] itcp[i];
-        delete[] otcp[i];
-    }
-
-    delete[] mumps.rhs;
-
-    return Delta;
 }
@@ -0,0 +1,73 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#include<abcd.h>
+#include<mumps.h>
+
+/// Grows v to at least sz elements and counts the bytes it had to allocate
+static void growBuffer(std::vector<double> &v, size_t sz, double &bytes)
+{
+    if(v.size() >= sz) return;
+    if(v.capacity() < sz) bytes += (double)sz * sizeof(double);
+    v.resize(sz);
+}
+
+/// Sizes the buffers used by abcd::sumProject for blocks of s columns
+///
+/// The workspace only grows: once it is large enough, every call to
+/// sumProject reuses it and abcd::ws_bytes (the bytes allocated so far)
+/// stays unchanged.
+void abcd::allocateWorkspace(int s)
+{
+    if(instance_type != 0 || s <= ws_s) return;
+
+    growBuffer(ws_rhs, (size_t)mumps.n * s, ws_bytes);
+    growBuffer(ws_delta, (size_t)n * s, ws_bytes);
+
+    for(std::map<int, std::vector<int> >::iterator it = col_interconnections.begin();
+            it != col_interconnections.end(); ++it) {
+        if(it->second.size() == 0) continue;
+
+        growBuffer(ws_itcp[it->first], it->second.size() * s, ws_bytes);
+        growBuffer(ws_otcp[it->first], it->second.size() * s, ws_bytes);
+    }
+
+    if(halo_idx.size() != 0) {
+        growBuffer(halo_sbuf, halo_idx.size() * s, ws_bytes);
+        growBuffer(halo_rbuf, halo_idx.size() * s, ws_bytes);
+    }
+
+    ws_s = s;
+
+    LDEBUG3 << "MA " << inter_comm.rank() << " sumProject workspace: "
+            << ws_bytes << " bytes for " << s << " columns";
+}
@@ -0,0 +1,265 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#include <abcd.h>
+
+#include <iostream>
+
+/// The reduction used by abcd::pipelinedCG
+///
+/// Each element is a whole buffer [nb_sum, sums..., maxima...], it is
+/// reduced as a single MPI element so that the sums and the maxima of
+/// an iteration travel in the same message.
+static void fusedSumMax(void *in, void *inout, int *len, MPI_Datatype *dtype)
+{
+    int size;
+    MPI_Type_size(*dtype, &size);
+    int nb = size / sizeof(double);
+
+    double *a = (double *) in;
+    double *b = (double *) inout;
+
+    for(int e = 0; e < *len; e++) {
+        int nb_sum = (int) a[0];
+        for(int i = 1; i <= nb_sum; i++) b[i] += a[i];
+        for(int i = nb_sum + 1; i < nb; i++) b[i] = std::max(a[i], b[i]);
+
+        a += nb;
+        b += nb;
+    }
+}
+
+/// Uses pipelined CG to solve Hx = k where H is the sum of projectors
+///
+/// Each right-hand side has its own CG recurrence (Ghysels and Vanroose
+/// variant), the inner products and the norms of the stopping criterion
+/// of an iteration are reduced by a single non-blocking all-reduce
+/// that runs while the next sum of projections is computed.
+/// \param b The right-hand side
+void abcd::pipelinedCG(MV_ColMat_double &b)
+{
+    std::streamsize oldprec = std::cout.precision();
+
+    const double threshold = dcntl[Controls::threshold];
+    const int itmax = icntl[Controls::itmax];
+    const int check_interval = std::max(1, icntl[Controls::check_interval]);
+
+    MV_ColMat_double u(m, nrhs, 0);
+    startAcceleration(b, u);
+
+    MV_ColMat_double r(n, nrhs, 0);
+    MV_ColMat_double w(n, nrhs, 0);
+    MV_ColMat_double q(n, nrhs, 0);
+    MV_ColMat_double z(n, nrhs, 0);
+    MV_ColMat_double sw(n, nrhs, 0);
+    MV_ColMat_double p(n, nrhs, 0);
+
+    double t1_total = MPI_Wtime();
+
+    // r = k - Hx and w = Hr
+    if(use_xk) {
+        r = sumProject(1e0, u, -1e0, Xk);
+    } else {
+        r = sumProject(1e0, u, 0, Xk);
+    }
+    w = sumProject(0e0, u, 1e0, r);
+
+    t1_total = MPI_Wtime() - t1_total;
+    double t2_total = 0;
+
+    // [nb_sum | gamma | delta | ||x|| | ||r||_inf], nrhs values each
+    int nb_sum = 3 * nrhs;
+    int len = 1 + 4 * nrhs;
+    std::vector<double> loc(len, 0), glob(len, 0);
+
+    MPI_Datatype red_type;
+    MPI_Type_contiguous(len, MPI_DOUBLE, &red_type);
+    MPI_Type_commit(&red_type);
+
+    MPI_Op red_op;
+    MPI_Op_create(fusedSumMax, 1, &red_op);
+    MPI_Request req;
+
+    std::vector<double> gamma_old(nrhs, 0), alpha(nrhs, 0), beta(nrhs, 0);
+    VECTOR_double nrmRV(nrhs, 0), nrmXV(nrhs, 0);
+    VECTOR_double nrmR(nrhs, 0), nrmX(nrhs, 0);
+
+    double *xp = Xk.ptr(), *rp = r.ptr(), *wp = w.ptr(), *qp = q.ptr();
+    double *zp = z.ptr(), *sp = sw.ptr(), *pp = p.ptr();
+    int xlda = Xk.lda();
+
+    // last exact rho and the squared projected residual norms at that time
+    double rho_ref = 1;
+    int nb_checks = 0;
+    std::vector<double> gamma_ref(nrhs, 0);
+
+    int it = 0;
+    double rho = 1;
+    double ti = MPI_Wtime();
+
+    while(true) {
+        double t = MPI_Wtime();
+
+        // local contributions to the inner products and to rho
+        loc[0] = nb_sum;
+        for(int j = 0; j < nrhs; j++) {
+            double gamma_l = 0, delta_l = 0;
+            for(int i = 0; i < n; i++) {
+                if(comm_map[i] == 1) {
+                    gamma_l += rp[i + j * n] * rp[i + j * n];
+                    delta_l += wp[i + j * n] * rp[i + j * n];
+                }
+            }
+            loc[1 + j] = gamma_l;
+            loc[1 + nrhs + j] = delta_l;
+        }
+
+        bool exact = (it % check_interval == 0) || (it >= itmax);
+        if(exact) {
+            get_local_nrmres(Xk, u, nrmRV, nrmXV);
+        } else {
+            nrmRV = 0;
+            nrmXV = 0;
+        }
+        for(int j = 0; j < nrhs; j++) {
+            loc[1 + 2 * nrhs + j] = nrmXV(j);
+            loc[1 + 3 * nrhs + j] = nrmRV(j);
+        }
+
+        MPI_Iallreduce(&loc[0], &glob[0], 1, red_type, red_op, (MPI_Comm) inter_comm, &req);
+
+        // q = Hw while the reduction is in flight
+        double t1 = MPI_Wtime();
+        q = sumProject(0e0, u, 1e0, w);
+        t1 = MPI_Wtime() - t1;
+
+        double t2 = MPI_Wtime();
+        MPI_Wait(&req, MPI_STATUS_IGNORE);
+        t2 = MPI_Wtime() - t2;
+
+        if(exact) {
+            for(int j = 0; j < nrhs; j++) {
+                nrmX(j) = glob[1 + 2 * nrhs + j];
+                nrmR(j) = glob[1 + 3 * nrhs + j];
+            }
+
+            // the criterion of the current iterate
+            rho = compute_rho(nrmR, nrmX);
+        } else {
+            // scale the last exact rho by the reduction of ||r|| since then
+            double red = 1;
+            for(int j = 0; j < nrhs; j++) {
+                double rj = gamma_ref[j] > 0 ? sqrt(glob[1 + j] / gamma_ref[j]) : 0;
+                red = j == 0 ? rj : std::min(red, rj);
+            }
+            rho = rho_ref * red;
+
+            // confirm a convergence with the exact value
+            if(rho < threshold) {
+                double tc = MPI_Wtime();
+                rho = compute_rho(Xk, u);
+                t2 += MPI_Wtime() - tc;
+                exact = true;
+            }
+        }
+        if(exact) {
+            rho_ref = rho;
+            for(int j = 0; j < nrhs; j++) gamma_ref[j] = glob[1 + j];
+            nb_checks++;
+        }
+        normres.push_back(rho);
+
+        t1_total += t1;
+        t2_total += t2;
+
+        if(exact && ((rho < threshold) || (it >= itmax))) break;
+        it++;
+
+        for(int j = 0; j < nrhs; j++) {
+            double gamma = glob[1 + j];
+            double delta = glob[1 + nrhs + j];
+
+            // this column has converged exactly
+            if(gamma == 0) {
+                alpha[j] = 0;
+                beta[j] = 0;
+                continue;
+            }
+
+            double den = delta;
+            beta[j] = 0;
+            if(it > 1 && alpha[j] != 0) {
+                beta[j] = gamma / gamma_old[j];
+                den = delta - beta[j] * gamma / alpha[j];
+            }
+
+            alpha[j] = den != 0 ? gamma / den : 0;
+            gamma_old[j] = gamma;
+        }
+
+        for(int j = 0; j < nrhs; j++) {
+            double a = alpha[j], be = beta[j];
+            for(int i = j * n; i < (j + 1) * n; i++) {
+                zp[i] = qp[i] + be * zp[i];
+                sp[i] = wp[i] + be * sp[i];
+                pp[i] = rp[i] + be * pp[i];
+
+                xp[i - j * n + j * xlda] += a * pp[i];
+                rp[i] -= a * sp[i];
+                wp[i] -= a * zp[i];
+            }
+        }
+
+        t = MPI_Wtime() - t;
+        if(comm.rank() == 0 && icntl[Controls::verbose_level] >= 2) {
+            int ev = icntl[Controls::verbose_level] >= 3 ? 1 : 10;
+            LOG_EVERY_N(ev, INFO) << "ITERATION " << it <<
+                " rho = " << scientific << rho <<
+                "  Timings: " << setprecision(2) << t <<
+                setprecision(oldprec); // put precision back to what it was before
+        }
+    }
+
+    MPI_Op_free(&red_op);
+    MPI_Type_free(&red_type);
+
+    if(inter_comm.rank() == 0) {
+        LINFO2 << "PCG Rho: " << scientific << rho ;
+        LINFO2 << "PCG Iterations : " << setprecision(2) << it ;
+        LINFO2 << "PCG TIME : " << MPI_Wtime() - ti ;
+        LINFO2 << "SumProject time : " << t1_total ;
+        LINFO2 << "Reduction wait time : " << t2_total ;
+        LINFO2 << "Exact Rho computations : " << nb_checks ;
+    }
+    info[Controls::nb_backward] = nb_checks;
+    endAcceleration(it);
+}
@@ -32,123 +32,122 @@
 
 #include "abcd.h"
 
-void abcd::aijAugmentMatrix(std::vector<CompCol_Mat_double> &M)
+/// Builds the blocks of the A_ij/-A_ji augmentation between a pair of
+/// partitions from their columns in common
+/// \param A_ij The columns in common of the first partition
+/// \param A_ji The columns in common of the second partition
+/// \param pb The blocks
+/// \return false when the pair needs no augmentation
+bool abcd::aijPairBlocks(CompCol_Mat_double &A_ij, CompCol_Mat_double &A_ji, PairBlocks &pb)
 {
-
-    int nbcols = A.dim(1);
-    std::map<int,std::vector<CompCol_Mat_double> > C;
-    std::map<int,std::vector<int> > stCols;
 #ifdef WIP
     double filter_c = dcntl[Controls::aug_filter];
 #endif //WIP
-    stC.assign(M.size(), -1);
 
-    for( size_t i = 0; i < M.size() - 1; i++ ){
-        for ( size_t j = i+1; j < M.size(); j++ ) {
-            std::vector<int> intersect;
-            std::set_intersection(column_index[i].begin(),
-                                  column_index[i].end(),
-                                  column_index[j].begin(),
-                                  column_index[j].end(),
-                                  std::back_inserter(intersect));
+    double *jv = A_ji.val_ptr();
+    for (int k = 0; k < A_ji.NumNonzeros(); k++) {
+        jv[k] *= -1.0;
+    }
+    
+
+#ifdef WIP
+    if(filter_c != 0 || icntl[Controls::aug_iterative] != 0) {
+        std::vector<int> selected_cols;
+        std::vector<double> frob_ij, mu;
+
+        frob_ij.reserve(A_ij.dim(1));
+        mu.reserve(A_ij.dim(1));
+        double card_max = 0;
+        double frob_sum = 0;
+        double nu;
 
-            if (intersect.empty()) continue;
+        for (int k = 0; k < A_ij.dim(1); ++k){
+            VECTOR_int A_ij_k_ind, A_ji_k_ind;
+            VECTOR_double A_ij_k = middleCol(A_ij, k, A_ij_k_ind);
+            VECTOR_double A_ji_k = middleCol(A_ji, k, A_ji_k_ind);
 
-            CompCol_Mat_double A_ij(sub_matrix(M[i], intersect));
-            CompCol_Mat_double A_ji(sub_matrix(M[j], intersect));
+            double card_current = A_ij_k_ind.size() * A_ji_k_ind.size();
 
-            double *jv = A_ji.val_ptr();
-            for (int k = 0; k < A_ji.NumNonzeros(); k++) {
-                jv[k] *= -1.0;
+            // exploit the sparcity of the vectors!
+            frob_ij.push_back(sqrt( squaredNorm(A_ij_k, A_ij_k_ind) * squaredNorm(A_ji_k, A_ji_k_ind)));
+            frob_sum += frob_ij[k];
+
+            card_max = card_max > card_current ? card_max : card_current;
+        }
+
+        nu = (frob_sum / frob_ij.size()) / sqrt(card_max);
+
+        for (int k = 0; k < A_ij.dim(1); ++k){
+            VECTOR_int A_ij_k_ind, A_ji_k_ind;
+            VECTOR_double A_ij_k = middleCol(A_ij, k, A_ij_k_ind);
+            VECTOR_double A_ji_k = middleCol(A_ji, k, A_ji_k_ind);
+
+            double inf_ij = infNorm(A_ij_k);
+            double inf_ji = infNorm(A_ji_k);
+
+            double p = 0, q = 0;
+            for (int l = 0; l < A_ij_k_ind.size(); ++l){
+                if (abs(A_ij_k(A_ij_k_ind(l))) >= nu/inf_ji) p++;
+            }
+            for (int l = 0; l < A_ji_k_ind.size(); ++l){
+                if (abs(A_ji_k(A_ji_k_ind(l))) >= nu/inf_ij) q++;
             }
-            
 
-#ifdef WIP
-            if(filter_c != 0 || icntl[Controls::aug_iterative] != 0) {
-                std::vector<int> selected_cols;
-                std::vector<double> frob_ij, mu;
-
-                frob_ij.reserve(A_ij.dim(1));
-                mu.reserve(A_ij.dim(1));
-                double card_max = 0;
-                double frob_sum = 0;
-                double nu;
-
-                for (int k = 0; k < A_ij.dim(1); ++k){
-                    VECTOR_int A_ij_k_ind, A_ji_k_ind;
-                    VECTOR_double A_ij_k = middleCol(A_ij, k, A_ij_k_ind);
-                    VECTOR_double A_ji_k = middleCol(A_ji, k, A_ji_k_ind);
-
-                    double card_current = A_ij_k_ind.size() * A_ji_k_ind.size();
-
-                    // exploit the sparcity of the vectors!
-                    frob_ij.push_back(sqrt( squaredNorm(A_ij_k, A_ij_k_ind) * squaredNorm(A_ji_k, A_ji_k_ind)));
-                    frob_sum += frob_ij[k];
-
-                    card_max = card_max > card_current ? card_max : card_current;
-                }
-
-                nu = (frob_sum / frob_ij.size()) / sqrt(card_max);
-
-                for (int k = 0; k < A_ij.dim(1); ++k){
-                    VECTOR_int A_ij_k_ind, A_ji_k_ind;
-                    VECTOR_double A_ij_k = middleCol(A_ij, k, A_ij_k_ind);
-                    VECTOR_double A_ji_k = middleCol(A_ji, k, A_ji_k_ind);
-
-                    double inf_ij = infNorm(A_ij_k);
-                    double inf_ji = infNorm(A_ji_k);
-
-                    double p = 0, q = 0;
-                    for (int l = 0; l < A_ij_k_ind.size(); ++l){
-                        if (abs(A_ij_k(A_ij_k_ind(l))) >= nu/inf_ji) p++;
-                    }
-                    for (int l = 0; l < A_ji_k_ind.size(); ++l){
-                        if (abs(A_ji_k(A_ji_k_ind(l))) >= nu/inf_ij) q++;
-                    }
-
-                    p = ( p==0 ? A_ij_k_ind.size() : p );
-                    q = ( q==0 ? A_ji_k_ind.size() : q );
-
-                    double mu_ij_k = frob_ij[k] / sqrt(p*q);
-                    mu.push_back(mu_ij_k);
-
-                    if(mu_ij_k >= filter_c){
-                        selected_cols.push_back(k);
-                    }
-
-                    if(icntl[Controls::aug_iterative] != 0){ 
-                        if (dcntl[Controls::aug_precond] < 0) {
-                            if ((nbcols + k - n_o) % abs((int)dcntl[Controls::aug_precond]) == 0)
-                                selected_S_columns.push_back( nbcols + k - n_o);
-                            else
-                                skipped_S_columns.push_back( nbcols + k - n_o);
-                        } else {
-                            if (mu_ij_k >= dcntl[Controls::aug_precond])
-                                selected_S_columns.push_back( nbcols + k - n_o);
-                            else
-                                skipped_S_columns.push_back( nbcols + k - n_o);
-                        }
-                    }
-
-                }
-
-                if (selected_cols.empty()) continue;
-
-                if( icntl[Controls::aug_iterative] != 2 ) { // don't reduce the A_ij/A_ji, we just need the selected columns!
-                    A_ij = sub_matrix(A_ij, selected_cols);
-                    A_ji = sub_matrix(A_ji, selected_cols);
-                }
+            p = ( p==0 ? A_ij_k_ind.size() : p );
+            q = ( q==0 ? A_ji_k_ind.size() : q );
+
+            double mu_ij_k = frob_ij[k] / sqrt(p*q);
+            mu.push_back(mu_ij_k);
+
+            if(mu_ij_k >= filter_c){
+                selected_cols.push_back(k);
             }
-#endif //WIP
 
-            stCols[i].push_back(nbcols);
-            stCols[j].push_back(nbcols);
-            C[i].push_back(A_ij);
-            C[j].push_back(A_ji);
+        }
+
+        if (selected_cols.empty()) return false;
 
-            nbcols += A_ij.dim(1);
+        if( icntl[Controls::aug_iterative] != 2 ) { // don't reduce the A_ij/A_ji, we just need the selected columns!
+            A_ij = sub_matrix(A_ij, selected_cols);
+            A_ji = sub_matrix(A_ji, selected_cols);
         }
     }
+#endif //WIP
+
+    pb.C_i = A_ij;
+    pb.C_j = A_ji;
+    pb.main = 0;
+    return true;
+}
+
+void abcd::aijAugmentMatrix(std::vector<CompCol_Mat_double> &M)
+{
+
+    int nbcols = A.dim(1);
+    std::map<int,std::vector<CompCol_Mat_double> > C;
+    std::map<int,std::vector<int> > stCols;
+    stC.assign(M.size(), -1);
+
+    std::map<std::pair<int, int>, PairBlocks> blocks;
+    abcd::localPairBlocks(M, column_index, blocks);
+
+    for(std::map<std::pair<int, int>, PairBlocks>::iterator it = blocks.begin();
+            it != blocks.end(); ++it) {
+        int i = it->first.first;
+        int j = it->first.second;
+        PairBlocks &pb = it->second;
+
+        if(icntl[Controls::aug_iterative] != 0)
+            selectSColumns(pb.C_i, &pb.C_j, nbcols);
+
+        stCols[i].push_back(nbcols);
+        stCols[j].push_back(nbcols);
+        C[i].push_back(pb.C_i);
+        C[j].push_back(pb.C_j);
+
+        nbcols += pb.C_i.dim(1);
+    }
+    blocks.clear();
 
     size_c = nbcols - A.dim(1);
     n = nbcols;
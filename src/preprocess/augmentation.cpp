@@ -41,6 +41,8 @@
 void abcd::augmentMatrix ( std::vector<CompCol_Mat_double> &M)
 {
     stC = std::vector<int>(M.size(), -1);
+    selected_S_columns.clear();
+    skipped_S_columns.clear();
 
     if(icntl[Controls::aug_type] == 0){
         // No augmentation 
@@ -59,3 +61,91 @@ void abcd::augmentMatrix ( std::vector<CompCol_Mat_double> &M)
     }
 
 }// [> -----  end of function abcd::augmentMatrix  ----- <]
+
+/* 
+ * ===  FUNCTION  ======================================================================
+ *         Name:  abcd::pairBlocks
+ *  Description:  Builds the blocks of the augmentation between a pair of
+ *                partitions with the scheme given by aug_type
+ * =====================================================================================
+ */
+bool abcd::pairBlocks(CompCol_Mat_double &A_ij, CompCol_Mat_double &A_ji, PairBlocks &pb)
+{
+    if (icntl[Controls::aug_type] == 1)
+        return cijPairBlocks(A_ij, A_ji, pb);
+    return aijPairBlocks(A_ij, A_ji, pb);
+}// [> -----  end of function abcd::pairBlocks  ----- <]
+
+/* 
+ * ===  FUNCTION  ======================================================================
+ *         Name:  abcd::localPairBlocks
+ *  Description:  Builds on this process the blocks of the augmentation for
+ *                all the pairs of partitions, ci holds the columns of A in
+ *                each partition
+ * =====================================================================================
+ */
+void abcd::localPairBlocks(std::vector<CompCol_Mat_double> &M,
+                           std::vector<std::vector<int> > &ci,
+                           std::map<std::pair<int, int>, PairBlocks> &blocks)
+{
+    for( size_t i = 0; i < M.size() - 1; i++ ){
+        for ( size_t j = i+1; j < M.size(); j++ ) {
+            std::vector<int> intersect;
+            std::set_intersection(ci[i].begin(),
+                                  ci[i].end(),
+                                  ci[j].begin(),
+                                  ci[j].end(),
+                                  std::back_inserter(intersect));
+
+            if (intersect.empty()) continue;
+
+            CompCol_Mat_double A_ij(sub_matrix(M[i], intersect));
+            CompCol_Mat_double A_ji(sub_matrix(M[j], intersect));
+
+            PairBlocks pb;
+            if (pairBlocks(A_ij, A_ji, pb))
+                blocks[std::make_pair((int) i, (int) j)] = pb;
+        }
+    }
+}// [> -----  end of function abcd::localPairBlocks  ----- <]
+
+/* 
+ * ===  FUNCTION  ======================================================================
+ *         Name:  abcd::selectSColumns
+ *  Description:  Selects the columns of S kept in the preconditioner of
+ *                the iterative solve of Sz = f
+ *
+ *  C_i and C_j are the two blocks of the augmentation between a pair of
+ *  partitions, their columns start at the column first of [A C]. The
+ *  weight of a column is the product of its norms in both blocks, C_j
+ *  is null when its columns have a unit norm.
+ * =====================================================================================
+ */
+void abcd::selectSColumns(CompCol_Mat_double &C_i, CompCol_Mat_double *C_j, int first)
+{
+    double sel = dcntl[Controls::aug_precond];
+    if(sel == 0) return;
+
+    for(int k = 0; k < C_i.dim(1); k++) {
+        int c = first + k - n_o;
+        bool keep;
+
+        if(sel < 0) {
+            keep = c % std::max(1, (int) -sel) == 0;
+        } else {
+            double ni = 0, nj = 1;
+            for(int l = C_i.col_ptr(k); l < C_i.col_ptr(k + 1); l++)
+                ni += C_i.val(l) * C_i.val(l);
+            if(C_j != nullptr) {
+                nj = 0;
+                for(int l = C_j->col_ptr(k); l < C_j->col_ptr(k + 1); l++)
+                    nj += C_j->val(l) * C_j->val(l);
+            }
+
+            keep = sqrt(ni * nj) >= sel;
+        }
+
+        if(keep) selected_S_columns.push_back(c);
+        else skipped_S_columns.push_back(c);
+    }
+}// [> -----  end of function abcd::selectSColumns  ----- <]
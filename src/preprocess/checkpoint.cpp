@@ -0,0 +1,251 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#include <abcd.h>
+#include <fstream>
+#include <stdint.h>
+#include <climits>
+
+/// Binary checkpoint of the preprocessed problem
+///
+/// The file starts with a magic and a version, followed by the sizes,
+/// the scaling, the row permutation and the partitioning, the scaled
+/// and permuted matrix A, the compressed partitions with their column
+/// indices, the starting columns of C and finally the columns of S
+/// selected and skipped for the preconditioner of the iterative solve
+/// of Sz = f. The arrays are written as they are in memory, a checkpoint
+/// is read on the kind of machine that wrote it.
+
+namespace {
+
+const char checkpoint_magic[8] = "ABCDCKP";
+const int32_t checkpoint_version = 2;
+
+template <typename T>
+void writeArray(std::ofstream &f, const T *v, int64_t n)
+{
+    f.write(reinterpret_cast<const char *>(v), sizeof(T) * n);
+}
+
+template <typename T>
+void writeVector(std::ofstream &f, const std::vector<T> &v)
+{
+    int64_t n = v.size();
+    writeArray(f, &n, 1);
+    writeArray(f, v.data(), n);
+}
+
+void writeCSR(std::ofstream &f, CompRow_Mat_double &M)
+{
+    int64_t dims[3] = {M.dim(0), M.dim(1), M.NumNonzeros()};
+    writeArray(f, dims, 3);
+    writeArray(f, M.rowptr_ptr(), dims[0] + 1);
+    writeArray(f, M.colind_ptr(), dims[2]);
+    writeArray(f, M.val_ptr(), dims[2]);
+}
+
+template <typename T>
+bool readArray(std::ifstream &f, T *v, int64_t n)
+{
+    f.read(reinterpret_cast<char *>(v), sizeof(T) * n);
+    return f.good();
+}
+
+/// Reads a vector, its size is bounded by the size of the file
+template <typename T>
+bool readVector(std::ifstream &f, std::vector<T> &v, int64_t bytes)
+{
+    int64_t n;
+    if(!readArray(f, &n, 1) || n < 0 || n * (int64_t) sizeof(T) > bytes) return false;
+    v.resize(n);
+    return readArray(f, v.data(), n);
+}
+
+/// Checks that the n indices of v are in [lo, hi)
+bool inRange(const int *v, int64_t n, int64_t lo, int64_t hi)
+{
+    for(int64_t k = 0; k < n; k++)
+        if(v[k] < lo || v[k] >= hi) return false;
+    return true;
+}
+
+bool inRange(const std::vector<int> &v, int64_t lo, int64_t hi)
+{
+    return inRange(v.data(), v.size(), lo, hi);
+}
+
+bool readCSR(std::ifstream &f, CompRow_Mat_double &M, int64_t bytes)
+{
+    int64_t dims[3];
+    if(!readArray(f, dims, 3) || dims[0] < 0 || dims[1] < 0 || dims[2] < 0 ||
+       (dims[0] + 1) * (int64_t) sizeof(int) + dims[2] * (int64_t) (sizeof(int) + sizeof(double)) > bytes)
+        return false;
+
+    M.newsize(dims[0], dims[1], dims[2]);
+    if(!readArray(f, M.rowptr_ptr(), dims[0] + 1) ||
+       !readArray(f, M.colind_ptr(), dims[2]) ||
+       !readArray(f, M.val_ptr(), dims[2]))
+        return false;
+
+    // the solver trusts the structure, an entry out of its row or of
+    // the matrix would be read or written out of bounds
+    int *rp = M.rowptr_ptr();
+    if(rp[0] != 0 || rp[dims[0]] != dims[2]) return false;
+    for(int64_t i = 0; i < dims[0]; i++)
+        if(rp[i + 1] < rp[i]) return false;
+
+    return inRange(M.colind_ptr(), dims[2], 0, dims[1]);
+}
+
+} // namespace
+
+/// Writes the result of the preprocessing to abcd::write_checkpoint
+void abcd::writeCheckpoint()
+{
+    double t = MPI_Wtime();
+    LINFO << "Writing the checkpoint to the file: " << write_checkpoint;
+
+    std::ofstream f(write_checkpoint.c_str(), std::ios::binary);
+
+    int64_t sizes[7] = {m_o, n_o, nz_o, n, size_c,
+                        icntl[Controls::nbparts], icntl[Controls::aug_type]};
+
+    f.write(checkpoint_magic, 8);
+    writeArray(f, &checkpoint_version, 1);
+    writeArray(f, sizes, 7);
+
+    writeVector(f, drow_);
+    writeVector(f, dcol_);
+    writeVector(f, row_perm);
+    writeVector(f, a_entries);
+    writeVector(f, strow);
+    writeVector(f, nbrows);
+
+    writeCSR(f, A);
+    for(int k = 0; k < icntl[Controls::nbparts]; k++) {
+        writeCSR(f, parts[k]);
+        writeVector(f, column_index[k]);
+    }
+    writeVector(f, stC);
+    writeVector(f, selected_S_columns);
+    writeVector(f, skipped_S_columns);
+
+    f.close();
+    if(!f) {
+        info[Controls::status] = -16;
+        mpi::broadcast(comm, info[Controls::status], 0);
+        throw std::runtime_error("The checkpoint cannot be written.");
+    }
+
+    LINFO << "Checkpoint written in " << MPI_Wtime() - t << "s.";
+}
+
+/// Reads the result of the preprocessing from abcd::read_checkpoint
+void abcd::readCheckpoint()
+{
+    double t = MPI_Wtime();
+    LINFO << "Reading the checkpoint from the file: " << read_checkpoint;
+
+    std::ifstream f(read_checkpoint.c_str(), std::ios::binary | std::ios::ate);
+    int64_t bytes = f ? (int64_t) f.tellg() : 0;
+    f.seekg(0);
+
+    char magic[8];
+    int32_t version;
+    int64_t sizes[7];
+    bool ok = f.good() &&
+        readArray(f, magic, 8) && std::equal(magic, magic + 8, checkpoint_magic) &&
+        readArray(f, &version, 1) && version == checkpoint_version &&
+        readArray(f, sizes, 7) && sizes[5] > 0 && sizes[5] <= sizes[0];
+
+    if(ok) {
+        m_o = sizes[0];
+        n_o = sizes[1];
+        nz_o = sizes[2];
+        n = sizes[3];
+        size_c = sizes[4];
+        icntl[Controls::nbparts] = sizes[5];
+        icntl[Controls::aug_type] = sizes[6];
+        m = m_o;
+        nz = nz_o;
+
+        ok = readVector(f, drow_, bytes) && readVector(f, dcol_, bytes) &&
+             readVector(f, row_perm, bytes) && readVector(f, a_entries, bytes) &&
+             readVector(f, strow, bytes) && readVector(f, nbrows, bytes) &&
+             readCSR(f, A, bytes);
+    }
+
+    if(ok) {
+        parts.clear();
+        column_index.assign(icntl[Controls::nbparts], std::vector<int>());
+        for(int k = 0; k < icntl[Controls::nbparts] && ok; k++) {
+            ok = readCSR(f, parts[k], bytes) && readVector(f, column_index[k], bytes);
+        }
+        ok = ok && readVector(f, stC, bytes) &&
+             readVector(f, selected_S_columns, bytes) &&
+             readVector(f, skipped_S_columns, bytes);
+    }
+
+    int nbp = icntl[Controls::nbparts];
+    ok = ok && (int) drow_.size() == m_o && (int) dcol_.size() == n_o &&
+         A.dim(0) == m_o && A.dim(1) == n_o && n >= n_o && size_c >= 0 &&
+         (row_perm.empty() || ((int) row_perm.size() == m_o && inRange(row_perm, 0, m_o))) &&
+         (a_entries.empty() ||
+          ((int) a_entries.size() == A.NumNonzeros() && inRange(a_entries, 0, INT_MAX))) &&
+         (int) nbrows.size() == nbp && (int) strow.size() == nbp;
+
+    // the partitions are consecutive blocks of rows of A, their columns
+    // are those of A and C
+    for(int k = 0, row_sum = 0; k < nbp && ok; k++) {
+        ok = nbrows[k] >= 0 && strow[k] == row_sum &&
+             parts[k].dim(0) == nbrows[k] &&
+             parts[k].dim(1) == (int) column_index[k].size() &&
+             inRange(column_index[k], 0, n);
+        row_sum += nbrows[k];
+        if(k == nbp - 1) ok = ok && row_sum == m_o;
+    }
+
+    // the first column of C in each partition, -1 when it has none
+    for(unsigned int k = 0; k < stC.size() && ok; k++)
+        ok = stC[k] == -1 || (stC[k] >= n_o && stC[k] < n);
+    ok = ok && (stC.empty() || (int) stC.size() == nbp) &&
+         inRange(selected_S_columns, 0, size_c) &&
+         inRange(skipped_S_columns, 0, size_c);
+
+    if(!ok) {
+        info[Controls::status] = -16;
+        mpi::broadcast(comm, info[Controls::status], 0);
+        throw std::runtime_error("The checkpoint cannot be read, it is missing or corrupted.");
+    }
+
+    LINFO << "Checkpoint read in " << MPI_Wtime() - t << "s.";
+}
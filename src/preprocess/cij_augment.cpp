@@ -32,172 +32,169 @@
 
 #include "abcd.h"
 
-void abcd::cijAugmentMatrix(std::vector<CompCol_Mat_double> &M)
+/// Builds the blocks of the C_ij/-I augmentation between a pair of
+/// partitions from their columns in common
+/// \param A_ij The columns in common of the first partition
+/// \param A_ji The columns in common of the second partition
+/// \param pb The blocks, pb.main tells which one is C_ij
+/// \return false when the pair needs no augmentation
+bool abcd::cijPairBlocks(CompCol_Mat_double &A_ij_c, CompCol_Mat_double &A_ji_c, PairBlocks &pb)
 {
-    int nbcols = A.dim(1);
-    int nz_c = 0;
-    std::map<int,std::vector<CompCol_Mat_double> > C;
-    std::map<int,std::vector<int> > stCols;
 #ifdef WIP
     double filter_c = dcntl[Controls::aug_filter];
 #else
     double filter_c = 0;
 #endif //WIP
-    stC = std::vector<int>(M.size(), -1);
-
-    if (icntl[Controls::scaling] == 0)
-      LINFO << "Using C_ij based augmentation gives better results with scaling";
 
+    CompCol_Mat_double C_ij;
+    {
+        CompRow_Mat_double A_ij(A_ij_c);
+        CompRow_Mat_double A_ji(A_ji_c);
+        CompRow_Mat_double A_jiT = csr_transpose(A_ji);
+        C_ij = spmm(A_ij, A_jiT);
+    }
 
-    for( size_t i = 0; i < M.size() - 1; i++ ){
-        for ( size_t j = i+1; j < M.size(); j++ ) {
-            std::vector<int> intersect;
-            std::set_intersection(column_index[i].begin(),
-                                  column_index[i].end(),
-                                  column_index[j].begin(),
-                                  column_index[j].end(),
-                                  std::back_inserter(intersect));
+    if(C_ij.NumNonzeros() == 0) return false;
+
+    /*-----------------------------------------------------------------------------
+     *  Compress C_ij
+     *-----------------------------------------------------------------------------*/
+    std::vector<int> cic, cir, ci;
+    bool reversed = false;
+
+    //[> Compute the Column compression <]
+    int l = 0;
+    for(int k = 1; k <= C_ij.dim(1); k++) {
+        if(C_ij.col_ptr(k) != C_ij.col_ptr(k - 1)){
+            bool valid = false;
+            int coli = C_ij.col_ptr(k-1);
+            while(coli < C_ij.col_ptr(k)){
+                if(abs(C_ij.val(coli)) >= filter_c){
+                    valid = true;
+                    break;
+                }
 
-            if (intersect.empty()) continue;
+#ifdef WIP
+                if( icntl[Controls::aug_iterative] != 2 ){ // don't reduce, we just need the selected columns!
+                    valid = true; // let the force be with you, always!
+                    break;
+                }
+#endif //WIP
 
-            CompCol_Mat_double C_ij;
-            {
-                CompRow_Mat_double A_ij(sub_matrix(M[i], intersect));
-                CompRow_Mat_double A_ji(sub_matrix(M[j], intersect));
-                CompRow_Mat_double A_jiT = csr_transpose(A_ji);
-                C_ij = spmm(A_ij, A_jiT);
+                coli++;
             }
+            if(valid) cic.push_back(l);
+        }
+        l++;
+    }
 
-            if(C_ij.NumNonzeros() == 0) continue;
-
-            /*-----------------------------------------------------------------------------
-             *  Compress C_ij
-             *-----------------------------------------------------------------------------*/
-            std::vector<int> cic, cir, ci;
-            bool reversed = false;
-            std::vector<int> selected_cols;
-
-            //[> Compute the Column compression <]
-            int l = 0;
-            for(int k = 1; k <= C_ij.dim(1); k++) {
-                if(C_ij.col_ptr(k) != C_ij.col_ptr(k - 1)){
-                    bool valid = false;
-                    int coli = C_ij.col_ptr(k-1);
-                    while(coli < C_ij.col_ptr(k)){
-#ifdef WIP
-                        if(icntl[Controls::aug_iterative] != 0){ 
-                            if(abs(C_ij.val(coli)) >= dcntl[Controls::aug_precond]){
-                                selected_S_columns.push_back( nbcols + k - n_o);
-                            } else {
-                                skipped_S_columns.push_back( nbcols + k - n_o);
-                            }
-                        }
-
-#endif //WIP
-                        if(abs(C_ij.val(coli)) >= filter_c){
-                            valid = true;
-                            break;
-                        }
+    //[> Compute the Row compression <]
+    CompCol_Mat_double CT_ij = csc_transpose(C_ij);
+    l = 0;
+    for(int k = 1; k <= CT_ij.dim(1); k++) {
+        if(CT_ij.col_ptr(k) != CT_ij.col_ptr(k - 1)){
+            bool valid = false;
+            int coli = CT_ij.col_ptr(k-1);
+            while(coli < CT_ij.col_ptr(k)){
+                if(abs(CT_ij.val(coli)) >= filter_c){
+                    valid = true;
+                    break;
+                }
 
 #ifdef WIP
-                        if( icntl[Controls::aug_iterative] != 2 ){ // don't reduce, we just need the selected columns!
-                            valid = true; // let the force be with you, always!
-                            break;
-                        }
-#endif //WIP
-
-                        coli++;
-                    }
-                    if(valid) cic.push_back(l);
+                if( icntl[Controls::aug_iterative] != 2 ){ // don't reduce, we just need the selected columns!
+                    valid = true; // let the force be with you, always!
+                    break;
                 }
-                l++;
+#endif //WIP
+                coli++;
             }
+            if(valid) cir.push_back(l);
+        }
+        l++;
+    }
 
-            //[> Compute the Row compression <]
-            CompCol_Mat_double CT_ij = csc_transpose(C_ij);
-            l = 0;
-            for(int k = 1; k <= CT_ij.dim(1); k++) {
-                if(CT_ij.col_ptr(k) != CT_ij.col_ptr(k - 1)){
-                    bool valid = false;
-                    int coli = CT_ij.col_ptr(k-1);
-                    while(coli < CT_ij.col_ptr(k)){
-#ifdef WIP
-                        if(icntl[Controls::aug_iterative] != 0){ 
-                            if(abs(CT_ij.val(coli)) >= dcntl[Controls::aug_precond]){
-                                selected_S_columns.push_back( nbcols + k - n_o);
-                            } else {
-                                skipped_S_columns.push_back( nbcols + k - n_o);
-                            }
-                        }
 
-#endif //WIP
-                        if(abs(CT_ij.val(coli)) >= filter_c){
-                            valid = true;
-                            break;
-                        }
+    //[> If we have less rows than columns, then transpose C_ij <]
+    if(cic.size() <= cir.size()) {
+        ci = cic;
+    } else {
+        ci = cir;
+        C_ij = CT_ij;
+        reversed = true;
+    }
 
-#ifdef WIP
-                        if( icntl[Controls::aug_iterative] != 2 ){ // don't reduce, we just need the selected columns!
-                            valid = true; // let the force be with you, always!
-                            break;
-                        }
-#endif //WIP
-                        coli++;
-                    }
-                    if(valid) cir.push_back(l);
-                }
-                l++;
-            }
+    if(ci.empty()) return false;
 
+    int n_cij_before = C_ij.dim(1);
 
-            //[> If we have less rows than columns, then transpose C_ij <]
-            if(cic.size() <= cir.size()) {
-                ci = cic;
-            } else {
-                ci = cir;
-                C_ij = CT_ij;
-                reversed = true;
-            }
+    C_ij = sub_matrix(C_ij, ci);
 
-            if(ci.empty()) continue;
+    //// Build compressed I
+    CompCol_Mat_double I;
+    {
+        VECTOR_int ir(C_ij.dim(1));
+        VECTOR_int ic(C_ij.dim(1)+1);
+        VECTOR_double iv(C_ij.dim(1));
+        for(int k = 0; k < C_ij.dim(1); k++){
+            ir(k) = ci[k];
+            ic(k) = k;
+            iv(k) = -1.0;
+        }
+        ic(C_ij.dim(1)) = C_ij.dim(1);
 
-            int n_cij_before = C_ij.dim(1);
+        I = CompCol_Mat_double(n_cij_before, C_ij.dim(1), C_ij.dim(1),
+                iv, ir, ic);
+    }
 
-            C_ij = sub_matrix(C_ij, ci);
+    if(!reversed){
+        pb.C_i = C_ij;
+        pb.C_j = I;
+        pb.main = 0;
+    } else {
+        pb.C_i = I;
+        pb.C_j = C_ij;
+        pb.main = 1;
+    }
+    return true;
+}
 
-            //// Build compressed I
-            CompCol_Mat_double I;
-            {
-                VECTOR_int ir(C_ij.dim(1));
-                VECTOR_int ic(C_ij.dim(1)+1);
-                VECTOR_double iv(C_ij.dim(1));
-                for(int k = 0; k < C_ij.dim(1); k++){
-                    ir(k) = ci[k];
-                    ic(k) = k;
-                    iv(k) = -1.0;
-                }
-                ic(C_ij.dim(1)) = C_ij.dim(1) + 1;
+void abcd::cijAugmentMatrix(std::vector<CompCol_Mat_double> &M)
+{
+    int nbcols = A.dim(1);
+    int nz_c = 0;
+    std::map<int,std::vector<CompCol_Mat_double> > C;
+    std::map<int,std::vector<int> > stCols;
+    stC = std::vector<int>(M.size(), -1);
 
-                I = CompCol_Mat_double(n_cij_before, C_ij.dim(1), C_ij.dim(1),
-                        iv, ir, ic);
-            }
+    if (icntl[Controls::scaling] == 0)
+      LINFO << "Using C_ij based augmentation gives better results with scaling";
 
-            stCols[i].push_back(nbcols);
-            stCols[j].push_back(nbcols);
+    std::map<std::pair<int, int>, PairBlocks> blocks;
+    abcd::localPairBlocks(M, column_index, blocks);
 
-            if(!reversed){
-                C[i].push_back(C_ij);
-                C[j].push_back(I);
-            } else {
-                C[i].push_back(I);
-                C[j].push_back(C_ij);
-            }
+    for(std::map<std::pair<int, int>, PairBlocks>::iterator it = blocks.begin();
+            it != blocks.end(); ++it) {
+        int i = it->first.first;
+        int j = it->first.second;
+        PairBlocks &pb = it->second;
+        CompCol_Mat_double &C_ij = pb.main == 0 ? pb.C_i : pb.C_j;
 
-            nz_c += C_ij.NumNonzeros() + I.NumNonzeros();
-            nbcols += C_ij.dim(1);
-        }
+        // the columns of -I have a unit norm
+        if(icntl[Controls::aug_iterative] != 0)
+            selectSColumns(C_ij, nullptr, nbcols);
 
+        stCols[i].push_back(nbcols);
+        stCols[j].push_back(nbcols);
+
+        C[i].push_back(pb.C_i);
+        C[j].push_back(pb.C_j);
+
+        nz_c += pb.C_i.NumNonzeros() + pb.C_j.NumNonzeros();
+        nbcols += C_ij.dim(1);
     }
+    blocks.clear();
+
     LINFO << "Size of C : " << nbcols - A.dim(1);
     size_c = nbcols - A.dim(1);
     n = nbcols;
@@ -0,0 +1,1034 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#include <abcd.h>
+#include <vect_utils.h>
+#include <boost/serialization/vector.hpp>
+#include <list>
+
+// The distributed preprocessing is a set of jobs started by the master,
+// the other processes wait for them in abcd::preprocessMatrix. Each job
+// is announced with a broadcast of its number on comm, the partition k
+// is held by the process k % comm.size().
+
+/// Appends a compressed matrix to a message, ptr has np + 1 entries and
+/// may start at an offset of ind and v
+static void packMatrix(int rows, int cols, int np, const int *ptr,
+                       const int *ind, const double *v,
+                       std::vector<int> &mi, std::vector<double> &mv)
+{
+    mi.push_back(rows);
+    mi.push_back(cols);
+    mi.push_back(ptr[np] - ptr[0]);
+    for (int k = 0; k <= np; ++k)
+        mi.push_back(ptr[k] - ptr[0]);
+    mi.insert(mi.end(), ind + ptr[0], ind + ptr[np]);
+    mv.insert(mv.end(), v + ptr[0], v + ptr[np]);
+}
+
+static void packCSC(CompCol_Mat_double &M, std::vector<int> &mi, std::vector<double> &mv)
+{
+    packMatrix(M.dim(0), M.dim(1), M.dim(1), M.colptr_ptr(), M.rowind_ptr(),
+               M.val_ptr(), mi, mv);
+}
+
+static void packCSR(CompRow_Mat_double &M, std::vector<int> &mi, std::vector<double> &mv)
+{
+    packMatrix(M.dim(0), M.dim(1), M.dim(0), M.rowptr_ptr(), M.colind_ptr(),
+               M.val_ptr(), mi, mv);
+}
+
+/// Reads the matrix starting at pi and pv in a message and moves them past it
+static CompCol_Mat_double unpackCSC(std::vector<int> &mi, std::vector<double> &mv,
+                                    size_t &pi, size_t &pv)
+{
+    int rows = mi[pi], cols = mi[pi + 1], nnz = mi[pi + 2];
+    int *ptr = &mi[pi + 3];
+
+    CompCol_Mat_double M(rows, cols, nnz, mv.data() + pv, ptr + cols + 1, ptr);
+    pi += 3 + cols + 1 + nnz;
+    pv += nnz;
+    return M;
+}
+
+static CompRow_Mat_double unpackCSR(std::vector<int> &mi, std::vector<double> &mv,
+                                    size_t &pi, size_t &pv)
+{
+    int rows = mi[pi], cols = mi[pi + 1], nnz = mi[pi + 2];
+    int *ptr = &mi[pi + 3];
+
+    CompRow_Mat_double M(rows, cols, nnz, mv.data() + pv, ptr, ptr + rows + 1);
+    pi += 3 + rows + 1 + nnz;
+    pv += nnz;
+    return M;
+}
+
+extern "C"
+{
+    void dmumps_simscaleabs_(
+            int *irn_loc, int *jcn_loc, double *a_loc,
+            int *nz_loc, int *m, int *n, int *numprocs,
+            int *myid, int *comm, int *rpartvec, int *cpartvec,
+            int *rsndrcvsz, int *csndrcvsz, int *reg,
+            int *iwrk, int *iwrksz,
+            int *intsz, int *resz, int *op,
+            double *rowsca, double *colsca, double *wrkrc, int *iszwrkrc,
+            int *sym, int *nb1, int *nb2, int *nb3, double *eps,
+            double *onenormerr, double *infnormerr);
+}
+
+/// Runs the scaling of MUMPS on a block of rows held by each process
+///
+/// The same iterations as abcd::scaleMatrix, in parallel: MUMPS takes
+/// the entries of the block in the global numbering and reduces the
+/// norms of the rows and columns over comm.
+/// \param gm, gn The size of the whole matrix
+/// \param strow The global index of the first row of the block
+/// \param dr The scaling of the rows of the block
+/// \param dc The scaling of the columns, the same on all the processes
+/// \return The distance to one of the norms in infinity norm
+static double mumpsScaling(mpi::communicator &comm, int gm, int gn, int strow,
+                           int lm, const int *rp, const int *ci, const double *v,
+                           std::vector<double> &dr, std::vector<double> &dc)
+{
+    int numprocs = comm.size(), myid = comm.rank();
+    int nz_loc = rp[lm] - rp[0];
+
+    // MUMPS works on coordinates in the global 1-based numbering
+    std::vector<int> irn(nz_loc), jcn(nz_loc);
+    std::vector<double> a(v + rp[0], v + rp[lm]);
+    for (int i = 0; i < lm; ++i) {
+        for (int j = rp[i]; j < rp[i + 1]; ++j) {
+            irn[j - rp[0]] = strow + i + 1;
+            jcn[j - rp[0]] = ci[j] + 1;
+        }
+    }
+
+    int liwk = 4 * std::max(gm, gn);
+    std::vector<int> iwk(liwk, 0);
+    std::vector<int> rpartvec(gm), cpartvec(gn);
+    std::vector<int> rsndrcvsz(2 * numprocs), csndrcvsz(2 * numprocs);
+    int reg[12];
+
+    int co = MPI_Comm_c2f((MPI_Comm) comm);
+
+    // 10 iterations in inf-norm, 20 in 1-norm and 20 in inf-norm
+    int nb1 = 10, nb2 = 20, nb3 = 20;
+    double eps = 1e-8;
+    int issym = 0, lwk = 0, intsz, resz;
+    double err, errinf;
+
+    std::vector<double> dwk(1), rowsca(gm, 0), colsca(gn, 0);
+
+    // estimate memory
+    int job = 1;
+    dmumps_simscaleabs_(
+        irn.data(), jcn.data(), a.data(), &nz_loc, &gm, &gn, &numprocs, &myid, &co,
+        rpartvec.data(), cpartvec.data(), rsndrcvsz.data(), csndrcvsz.data(), reg,
+        iwk.data(), &liwk,
+        &intsz, &resz, &job,
+        rowsca.data(), colsca.data(), dwk.data(), &lwk,
+        &issym, &nb1, &nb2, &nb3, &eps, &err, &errinf);
+
+    if (liwk < intsz) {
+        liwk = intsz;
+        iwk.assign(liwk, 0);
+    }
+    lwk = resz;
+    dwk.assign(std::max(lwk, 1), 0);
+
+    // compute the scaling
+    job = 2;
+    dmumps_simscaleabs_(
+        irn.data(), jcn.data(), a.data(), &nz_loc, &gm, &gn, &numprocs, &myid, &co,
+        rpartvec.data(), cpartvec.data(), rsndrcvsz.data(), csndrcvsz.data(), reg,
+        iwk.data(), &liwk,
+        &intsz, &resz, &job,
+        rowsca.data(), colsca.data(), dwk.data(), &lwk,
+        &issym, &nb1, &nb2, &nb3, &eps, &err, &errinf);
+
+    // a process only gets the factors of the rows and columns of its
+    // entries, the empty ones keep a factor of one
+    dr.assign(lm, 1);
+    std::vector<double> lc(gn, 0);
+    for (int i = 0; i < lm; ++i) {
+        if (rp[i + 1] > rp[i]) dr[i] = 1 / rowsca[strow + i];
+        for (int j = rp[i]; j < rp[i + 1]; ++j) lc[ci[j]] = 1 / colsca[ci[j]];
+    }
+
+    dc.assign(gn, 0);
+    mpi::all_reduce(comm, lc.data(), gn, dc.data(), mpi::maximum<double>());
+    for (int j = 0; j < gn; ++j) {
+        if (dc[j] == 0) dc[j] = 1;
+    }
+
+    return errinf;
+}
+
+/// Scales the matrix with all the processes
+///
+/// The master splits A in contiguous blocks of rows with about the same
+/// number of nonzeros, the processes scale them with mumpsScaling.
+/// The master gets drow_ and dcol_.
+void abcd::distributedScaling()
+{
+    int job = 1;
+    int rank = comm.rank(), size = comm.size();
+    std::vector<int> mi;
+    std::vector<double> mv;
+    std::vector<int> strows;
+    int lm, ln;
+    int *rp, *ci;
+    double *v;
+
+    if (rank == 0) {
+        mpi::broadcast(comm, job, 0);
+
+        int *a_rp = A.rowptr_ptr();
+        double a_nz = A.NumNonzeros();
+
+        strows.assign(size + 1, m);
+        strows[0] = 0;
+        int b = 1;
+        for (int i = 0; i < m && b < size; ++i) {
+            while (b < size && a_rp[i] >= b * a_nz / size) strows[b++] = i;
+        }
+
+        mpi::broadcast(comm, strows, 0);
+
+        for (int r = 1; r < size; ++r) {
+            int nb = strows[r + 1] - strows[r];
+            mi.clear();
+            mv.clear();
+            packMatrix(nb, n, nb, a_rp + strows[r], A.colind_ptr(), A.val_ptr(), mi, mv);
+            comm.send(r, 90, mi);
+            comm.send(r, 91, mv);
+        }
+
+        lm = strows[1];
+        ln = n;
+        rp = a_rp;
+        ci = A.colind_ptr();
+        v = A.val_ptr();
+    } else {
+        mpi::broadcast(comm, strows, 0);
+        comm.recv(0, 90, mi);
+        comm.recv(0, 91, mv);
+
+        lm = mi[0];
+        ln = mi[1];
+        rp = &mi[3];
+        ci = rp + lm + 1;
+        v = mv.data();
+    }
+
+    std::vector<double> dr, dc;
+    double err = mumpsScaling(comm, strows[size], ln, strows[rank], lm, rp, ci, v, dr, dc);
+
+    if (rank == 0) {
+        std::copy(dr.begin(), dr.end(), drow_.begin());
+        for (int r = 1; r < size; ++r) {
+            comm.recv(r, 92, drow_.data() + strows[r], strows[r + 1] - strows[r]);
+        }
+        dcol_ = dc;
+
+        LINFO << "Scaling done on " << size << " processes, distance to one: " << err;
+    } else {
+        comm.send(0, 92, dr.data(), lm);
+    }
+}
+
+/// Extracts the partitions and their column index on the masters
+///
+/// The master splits the partitions between the masters as distributeData
+/// would, and sends the rows of each partition to the master holding it.
+/// The holder builds the partition and keeps it in dist_parts until
+/// adoptDistributedPartitions, only its column index goes back to the
+/// master.
+void abcd::distributedPartitions()
+{
+    int job = 2;
+    int rank = comm.rank();
+    std::vector<int> mi, ri;
+    std::vector<double> mv;
+
+    if (rank == 0) {
+        mpi::broadcast(comm, job, 0);
+
+        // the same split as the one of distributeData
+        partitionsSets.clear();
+        abcd::partitionWeights(partitionsSets, nbrows, parallel_cg);
+    }
+
+    // the processes follow the controls of the master
+    mpi::broadcast(comm, icntl, 0);
+    mpi::broadcast(comm, dcntl, 0);
+    mpi::broadcast(comm, m_o, 0);
+    mpi::broadcast(comm, n_o, 0);
+    mpi::broadcast(comm, n, 0);
+    mpi::broadcast(comm, parallel_cg, 0);
+    mpi::broadcast(comm, nbrows, 0);
+    mpi::broadcast(comm, partitionsSets, 0);
+
+    int nbp = icntl[Controls::nbparts];
+    part_holder.assign(nbp, 0);
+    for (size_t h = 0; h < partitionsSets.size(); ++h) {
+        for (size_t k = 0; k < partitionsSets[h].size(); ++k)
+            part_holder[partitionsSets[h][k]] = h;
+    }
+
+    dist_parts.clear();
+
+    if (rank == 0) {
+        for (int k = 0; k < nbp; ++k) {
+            if (part_holder[k] == 0) {
+                dist_parts[k] = CSC_middleRows(A, strow[k], nbrows[k]);
+                continue;
+            }
+
+            mi.clear();
+            mv.clear();
+            packMatrix(nbrows[k], n, nbrows[k], A.rowptr_ptr() + strow[k],
+                       A.colind_ptr(), A.val_ptr(), mi, mv);
+            comm.send(part_holder[k], 93, mi);
+            comm.send(part_holder[k], 94, mv);
+        }
+    } else {
+        for (int k = 0; k < nbp; ++k) {
+            if (part_holder[k] != rank) continue;
+
+            size_t pi = 0, pv = 0;
+            comm.recv(0, 93, mi);
+            comm.recv(0, 94, mv);
+            dist_parts[k] = CompCol_Mat_double(unpackCSR(mi, mv, pi, pv));
+        }
+    }
+
+    for (std::map<int, CompCol_Mat_double>::iterator it = dist_parts.begin();
+            it != dist_parts.end(); ++it) {
+        std::vector<int> c = getColumnIndex(it->second.colptr_ptr(), it->second.dim(1));
+
+        if (rank == 0) {
+            column_index[it->first] = c;
+        } else {
+            ri.push_back(it->first);
+            ri.push_back(c.size());
+            ri.insert(ri.end(), c.begin(), c.end());
+        }
+    }
+
+    if (rank == 0) {
+        for (int r = 1; r < parallel_cg; ++r) {
+            comm.recv(r, 95, ri);
+            for (size_t p = 0; p < ri.size(); p += 2 + ri[p + 1])
+                column_index[ri[p]].assign(ri.begin() + p + 2, ri.begin() + p + 2 + ri[p + 1]);
+        }
+    } else if (rank < parallel_cg) {
+        comm.send(0, 95, ri);
+    }
+}
+
+/// Builds the blocks of the augmentation with all the processes
+///
+/// The pair (i, j), i < j, is handled by the process holding i, the one
+/// holding j sends it the columns of j in common. The blocks stay on the
+/// process holding i.
+/// \param blocks The blocks of the pairs
+void abcd::distributedPairBlocks(std::map<std::pair<int, int>, PairBlocks> &blocks)
+{
+    int rank = comm.rank();
+
+    mpi::broadcast(comm, icntl[Controls::aug_type], 0);
+    mpi::broadcast(comm, icntl[Controls::aug_iterative], 0);
+#ifdef WIP
+    mpi::broadcast(comm, dcntl[Controls::aug_filter], 0);
+#endif //WIP
+    mpi::broadcast(comm, column_index, 0);
+
+    int nbp = column_index.size();
+
+    std::map<int, CompCol_Mat_double *> held;
+    for (int k = 0; k < nbp; ++k) {
+        if (part_holder[k] != rank) continue;
+        held[k] = &dist_parts[k];
+    }
+
+    // send the columns in common of our partitions in the order the
+    // holder of the first partition of each pair goes through them
+    std::list<std::vector<int> > si;
+    std::list<std::vector<double> > sv;
+    std::vector<mpi::request> reqs;
+    std::map<std::pair<int, int>, CompCol_Mat_double> local_ji;
+
+    for (int i = 0; i < nbp - 1; ++i) {
+        for (int j = i + 1; j < nbp; ++j) {
+            if (part_holder[j] != rank) continue;
+
+            std::vector<int> intersect;
+            std::set_intersection(column_index[i].begin(),
+                                  column_index[i].end(),
+                                  column_index[j].begin(),
+                                  column_index[j].end(),
+                                  std::back_inserter(intersect));
+
+            if (intersect.empty()) continue;
+
+            CompCol_Mat_double A_ji(sub_matrix(*held[j], intersect));
+
+            if (part_holder[i] == rank) {
+                local_ji[std::make_pair(i, j)] = A_ji;
+                continue;
+            }
+
+            si.push_back(std::vector<int>());
+            sv.push_back(std::vector<double>());
+            packCSC(A_ji, si.back(), sv.back());
+            reqs.push_back(comm.isend(part_holder[i], 97, si.back()));
+            reqs.push_back(comm.isend(part_holder[i], 98, sv.back()));
+        }
+    }
+
+    std::vector<int> mi;
+    std::vector<double> mv;
+
+    for (int i = 0; i < nbp - 1; ++i) {
+        if (part_holder[i] != rank) continue;
+
+        for (int j = i + 1; j < nbp; ++j) {
+            std::vector<int> intersect;
+            std::set_intersection(column_index[i].begin(),
+                                  column_index[i].end(),
+                                  column_index[j].begin(),
+                                  column_index[j].end(),
+                                  std::back_inserter(intersect));
+
+            if (intersect.empty()) continue;
+
+            std::pair<int, int> ij = std::make_pair(i, j);
+            CompCol_Mat_double A_ij(sub_matrix(*held[i], intersect));
+            CompCol_Mat_double A_ji;
+
+            if (part_holder[j] == rank) {
+                A_ji = local_ji[ij];
+                local_ji.erase(ij);
+            } else {
+                size_t pi = 0, pv = 0;
+                comm.recv(part_holder[j], 97, mi);
+                comm.recv(part_holder[j], 98, mv);
+                A_ji = unpackCSC(mi, mv, pi, pv);
+            }
+
+            PairBlocks pb;
+            if (pairBlocks(A_ij, A_ji, pb)) blocks[ij] = pb;
+        }
+    }
+
+    mpi::wait_all(reqs.begin(), reqs.end());
+}
+
+/// Creates the local rows of a matrix given by slices of rows
+///
+/// The process r gives the rows from its row_offset up to the row_offset
+/// of the process r + 1, or m for the last one, with their global
+/// indices in irn or as local CSR rows through row_ptr. Each process
+/// keeps its slice in A.
+int abcd::initializeDistributedMatrix()
+{
+    int rank = comm.rank(), size = comm.size();
+    int err = 0;
+
+    bool csr = row_ptr != nullptr;
+    if(nz > 0 && ((!csr && irn == nullptr) || jcn == nullptr || val == nullptr)) {
+        LOG_IF(!csr && irn == nullptr, ERROR) << "irn is not allocated";
+        LOG_IF(jcn == nullptr, ERROR) << "jcn is not allocated";
+        LOG_IF(val == nullptr, ERROR) << "val is not allocated";
+        err = -1;
+    }
+
+    if(m <= 0 || n <= 0 || nz < 0) {
+        LOG_IF(m <= 0, ERROR) << "m is negative or zero";
+        LOG_IF(n <= 0, ERROR) << "n is negative or zero";
+        LOG_IF(nz < 0, ERROR) << "nz is negative";
+        err = -2;
+    }
+
+    if(sym) {
+        LERROR << "A symmetric matrix cannot be given by slices of rows";
+        err = -2;
+    }
+
+    // the slices follow the ranks and cover the matrix
+    mpi::all_gather(comm, row_offset, row_slices);
+    row_slices.push_back(m);
+    if(row_slices[0] != 0) err = -2;
+    for(int r = 0; r < size; ++r) {
+        if(row_slices[r + 1] < row_slices[r]) err = -2;
+    }
+    if(err == 0 && csr) {
+        int lm = row_slices[rank + 1] - row_slices[rank];
+        if(row_ptr[0] != start_index || row_ptr[lm] - start_index != nz) {
+            LERROR << "row_ptr does not hold the local entries from start_index";
+            err = -2;
+        }
+    }
+
+    // each entry has to be in the slice of its process, A is built
+    // trusting the indices
+    if(err == 0) {
+        int lm = row_slices[rank + 1] - row_slices[rank];
+        int bad_ptr = 0, bad_row = 0, bad_col = 0;
+        if(csr) {
+            for(int i = 0; i < lm; ++i)
+                if(row_ptr[i + 1] < row_ptr[i]) bad_ptr = 1;
+        } else {
+            for(int k = 0; k < nz; ++k) {
+                int r = irn[k] - start_index - row_offset;
+                if(r < 0 || r >= lm) bad_row = 1;
+            }
+        }
+        for(int k = 0; k < nz; ++k)
+            if(jcn[k] - start_index < 0 || jcn[k] - start_index >= n) bad_col = 1;
+
+        LOG_IF(bad_ptr, ERROR) << "row_ptr is decreasing";
+        LOG_IF(bad_row, ERROR) << "irn has a row index out of the local slice";
+        LOG_IF(bad_col, ERROR) << "jcn has a column index out of the matrix";
+        if(bad_ptr || bad_row || bad_col) err = -2;
+    }
+
+    int g_err;
+    mpi::all_reduce(comm, err, g_err, mpi::minimum<int>());
+    if(g_err != 0) {
+        info[Controls::status] = g_err;
+        throw std::range_error("Errornous information about the distributed matrix");
+    }
+
+    double t = MPI_Wtime();
+    int lm = row_slices[rank + 1] - row_slices[rank];
+
+    LINFO << "M  = " << m << "  N  = " << n << "  local rows = " << lm << "  local NZ = " << nz;
+
+    if(csr) {
+        // the slice changes shape during the preprocessing, it is copied
+        // as is without going through the coordinates
+        for(int k = 0; k < nz; ++k) jcn[k] -= start_index;
+        for(int i = 0; i <= lm; ++i) row_ptr[i] -= start_index;
+        A = CompRow_Mat_double(lm, n, nz, val, row_ptr, jcn);
+    } else {
+        for(int k = 0; k < nz; ++k) {
+            irn[k] -= start_index + row_offset;
+            jcn[k] -= start_index;
+        }
+
+        Coord_Mat_double t_A;
+        t_A = Coord_Mat_double(lm, n, nz, val, irn, jcn, MV_Matrix_::ref);
+        A = CompRow_Mat_double(t_A);
+    }
+
+    LINFO << "> Local slice initialized in " << setprecision(2) << MPI_Wtime() - t << "s.";
+
+    n_o = n;
+    m_o = m;
+    mpi::all_reduce(comm, nz, nz_o, std::plus<int>());
+
+    return 0;
+}
+
+/// Scales, partitions and augments a matrix given by slices of rows
+///
+/// All the processes take part. Each one scales its slice and sends the
+/// rows of each partition to the master that will hold it, which builds
+/// its share of the augmentation. The master only gathers the scaling of
+/// the rows, the column indices and, for the partitioners working on the
+/// structure, the pattern of the matrix.
+void abcd::preprocessDistributedMatrix()
+{
+    int rank = comm.rank(), size = comm.size();
+    double t = MPI_Wtime();
+
+    // the processes follow the controls of the master
+    mpi::broadcast(comm, icntl, 0);
+    mpi::broadcast(comm, dcntl, 0);
+
+    if (rank == 0 && parallel_cg == 0) {
+        parallel_cg = icntl[Controls::nbparts] < size ? icntl[Controls::nbparts] : size;
+    }
+
+    if (m_o != n_o) {
+        if (rank == 0) LWARNING << "Matrix is not square, disabling the scaling";
+        icntl[Controls::scaling] = 0;
+    }
+
+    std::vector<double> dr(A.dim(0), 1);
+    dcol_.assign(n_o, 1);
+
+    if (icntl[Controls::scaling] > 0) {
+        LINFO << "Scaling the matrix";
+
+        double err = mumpsScaling(comm, m_o, n_o, row_slices[rank], A.dim(0),
+                                  A.rowptr_ptr(), A.colind_ptr(), A.val_ptr(), dr, dcol_);
+        diagScaleMatrix(dr, dcol_);
+
+        LINFO << "Scaling done on " << size << " processes, distance to one: " << err;
+    }
+
+    if (rank == 0) {
+        drow_.assign(m_o, 1);
+        std::copy(dr.begin(), dr.end(), drow_.begin());
+        for (int r = 1; r < size; ++r) {
+            comm.recv(r, 92, drow_.data() + row_slices[r], row_slices[r + 1] - row_slices[r]);
+        }
+
+        LINFO << "> Time to scale the matrix: " << MPI_Wtime() - t << "s.";
+    } else {
+        comm.send(0, 92, dr.data(), (int) dr.size());
+    }
+
+    t = MPI_Wtime();
+    abcd::distributedRowPartition();
+    LINFO << "> Time to partition the matrix: " << MPI_Wtime() - t << "s.";
+
+    if (icntl[Controls::aug_type] != 0) {
+        t = MPI_Wtime();
+        abcd::distributedAugmentation();
+        LINFO << "Augmentation time: " << MPI_Wtime() - t << "s.";
+    }
+}
+
+/// Partitions a matrix given by slices of rows and sends the rows of each
+/// partition to the master that will hold it, in dist_parts
+///
+/// The partitioning runs on the master. PaToH and the multilevel
+/// partitioner need the whole pattern of the matrix, so its row pointers
+/// and column indices, but not its values, are gathered there in
+/// abcd::pattern_rp and abcd::pattern_ci for the time of the
+/// partitioning. The master also gets the column index of all the
+/// partitions.
+void abcd::distributedRowPartition()
+{
+    int rank = comm.rank(), size = comm.size();
+    int lm = A.dim(0);
+    int *rp = A.rowptr_ptr();
+    int *ci = A.colind_ptr();
+    double *v = A.val_ptr();
+    bool structure = icntl[Controls::part_type] >= 3;
+    int err = 0;
+
+    std::vector<int> mi;
+    std::vector<double> mv;
+
+    if (rank == 0) {
+        if (icntl[Controls::part_refine] != 0) {
+            LWARNING << "The refinement by coupling needs the whole matrix, it is disabled with a distributed matrix";
+            icntl[Controls::part_refine] = 0;
+        }
+        if (write_problem.length() != 0) {
+            LWARNING << "The problem is not written with a distributed matrix";
+            write_problem = "";
+        }
+
+        if (structure) {
+            pattern_rp.assign(m_o + 1, 0);
+            pattern_ci.reserve(nz_o);
+
+            std::copy(rp, rp + lm + 1, pattern_rp.begin());
+            pattern_ci.insert(pattern_ci.end(), ci, ci + rp[lm]);
+            for (int r = 1; r < size; ++r) {
+                comm.recv(r, 101, mi);
+                int st = row_slices[r], nb = row_slices[r + 1] - st;
+                for (int i = 1; i <= nb; ++i) pattern_rp[st + i] = pattern_rp[st] + mi[i];
+                pattern_ci.insert(pattern_ci.end(), mi.begin() + nb + 1, mi.end());
+            }
+        }
+
+        abcd::partitionMatrix();
+
+        std::vector<int>().swap(pattern_rp);
+        std::vector<int>().swap(pattern_ci);
+
+        abcd::partitionWeights(partitionsSets, nbrows, parallel_cg);
+
+        // tell the others that the partitioning went alright, on failure
+        // partitionMatrix sends them its status
+        mpi::broadcast(comm, err, 0);
+    } else {
+        if (structure) {
+            mi.assign(rp, rp + lm + 1);
+            mi.insert(mi.end(), ci, ci + rp[lm]);
+            comm.send(0, 101, mi);
+        }
+
+        mpi::broadcast(comm, err, 0);
+        if (err != 0) {
+            info[Controls::status] = err;
+            throw std::runtime_error("The master asked me to stop.");
+        }
+    }
+
+    mpi::broadcast(comm, icntl[Controls::nbparts], 0);
+    mpi::broadcast(comm, parallel_cg, 0);
+    mpi::broadcast(comm, strow, 0);
+    mpi::broadcast(comm, nbrows, 0);
+    mpi::broadcast(comm, partitionsSets, 0);
+
+    int nbp = icntl[Controls::nbparts];
+    part_holder.assign(nbp, 0);
+    for (size_t h = 0; h < partitionsSets.size(); ++h) {
+        for (size_t k = 0; k < partitionsSets[h].size(); ++k)
+            part_holder[partitionsSets[h][k]] = h;
+    }
+
+    // the position of the local rows once permuted
+    std::vector<int> pos(lm);
+    int permuted = rank == 0 && row_perm.size() != 0;
+    mpi::broadcast(comm, permuted, 0);
+
+    if (!permuted) {
+        for (int i = 0; i < lm; ++i) pos[i] = row_slices[rank] + i;
+    } else if (rank == 0) {
+        std::vector<int> inv(m_o);
+        for (int i = 0; i < m_o; ++i) inv[row_perm[i]] = i;
+
+        std::copy(inv.begin(), inv.begin() + lm, pos.begin());
+        for (int r = 1; r < size; ++r) {
+            comm.send(r, 102, inv.data() + row_slices[r], row_slices[r + 1] - row_slices[r]);
+        }
+    } else {
+        comm.recv(0, 102, pos.data(), lm);
+    }
+
+    // send each row with its position to the holder of its partition
+    std::vector<std::vector<int> > si(parallel_cg);
+    std::vector<std::vector<double> > sv(parallel_cg);
+
+    for (int i = 0; i < lm; ++i) {
+        int k = std::upper_bound(strow.begin(), strow.end(), pos[i]) - strow.begin() - 1;
+        int h = part_holder[k];
+
+        si[h].push_back(pos[i]);
+        si[h].push_back(rp[i + 1] - rp[i]);
+        si[h].insert(si[h].end(), ci + rp[i], ci + rp[i + 1]);
+        sv[h].insert(sv[h].end(), v + rp[i], v + rp[i + 1]);
+    }
+
+    std::vector<mpi::request> reqs;
+    for (int h = 0; h < parallel_cg; ++h) {
+        if (h == rank) continue;
+        reqs.push_back(comm.isend(h, 103, si[h]));
+        reqs.push_back(comm.isend(h, 104, sv[h]));
+    }
+
+    dist_parts.clear();
+
+    if (rank < parallel_cg) {
+        std::vector<std::vector<int> > bi(size);
+        std::vector<std::vector<double> > bv(size);
+
+        for (int r = 0; r < size; ++r) {
+            if (r == rank) {
+                bi[r].swap(si[rank]);
+                bv[r].swap(sv[rank]);
+            } else {
+                comm.recv(r, 103, bi[r]);
+                comm.recv(r, 104, bv[r]);
+            }
+        }
+
+        // the rows pointers of the partitions
+        std::map<int, std::vector<int> > ptr;
+        for (size_t l = 0; l < partitionsSets[rank].size(); ++l) {
+            int k = partitionsSets[rank][l];
+            ptr[k].assign(nbrows[k] + 1, 0);
+        }
+        for (int r = 0; r < size; ++r) {
+            for (size_t p = 0; p < bi[r].size(); p += 2 + bi[r][p + 1]) {
+                int k = std::upper_bound(strow.begin(), strow.end(), bi[r][p]) - strow.begin() - 1;
+                ptr[k][bi[r][p] - strow[k] + 1] = bi[r][p + 1];
+            }
+        }
+        for (std::map<int, std::vector<int> >::iterator it = ptr.begin(); it != ptr.end(); ++it) {
+            std::vector<int> &pk = it->second;
+            for (size_t i = 1; i < pk.size(); ++i) pk[i] += pk[i - 1];
+        }
+
+        std::map<int, std::vector<int> > ind;
+        std::map<int, std::vector<double> > vals;
+        for (std::map<int, std::vector<int> >::iterator it = ptr.begin(); it != ptr.end(); ++it) {
+            ind[it->first].resize(it->second.back());
+            vals[it->first].resize(it->second.back());
+        }
+        for (int r = 0; r < size; ++r) {
+            size_t pv = 0;
+            for (size_t p = 0; p < bi[r].size(); p += 2 + bi[r][p + 1]) {
+                int k = std::upper_bound(strow.begin(), strow.end(), bi[r][p]) - strow.begin() - 1;
+                int st = ptr[k][bi[r][p] - strow[k]];
+                int len = bi[r][p + 1];
+
+                std::copy(bi[r].begin() + p + 2, bi[r].begin() + p + 2 + len, ind[k].begin() + st);
+                std::copy(bv[r].begin() + pv, bv[r].begin() + pv + len, vals[k].begin() + st);
+                pv += len;
+            }
+            bi[r].clear();
+            bv[r].clear();
+        }
+
+        for (std::map<int, std::vector<int> >::iterator it = ptr.begin(); it != ptr.end(); ++it) {
+            int k = it->first;
+            CompRow_Mat_double rows(nbrows[k], n_o, it->second.back(), vals[k].data(),
+                                    it->second.data(), ind[k].data());
+            dist_parts[k] = CompCol_Mat_double(rows);
+            ind.erase(k);
+            vals.erase(k);
+        }
+    }
+
+    mpi::wait_all(reqs.begin(), reqs.end());
+
+    // the master gets the column index of all the partitions
+    if (rank == 0) column_index.assign(nbp, std::vector<int>());
+
+    mi.clear();
+    for (std::map<int, CompCol_Mat_double>::iterator it = dist_parts.begin();
+            it != dist_parts.end(); ++it) {
+        std::vector<int> c = getColumnIndex(it->second.colptr_ptr(), it->second.dim(1));
+
+        if (rank == 0) {
+            column_index[it->first] = c;
+        } else {
+            mi.push_back(it->first);
+            mi.push_back(c.size());
+            mi.insert(mi.end(), c.begin(), c.end());
+        }
+    }
+
+    if (rank == 0) {
+        for (int r = 1; r < parallel_cg; ++r) {
+            comm.recv(r, 105, mi);
+            for (size_t p = 0; p < mi.size(); p += 2 + mi[p + 1])
+                column_index[mi[p]].assign(mi.begin() + p + 2, mi.begin() + p + 2 + mi[p + 1]);
+        }
+    } else if (rank < parallel_cg) {
+        comm.send(0, 105, mi);
+    }
+}
+
+/// Augments the partitions held in dist_parts, either those of a matrix
+/// given by slices of rows or those of abcd::distributedPartitions
+///
+/// The blocks of each pair stay on the holder of its first partition.
+/// The master numbers the columns of C in the order of the pairs, as in
+/// the centralized augmentation, and each holder sends the second block
+/// of its pairs to the holder of the second partition. The holders then
+/// augment their partitions in dist_parts.
+void abcd::distributedAugmentation()
+{
+    int job = 3;
+    int rank = comm.rank(), size = comm.size();
+    int nbp = icntl[Controls::nbparts];
+    std::map<std::pair<int, int>, PairBlocks> blocks;
+
+    if (rank == 0 && icntl[Controls::dist_input] == 0) mpi::broadcast(comm, job, 0);
+
+    stC.assign(nbp, -1);
+    selected_S_columns.clear();
+    skipped_S_columns.clear();
+
+    abcd::distributedPairBlocks(blocks);
+
+    // the master numbers the columns of C
+    std::vector<int> pl;
+    for (std::map<std::pair<int, int>, PairBlocks>::iterator it = blocks.begin();
+            it != blocks.end(); ++it) {
+        pl.push_back(it->first.first);
+        pl.push_back(it->first.second);
+        pl.push_back(it->second.C_i.dim(1));
+    }
+
+    if (rank == 0) {
+        std::map<std::pair<int, int>, int> widths;
+        for (int r = 0; r < size; ++r) {
+            if (r != 0) comm.recv(r, 106, pl);
+            for (size_t p = 0; p < pl.size(); p += 3)
+                widths[std::make_pair(pl[p], pl[p + 1])] = pl[p + 2];
+        }
+
+        int nbcols = n_o;
+        pl.clear();
+        for (std::map<std::pair<int, int>, int>::iterator it = widths.begin();
+                it != widths.end(); ++it) {
+            int i = it->first.first, j = it->first.second;
+            if (stC[i] < 0) stC[i] = nbcols;
+            if (stC[j] < 0) stC[j] = nbcols;
+
+            pl.push_back(i);
+            pl.push_back(j);
+            pl.push_back(nbcols);
+            nbcols += it->second;
+        }
+
+        size_c = nbcols - n_o;
+        n = nbcols;
+        LINFO << "Size of C : " << size_c;
+    } else {
+        comm.send(0, 106, pl);
+    }
+
+    mpi::broadcast(comm, pl, 0);
+    mpi::broadcast(comm, stC, 0);
+    mpi::broadcast(comm, size_c, 0);
+    mpi::broadcast(comm, n, 0);
+
+    // select the columns of S on the holders, the master merges them
+    if (icntl[Controls::aug_iterative] != 0) {
+        for (size_t p = 0; p < pl.size(); p += 3) {
+            std::pair<int, int> ij = std::make_pair(pl[p], pl[p + 1]);
+            if (part_holder[ij.first] != rank) continue;
+
+            PairBlocks &pb = blocks[ij];
+            if (icntl[Controls::aug_type] == 1)
+                selectSColumns(pb.main == 0 ? pb.C_i : pb.C_j, nullptr, pl[p + 2]);
+            else
+                selectSColumns(pb.C_i, &pb.C_j, pl[p + 2]);
+        }
+
+        if (rank == 0) {
+            std::vector<int> sel, skip;
+            for (int r = 1; r < size; ++r) {
+                comm.recv(r, 107, sel);
+                comm.recv(r, 108, skip);
+                selected_S_columns.insert(selected_S_columns.end(), sel.begin(), sel.end());
+                skipped_S_columns.insert(skipped_S_columns.end(), skip.begin(), skip.end());
+            }
+            std::sort(selected_S_columns.begin(), selected_S_columns.end());
+            std::sort(skipped_S_columns.begin(), skipped_S_columns.end());
+        } else {
+            comm.send(0, 107, selected_S_columns);
+            comm.send(0, 108, skipped_S_columns);
+            selected_S_columns.clear();
+            skipped_S_columns.clear();
+        }
+    }
+
+    // the second block of each pair goes to the holder of its partition,
+    // the pairs are in the same order on all the processes
+    std::map<int, std::vector<CompCol_Mat_double> > C;
+    std::map<int, std::vector<int> > stCols;
+    std::list<std::vector<int> > si;
+    std::list<std::vector<double> > sv;
+    std::vector<mpi::request> reqs;
+    std::vector<int> mi;
+    std::vector<double> mv;
+
+    for (size_t p = 0; p < pl.size(); p += 3) {
+        int i = pl[p], j = pl[p + 1], first = pl[p + 2];
+        int hi = part_holder[i], hj = part_holder[j];
+
+        if (hi == rank) {
+            PairBlocks &pb = blocks[std::make_pair(i, j)];
+
+            C[i].push_back(pb.C_i);
+            stCols[i].push_back(first);
+
+            if (hj == rank) {
+                C[j].push_back(pb.C_j);
+                stCols[j].push_back(first);
+            } else {
+                si.push_back(std::vector<int>());
+                sv.push_back(std::vector<double>());
+                packCSC(pb.C_j, si.back(), sv.back());
+                reqs.push_back(comm.isend(hj, 109, si.back()));
+                reqs.push_back(comm.isend(hj, 110, sv.back()));
+            }
+            blocks.erase(std::make_pair(i, j));
+        } else if (hj == rank) {
+            size_t pi = 0, pv = 0;
+            comm.recv(hi, 109, mi);
+            comm.recv(hi, 110, mv);
+            C[j].push_back(unpackCSC(mi, mv, pi, pv));
+            stCols[j].push_back(first);
+        }
+    }
+
+    mpi::wait_all(reqs.begin(), reqs.end());
+
+    for (std::map<int, std::vector<int> >::iterator it = stCols.begin();
+            it != stCols.end(); ++it) {
+        int k = it->first;
+        dist_parts[k] = concat_columns(dist_parts[k], C[k], it->second);
+        dist_parts[k] = resize_columns(dist_parts[k], n);
+        C.erase(k);
+    }
+
+    if (size_c == 0) {
+        if (rank == 0) LWARNING << "WARNING: Size of C is zero, switching to classical cg";
+        icntl[Controls::aug_type] = 0;
+    }
+}
+
+/// Takes the partitions of a matrix given by slices of rows as the local
+/// partitions of this master, they are already here in dist_parts
+/// \param colours The colour of each partition, on the master
+void abcd::adoptDistributedPartitions(std::vector<int> &colours)
+{
+    std::vector<int> all_stC = stC;
+
+    if (inter_comm.rank() == 0) {
+        // colour the partitions while all the column indices are here
+        if (icntl[Controls::kaczmarz] != 0 && icntl[Controls::aug_type] == 0)
+            abcd::colourPartitions(colours);
+
+        m_l = m;
+        n_l = n;
+    }
+
+    parts_id = partitionsSets[inter_comm.rank()];
+    column_index.clear();
+    stC.clear();
+    m = 0;
+    nz = 0;
+
+    for (size_t l = 0; l < parts_id.size(); ++l) {
+        int k = parts_id[l];
+        CompCol_Mat_double &part = dist_parts[k];
+        std::vector<int> ci = getColumnIndex(part.colptr_ptr(), part.dim(1));
+
+        partitions.push_back(CompRow_Mat_double(sub_matrix(part, ci)));
+        column_index.push_back(ci);
+        if (icntl[Controls::aug_type] != 0) stC.push_back(all_stC[k]);
+        dist_parts.erase(k);
+
+        m += partitions.back().dim(0);
+        nz += partitions.back().NumNonzeros();
+    }
+    nb_local_parts = partitions.size();
+
+    LDEBUG3 << "Process " << inter_comm.rank() << " kept " << nb_local_parts << " partitions";
+}
@@ -30,3 +30,608 @@
 // The fact that you are presently reading this means that you have had
 // knowledge of the CeCILL-C license and that you accept its terms.
 
+#include <abcd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+/// A linear congruential generator, the partitions only depend on the
+/// seed and not on the standard library
+struct PartRandom {
+    unsigned int state;
+
+    explicit PartRandom(unsigned int seed) : state(seed) {}
+
+    /// Returns a number in [0, n)
+    int operator()(int n)
+    {
+        state = 1664525u * state + 1013904223u;
+        return int((state >> 8) % (unsigned int) n);
+    }
+};
+
+/// A hypergraph of the rows, each column being a net over the rows
+/// having a nonzero in it
+struct RowHypergraph {
+    int nv;                  ///< The number of vertices
+    std::vector<int> vwgt;   ///< The weight of each vertex
+    std::vector<int> xpins;  ///< The pins of each net
+    std::vector<int> pins;
+    std::vector<int> nwgt;   ///< The cost of each net
+    std::vector<int> xnets;  ///< The nets of each vertex
+    std::vector<int> nets;
+
+    int nbNets() const { return int(nwgt.size()); }
+
+    int totalWeight() const {
+        int w = 0;
+        for(int v = 0; v < nv; v++) w += vwgt[v];
+        return w;
+    }
+
+    /// Builds the nets of each vertex from the pins of each net
+    void buildIncidence() {
+        xnets.assign(nv + 1, 0);
+        for(size_t p = 0; p < pins.size(); p++) xnets[pins[p] + 1]++;
+        for(int v = 0; v < nv; v++) xnets[v + 1] += xnets[v];
+
+        nets.resize(pins.size());
+        std::vector<int> fill(xnets.begin(), xnets.end() - 1);
+        for(int e = 0; e < nbNets(); e++) {
+            for(int p = xpins[e]; p < xpins[e + 1]; p++) nets[fill[pins[p]]++] = e;
+        }
+    }
+};
+
+/// Builds the nets of c from those of h, the vertex v of h becoming
+/// map[v] (dropped if negative), keeping the nets with two pins or more
+static void contractNets(const RowHypergraph &h, const std::vector<int> &map,
+                         RowHypergraph &c)
+{
+    std::vector<int> mark(c.nv, -1);
+    c.xpins.assign(1, 0);
+    c.pins.clear();
+    c.nwgt.clear();
+
+    for(int e = 0; e < h.nbNets(); e++) {
+        int start = c.pins.size();
+        for(int p = h.xpins[e]; p < h.xpins[e + 1]; p++) {
+            int v = map[h.pins[p]];
+            if(v < 0 || mark[v] == e) continue;
+            mark[v] = e;
+            c.pins.push_back(v);
+        }
+        if(int(c.pins.size()) - start < 2) {
+            c.pins.resize(start);
+            continue;
+        }
+        c.xpins.push_back(c.pins.size());
+        c.nwgt.push_back(h.nwgt[e]);
+    }
+    c.buildIncidence();
+}
+
+/// Merges the vertices by heavy connectivity matching, the nets larger
+/// than max_net are ignored by the matching
+static bool coarsen(const RowHypergraph &h, int max_vwgt, PartRandom &rng,
+                    RowHypergraph &c, std::vector<int> &cmap)
+{
+    const int max_net = std::max(16, int(std::sqrt(double(h.nv))));
+
+    std::vector<int> order(h.nv);
+    for(int v = 0; v < h.nv; v++) order[v] = v;
+    for(int v = h.nv - 1; v > 0; v--) std::swap(order[v], order[rng(v + 1)]);
+
+    cmap.assign(h.nv, -1);
+    std::vector<double> score(h.nv, 0);
+    std::vector<int> touched;
+    int nc = 0;
+
+    for(int o = 0; o < h.nv; o++) {
+        int u = order[o];
+        if(cmap[u] >= 0) continue;
+
+        for(int q = h.xnets[u]; q < h.xnets[u + 1]; q++) {
+            int e = h.nets[q];
+            int size = h.xpins[e + 1] - h.xpins[e];
+            if(size > max_net) continue;
+
+            double w = double(h.nwgt[e]) / (size - 1);
+            for(int p = h.xpins[e]; p < h.xpins[e + 1]; p++) {
+                int v = h.pins[p];
+                if(v == u || cmap[v] >= 0 || h.vwgt[u] + h.vwgt[v] > max_vwgt) continue;
+                if(score[v] == 0) touched.push_back(v);
+                score[v] += w;
+            }
+        }
+
+        int best = -1;
+        for(size_t t = 0; t < touched.size(); t++) {
+            int v = touched[t];
+            if(best < 0 || score[v] > score[best]) best = v;
+            score[v] = 0;
+        }
+        touched.clear();
+
+        cmap[u] = nc;
+        if(best >= 0) cmap[best] = nc;
+        nc++;
+    }
+
+    // stop when the matching does not reduce the hypergraph enough
+    if(nc > 0.95 * h.nv) return false;
+
+    c.nv = nc;
+    c.vwgt.assign(nc, 0);
+    for(int v = 0; v < h.nv; v++) c.vwgt[cmap[v]] += h.vwgt[v];
+
+    contractNets(h, cmap, c);
+    return true;
+}
+
+/// The cut of a bisection, the cost of the nets with pins on both sides
+static long cutCost(const RowHypergraph &h, const std::vector<int> &part)
+{
+    long cut = 0;
+    for(int e = 0; e < h.nbNets(); e++) {
+        int first = part[h.pins[h.xpins[e]]];
+        for(int p = h.xpins[e] + 1; p < h.xpins[e + 1]; p++) {
+            if(part[h.pins[p]] != first) {
+                cut += h.nwgt[e];
+                break;
+            }
+        }
+    }
+    return cut;
+}
+
+/// Fiduccia-Mattheyses refinement of a bisection, a side may not
+/// exceed max_w unless the move relieves an overloaded side
+static void refineFM(const RowHypergraph &h, std::vector<int> &part, const int max_w[2])
+{
+    const int max_passes = 8;
+
+    for(int pass = 0; pass < max_passes; pass++) {
+        std::vector<int> cnt(2 * h.nbNets(), 0);
+        int wgt[2] = {0, 0};
+        for(int v = 0; v < h.nv; v++) wgt[part[v]] += h.vwgt[v];
+        for(int e = 0; e < h.nbNets(); e++) {
+            for(int p = h.xpins[e]; p < h.xpins[e + 1]; p++) cnt[2 * e + part[h.pins[p]]]++;
+        }
+
+        std::vector<int> gain(h.nv, 0);
+        for(int v = 0; v < h.nv; v++) {
+            int from = part[v];
+            for(int q = h.xnets[v]; q < h.xnets[v + 1]; q++) {
+                int e = h.nets[q];
+                if(cnt[2 * e + from] == 1) gain[v] += h.nwgt[e];
+                if(cnt[2 * e + 1 - from] == 0) gain[v] -= h.nwgt[e];
+            }
+        }
+
+        // a lazy max-heap per side, the stale entries are skipped
+        typedef std::pair<int, int> entry;
+        std::priority_queue<entry> heap[2];
+        for(int v = 0; v < h.nv; v++) heap[part[v]].push(entry(gain[v], v));
+
+        std::vector<bool> locked(h.nv, false);
+        std::vector<int> moves;
+        long cur = 0, best = 0;
+        int over = std::max(0, wgt[0] - max_w[0]) + std::max(0, wgt[1] - max_w[1]);
+        int best_over = over;
+        size_t best_len = 0;
+        const int patience = std::max(50, h.nv / 50);
+
+        while(true) {
+            // the best move that keeps the balance, or relieves a side
+            int v = -1;
+            for(int side = 0; side < 2; side++) {
+                while(!heap[side].empty() &&
+                      (locked[heap[side].top().second] ||
+                       heap[side].top().first != gain[heap[side].top().second])) {
+                    heap[side].pop();
+                }
+                if(heap[side].empty()) continue;
+
+                int u = heap[side].top().second;
+                if(wgt[1 - side] + h.vwgt[u] > max_w[1 - side] && wgt[side] <= max_w[side]) continue;
+                if(v < 0 || gain[u] > gain[v]) v = u;
+            }
+            if(v < 0) break;
+            heap[part[v]].pop();
+
+            int from = part[v], to = 1 - from;
+
+            // move v and update the gains of the free pins of its nets
+            locked[v] = true;
+            for(int q = h.xnets[v]; q < h.xnets[v + 1]; q++) {
+                int e = h.nets[q];
+                int w = h.nwgt[e];
+                int &c_from = cnt[2 * e + from];
+                int &c_to = cnt[2 * e + to];
+
+                if(c_to <= 1) {
+                    for(int p = h.xpins[e]; p < h.xpins[e + 1]; p++) {
+                        int u = h.pins[p];
+                        if(locked[u]) continue;
+                        if(c_to == 0) gain[u] += w;
+                        else if(part[u] == to) gain[u] -= w;
+                        else continue;
+                        heap[part[u]].push(entry(gain[u], u));
+                    }
+                }
+                c_from--;
+                c_to++;
+                if(c_from <= 1) {
+                    for(int p = h.xpins[e]; p < h.xpins[e + 1]; p++) {
+                        int u = h.pins[p];
+                        if(locked[u]) continue;
+                        if(c_from == 0) gain[u] -= w;
+                        else if(part[u] == from) gain[u] += w;
+                        else continue;
+                        heap[part[u]].push(entry(gain[u], u));
+                    }
+                }
+            }
+
+            cur += gain[v];
+            part[v] = to;
+            wgt[from] -= h.vwgt[v];
+            wgt[to] += h.vwgt[v];
+            moves.push_back(v);
+
+            over = std::max(0, wgt[0] - max_w[0]) + std::max(0, wgt[1] - max_w[1]);
+            if(over < best_over || (over == best_over && cur > best)) {
+                best = cur;
+                best_over = over;
+                best_len = moves.size();
+            } else if(moves.size() - best_len > size_t(patience)) {
+                break;
+            }
+        }
+
+        // roll back the moves after the best prefix
+        for(size_t t = moves.size(); t > best_len; t--) {
+            part[moves[t - 1]] = 1 - part[moves[t - 1]];
+        }
+
+        if(best <= 0 && best_len == 0) break;
+    }
+}
+
+/// Bisects the coarsest hypergraph by growing the side 0 from random
+/// seeds along the nets, keeping the best refined bisection
+static void initialBisection(const RowHypergraph &h, int target0, const int max_w[2],
+                             PartRandom &rng, std::vector<int> &part)
+{
+    const int tries = 8;
+    long best_cut = -1;
+    int best_over = 0;
+    std::vector<int> trial(h.nv);
+
+    for(int t = 0; t < tries; t++) {
+        std::fill(trial.begin(), trial.end(), 1);
+        std::vector<bool> seen(h.nv, false);
+        std::queue<int> front;
+        int w0 = 0;
+
+        while(w0 < target0) {
+            if(front.empty()) {
+                // a new seed, in another connected component if needed
+                int s = rng(std::max(1, h.nv));
+                for(int k = 0; k < h.nv && seen[s]; k++) s = (s + 1) % h.nv;
+                if(seen[s]) break;
+                seen[s] = true;
+                front.push(s);
+            }
+            int v = front.front();
+            front.pop();
+            if(w0 + h.vwgt[v] > max_w[0]) continue;
+            trial[v] = 0;
+            w0 += h.vwgt[v];
+
+            for(int q = h.xnets[v]; q < h.xnets[v + 1]; q++) {
+                int e = h.nets[q];
+                for(int p = h.xpins[e]; p < h.xpins[e + 1]; p++) {
+                    int u = h.pins[p];
+                    if(seen[u]) continue;
+                    seen[u] = true;
+                    front.push(u);
+                }
+            }
+        }
+
+        refineFM(h, trial, max_w);
+
+        int wgt[2] = {0, 0};
+        for(int v = 0; v < h.nv; v++) wgt[trial[v]] += h.vwgt[v];
+        int over = std::max(0, wgt[0] - max_w[0]) + std::max(0, wgt[1] - max_w[1]);
+        long cut = cutCost(h, trial);
+
+        if(best_cut < 0 || over < best_over || (over == best_over && cut < best_cut)) {
+            best_cut = cut;
+            best_over = over;
+            part = trial;
+        }
+    }
+}
+
+/// Multilevel bisection: coarsening, initial bisection of the coarsest
+/// hypergraph and refinement of the projected bisection at each level
+static void bisect(const RowHypergraph &h, int target0, const int max_w[2],
+                   PartRandom &rng, std::vector<int> &part)
+{
+    const int coarse_nv = 100;
+    int total = h.totalWeight();
+    int max_vwgt = std::max(1, std::min(max_w[0] - target0 + 1, total / 20));
+
+    std::vector<RowHypergraph> levels;
+    std::vector<std::vector<int> > cmaps;
+    const RowHypergraph *cur = &h;
+
+    while(cur->nv > coarse_nv) {
+        RowHypergraph c;
+        std::vector<int> cmap;
+        if(!coarsen(*cur, max_vwgt, rng, c, cmap)) break;
+        levels.push_back(c);
+        cmaps.push_back(cmap);
+        cur = &levels.back();
+    }
+
+    std::vector<int> cpart;
+    initialBisection(*cur, target0, max_w, rng, cpart);
+
+    for(int l = int(levels.size()) - 1; l >= 0; l--) {
+        const RowHypergraph &fine = l == 0 ? h : levels[l - 1];
+        std::vector<int> fpart(fine.nv);
+        for(int v = 0; v < fine.nv; v++) fpart[v] = cpart[cmaps[l][v]];
+        refineFM(fine, fpart, max_w);
+        cpart.swap(fpart);
+    }
+
+    part.swap(cpart);
+}
+
+/// Splits h into k parts by recursive bisection, the vertex v of h
+/// being the row ids[v], the cut nets are split between the two sides
+static void recursiveBisection(const RowHypergraph &h, const std::vector<int> &ids,
+                               int k, int first, double eps, PartRandom &rng,
+                               std::vector<int> &partvec)
+{
+    if(k == 1 || h.nv <= 1) {
+        for(int v = 0; v < h.nv; v++) partvec[ids[v]] = first;
+        return;
+    }
+
+    int k0 = k / 2;
+    int k1 = k - k0;
+    int total = h.totalWeight();
+    int target0 = int(double(total) * k0 / k);
+    int max_w[2] = {int(target0 * (1 + eps)), int((total - target0) * (1 + eps))};
+    max_w[0] = std::max(max_w[0], target0 + 1);
+    max_w[1] = std::max(max_w[1], total - target0 + 1);
+
+    std::vector<int> part;
+    bisect(h, target0, max_w, rng, part);
+
+    // each side needs at least as many rows as partitions
+    int nb[2] = {0, 0};
+    for(int v = 0; v < h.nv; v++) nb[part[v]]++;
+    for(int v = 0; v < h.nv && nb[0] < k0; v++) {
+        if(part[v] == 1) { part[v] = 0; nb[0]++; nb[1]--; }
+    }
+    for(int v = 0; v < h.nv && nb[1] < k1; v++) {
+        if(part[v] == 0) { part[v] = 1; nb[1]++; nb[0]--; }
+    }
+
+    for(int s = 0; s < 2; s++) {
+        RowHypergraph sub;
+        std::vector<int> map(h.nv, -1), sub_ids;
+        for(int v = 0; v < h.nv; v++) {
+            if(part[v] != s) continue;
+            map[v] = sub_ids.size();
+            sub_ids.push_back(ids[v]);
+            sub.vwgt.push_back(h.vwgt[v]);
+        }
+        sub.nv = sub_ids.size();
+
+        contractNets(h, map, sub);
+
+        recursiveBisection(sub, sub_ids, s == 0 ? k0 : k1, s == 0 ? first : first + k0,
+                           eps, rng, partvec);
+    }
+}
+
+/// Partitions the rows with the in-tree multilevel hypergraph partitioner
+///
+/// The rows are the vertices and the columns the nets, as with PaToH, so
+/// that the cut nets are the columns shared by several partitions. The k
+/// partitions come from recursive multilevel bisections, each of them
+/// coarsened by heavy connectivity matching, bisected by growing a part
+/// from random seeds and refined with Fiduccia-Mattheyses at each level.
+/// The imbalance dcntl[Controls::part_imbalance] is spread over the
+/// levels of the recursion.
+/// \param partvec The partition of each row
+void abcd::multilevelPartition(std::vector<int> &partvec)
+{
+    int k = icntl[Controls::nbparts];
+
+    std::vector<int> col_ptr, row_ind;
+    abcd::columnPattern(col_ptr, row_ind);
+
+    RowHypergraph h;
+    h.nv = m_o;
+    h.vwgt.assign(m_o, 1);
+    h.xpins.assign(1, 0);
+    for(int j = 0; j < n_o; j++) {
+        int size = col_ptr[j + 1] - col_ptr[j];
+        if(size < 2) continue;
+        h.pins.insert(h.pins.end(), row_ind.begin() + col_ptr[j], row_ind.begin() + col_ptr[j + 1]);
+        h.xpins.push_back(h.pins.size());
+        h.nwgt.push_back(1);
+    }
+    h.buildIncidence();
+
+    int levels = 1;
+    while((1 << levels) < k) levels++;
+    double eps = std::pow(1 + std::max(0.0, dcntl[Controls::part_imbalance]), 1.0 / levels) - 1;
+
+    std::vector<int> ids(m_o);
+    for(int i = 0; i < m_o; i++) ids[i] = i;
+
+    PartRandom rng(1);
+    partvec.assign(m_o, 0);
+    recursiveBisection(h, ids, k, 0, eps, rng, partvec);
+
+    // the connectivity - 1 of the columns
+    long cut = 0;
+    std::vector<int> mark(k, -1);
+    for(int e = 0; e < h.nbNets(); e++) {
+        for(int p = h.xpins[e]; p < h.xpins[e + 1]; p++) {
+            int q = partvec[h.pins[p]];
+            if(mark[q] == e) continue;
+            mark[q] = e;
+            cut++;
+        }
+        cut--;
+    }
+    LINFO << "Multilevel partitioner cut (connectivity - 1): " << cut;
+}
+
+/// The coupling between the partitions, each pair of rows of the graph
+/// xadj, adj being seen from both rows
+static double interCoupling(const std::vector<int> &xadj, const std::vector<int> &adj,
+                            const std::vector<double> &cpl, const std::vector<int> &part)
+{
+    double c = 0;
+    for(size_t i = 0; i + 1 < xadj.size(); i++) {
+        for(int e = xadj[i]; e < xadj[i + 1]; e++) {
+            if(part[adj[e]] != part[i]) c += cpl[e];
+        }
+    }
+    return c / 2;
+}
+
+/// Moves the rows between the partitions of abcd::strow and
+/// abcd::nbrows to reduce the numerical coupling between them
+///
+/// The coupling of two rows is their squared cosine (a_i^T a_k)^2 /
+/// (|a_i|^2 |a_k|^2), the coupling between the partitions sums it over
+/// the pairs of rows in different partitions. The rows go to the
+/// partition they are the most coupled with, pass after pass until no
+/// row moves or for at most max_passes passes, while the partition
+/// sizes stay below (1 + dcntl[Controls::part_imbalance]) times the
+/// average. Each move lowers the coupling so the passes end, max_passes
+/// only bounds their cost. The columns with more than max_col entries couple
+/// all the rows weakly and are ignored, as in the matching of the
+/// multilevel partitioner.
+void abcd::refinePartitionCoupling()
+{
+    int k = icntl[Controls::nbparts];
+    const int max_col = std::max(100, int(10 * std::sqrt(double(m_o))));
+    const int max_passes = 10;
+
+    int *ir = A.rowptr_ptr();
+    int *jc = A.colind_ptr();
+    double *val = A.val_ptr();
+
+    CompCol_Mat_double t_A = Coord_Mat_double(A);
+
+    std::vector<double> nrm(m_o, 0);
+    for(int i = 0; i < m_o; i++) {
+        for(int p = ir[i]; p < ir[i + 1]; p++) nrm[i] += val[p] * val[p];
+    }
+
+    // the coupling graph of the rows, A A^T normalized
+    std::vector<int> xadj(1, 0), adj;
+    std::vector<double> cpl;
+    {
+        std::vector<double> acc(m_o, 0);
+        std::vector<int> touched;
+        for(int i = 0; i < m_o; i++) {
+            for(int p = ir[i]; p < ir[i + 1]; p++) {
+                int j = jc[p];
+                if(t_A.col_ptr(j + 1) - t_A.col_ptr(j) > max_col) continue;
+                for(int q = t_A.col_ptr(j); q < t_A.col_ptr(j + 1); q++) {
+                    int r = t_A.row_ind(q);
+                    if(r == i) continue;
+                    if(acc[r] == 0) touched.push_back(r);
+                    acc[r] += val[p] * t_A.val(q);
+                }
+            }
+            for(size_t t = 0; t < touched.size(); t++) {
+                int r = touched[t];
+                if(acc[r] != 0 && nrm[i] > 0 && nrm[r] > 0) {
+                    adj.push_back(r);
+                    cpl.push_back(acc[r] * acc[r] / (nrm[i] * nrm[r]));
+                }
+                acc[r] = 0;
+            }
+            touched.clear();
+            xadj.push_back(adj.size());
+        }
+    }
+
+    std::vector<int> part(m_o);
+    for(int b = 0; b < k; b++) {
+        for(int i = strow[b]; i < strow[b] + nbrows[b]; i++) part[i] = b;
+    }
+
+    // each pair is seen from both rows
+    double total = 0;
+    for(size_t e = 0; e < cpl.size(); e++) total += cpl[e];
+    total /= 2;
+
+    double before = interCoupling(xadj, adj, cpl, part);
+
+    std::vector<int> size(nbrows.begin(), nbrows.end());
+    int max_size = int(std::ceil((1 + std::max(0.0, dcntl[Controls::part_imbalance])) * m_o / k));
+    max_size = std::max(max_size, *std::max_element(size.begin(), size.end()));
+
+    std::vector<double> conn(k, 0);
+    std::vector<int> touched;
+    int pass = 0, moved = 0;
+    for(; pass < max_passes; pass++) {
+        int moves = 0;
+        for(int i = 0; i < m_o; i++) {
+            int cur = part[i];
+            for(int e = xadj[i]; e < xadj[i + 1]; e++) {
+                int b = part[adj[e]];
+                if(conn[b] == 0) touched.push_back(b);
+                conn[b] += cpl[e];
+            }
+
+            int best = cur;
+            for(size_t t = 0; t < touched.size(); t++) {
+                int b = touched[t];
+                if(b != cur && size[b] < max_size && conn[b] > conn[best] * (1 + 1e-10)) best = b;
+            }
+            for(size_t t = 0; t < touched.size(); t++) conn[touched[t]] = 0;
+            touched.clear();
+
+            // keep at least one row per partition
+            if(best == cur || size[cur] == 1) continue;
+
+            part[i] = best;
+            size[cur]--;
+            size[best]++;
+            moves++;
+        }
+        moved += moves;
+        if(moves == 0) break;
+    }
+
+    if(moved != 0 && pass == max_passes)
+        LINFO << "Stopped the coupling refinement after " << max_passes << " passes";
+
+    double after = interCoupling(xadj, adj, cpl, part);
+
+    dinfo[Controls::coupling_before] = before;
+    dinfo[Controls::coupling_after] = after;
+    LINFO << "Coupling between the partitions: " << scientific << before << " before, "
+          << after << " after (" << moved << " rows moved in " << pass << " passes), out of "
+          << total;
+
+    abcd::applyRowPartition(&part[0]);
+}
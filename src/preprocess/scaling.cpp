@@ -60,7 +60,8 @@ void abcd::scaling()
     if(icntl[Controls::scaling] > 0) {
         LINFO << "Scaling the matrix";
 
-        abcd::scaleMatrix(0);
+        if (dist_prep) abcd::distributedScaling();
+        else abcd::scaleMatrix(0);
 
         diagScaleMatrix(drow_, dcol_);
     }
@@ -135,7 +136,7 @@ void abcd::scaleMatrix(int norm)
     // compute drow and dcol
     job = 2;
     dmumps_simscaleabs_(
-        a_rp, a_cp, a_vp, &nz, &m, &n, &numprocs, &myid, &co,
+        &rp[0], a_cp, a_vp, &nz, &m, &n, &numprocs, &myid, &co,
         rpartvec, cpartvec, rsndrcvsz, csndrcvsz, reg,
         &iwk[0], &liwk,
         &intsz, &resz, &job,
@@ -201,9 +202,12 @@ abcd::diagScaleRhs ( VECTOR_double &b)
     void
 abcd::diagScaleRhs ( MV_ColMat_double &B)
 {
+    // the rows of B are permuted, drow_ follows the original rows
+    bool permuted = row_perm.size() != 0;
+
     #pragma omp parallel for
     for ( int i = 0; i < B.dim(0); i++ ) 
         for ( int j = 0; j < B.dim(1); j++ ) 
-            B(i,j) = B(i,j)*drow_[i];
+            B(i,j) = B(i,j)*drow_[permuted ? row_perm[i] : i];
 
 }		/* -----  end of function abcd::scalRhs  ----- */
@@ -0,0 +1,191 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#include <abcd.h>
+#include "blas.h"
+
+/// The number of columns the recycling may hold, the basis included
+int abcd::recycleBudget()
+{
+    if(dcntl[Controls::recycle_mem] <= 0) return 3 * icntl[Controls::recycle];
+
+    // the same budget everywhere, bounded by the largest master
+    int n_max;
+    mpi::all_reduce(inter_comm, n, n_max, mpi::maximum<int>());
+
+    // each column is stored along with its product by H
+    return int(dcntl[Controls::recycle_mem] * 1024 * 1024 / (2.0 * sizeof(double) * n_max));
+}
+
+/// Projects the starting residual r on the recycled basis W, as
+/// W^T H W = I the correction of Xk is W W^T r and r becomes
+/// orthogonal to W
+void abcd::deflateStart(MV_ColMat_double &r)
+{
+    MV_ColMat_double wr(rec_W.dim(1), r.dim(1), 0);
+    globalDot(rec_W, r, wr.ptr(), false);
+
+    MV_ColMat_double dx = gemmColMat(rec_W, wr);
+    Xk(MV_VecIndex(0, Xk.dim(0) - 1), MV_VecIndex(0, nrhs - 1)) +=
+        dx(MV_VecIndex(0, dx.dim(0) - 1), MV_VecIndex(0, nrhs - 1));
+
+    r = r - gemmColMat(rec_HW, wr);
+}
+
+/// Makes the search directions p H-orthogonal to the recycled basis
+/// W, r being the current (orthonormalized) residual
+void abcd::deflateDirection(MV_ColMat_double &r, MV_ColMat_double &p)
+{
+    MV_ColMat_double mu(rec_HW.dim(1), r.dim(1), 0);
+    globalDot(rec_HW, r, mu.ptr(), false);
+
+    p = p - gemmColMat(rec_W, mu);
+}
+
+/// Extracts the new recycled basis from the previous one and the
+/// directions P (with HP = H P) gathered during a solve
+///
+/// The basis keeps the Ritz vectors of H associated with its smallest
+/// Ritz values on the span of [W P], normalized so that W^T H W = I.
+void abcd::updateRecycleBasis(std::vector<MV_ColMat_double> &P,
+                              std::vector<MV_ColMat_double> &HP)
+{
+    int k = std::min(icntl[Controls::recycle], recycleBudget() / 2);
+
+    int nb = rec_size;
+    for(size_t b = 0; b < P.size(); b++) nb += P[b].dim(1);
+
+    if(k <= 0 || nb == 0) {
+        rec_W.newsize(0, 0);
+        rec_HW.newsize(0, 0);
+        rec_size = 0;
+        return;
+    }
+
+    MV_ColMat_double V(n, nb, 0);
+    MV_ColMat_double HV(n, nb, 0);
+
+    int c = 0;
+    if(rec_size > 0) {
+        V.setCols(rec_W, 0, rec_size);
+        HV.setCols(rec_HW, 0, rec_size);
+        c = rec_size;
+    }
+    for(size_t b = 0; b < P.size(); b++) {
+        V.setCols(P[b], c, P[b].dim(1));
+        HV.setCols(HP[b], c, HP[b].dim(1));
+        c += P[b].dim(1);
+    }
+
+    // Rayleigh-Ritz, H V y = theta V y <=> (V^T V) y = 1/theta (V^T H V) y
+    MV_ColMat_double G(nb, nb, 0);
+    MV_ColMat_double M(nb, nb, 0);
+    globalDot(V, HV, G.ptr(), false);
+    globalDot(V, V, M.ptr(), false);
+
+    for(int i = 0; i < nb; i++) {
+        for(int j = 0; j < i; j++) {
+            double g = (G(i, j) + G(j, i)) / 2;
+            G(i, j) = g;
+            G(j, i) = g;
+        }
+    }
+
+    char low = 'L';
+    char left = 'L';
+    char right = 'R';
+    char tr = 'T';
+    char notr = 'N';
+    char vec = 'V';
+    double alpha = 1;
+    int ierr = 0;
+
+    double *g_ptr = G.ptr();
+    double *m_ptr = M.ptr();
+
+    // G = L L^T, the directions are H-orthonormal up to the rounding
+    dpotrf_(&low, &nb, g_ptr, &nb, &ierr);
+    if(ierr != 0) {
+        if(inter_comm.rank() == 0)
+            LWARNING << "Recycling: the gathered directions are not H-independent, keeping the basis";
+        return;
+    }
+
+    // M = L^-1 M L^-T
+    dtrsm_(&left, &low, &notr, &notr, &nb, &nb, &alpha, g_ptr, &nb, m_ptr, &nb);
+    dtrsm_(&right, &low, &tr, &notr, &nb, &nb, &alpha, g_ptr, &nb, m_ptr, &nb);
+
+    std::vector<double> ev(nb);
+    int lwork = -1;
+    double wsize;
+    dsyev_(&vec, &low, &nb, m_ptr, &nb, &ev[0], &wsize, &lwork, &ierr);
+    lwork = int(wsize);
+    std::vector<double> work(lwork);
+    dsyev_(&vec, &low, &nb, m_ptr, &nb, &ev[0], &work[0], &lwork, &ierr);
+
+    if(ierr != 0) {
+        if(inter_comm.rank() == 0)
+            LWARNING << "Recycling: the eigensolver failed with " << ierr << ", keeping the basis";
+        return;
+    }
+
+    // the eigenvalues are increasing, keep the largest that are not
+    // negligible, they are the inverses of the smallest Ritz values
+    k = std::min(k, nb);
+    while(k > 0 && ev[nb - k] <= ev[nb - 1] * 1e-12) k--;
+    if(k == 0) {
+        rec_W.newsize(0, 0);
+        rec_HW.newsize(0, 0);
+        rec_size = 0;
+        return;
+    }
+
+    MV_ColMat_double Y(nb, k, 0);
+    for(int j = 0; j < k; j++) {
+        for(int i = 0; i < nb; i++) {
+            Y(i, j) = M(i, nb - 1 - j);
+        }
+    }
+
+    // y = L^-T z
+    double *y_ptr = Y.ptr();
+    dtrsm_(&left, &low, &tr, &notr, &nb, &k, &alpha, g_ptr, &nb, y_ptr, &nb);
+
+    rec_W = gemmColMat(V, Y);
+    rec_HW = gemmColMat(HV, Y);
+    rec_size = k;
+
+    if(inter_comm.rank() == 0) {
+        LDEBUG << "Recycling: smallest Ritz value " << scientific << 1 / ev[nb - 1]
+               << ", basis of " << rec_size << " vectors out of " << nb;
+    }
+}
@@ -53,311 +53,285 @@
 #include <iostream>
 #include <fstream>
 
-#ifdef WIP
+/// Computes S V = Y (I - H) Y^T V with a sum of projections
+///
+/// V and the result are replicated on the masters, each entry of the
+/// result comes from the master owning the column.
     MV_ColMat_double
 abcd::prodSv ( MV_ColMat_double &V )
 {
-    MV_ColMat_double W(n, V.dim(1), 0);
+    int s = V.dim(1);
+    MV_ColMat_double W(n, s, 0);
     MV_ColMat_double b; // just for decoration!
-    MV_ColMat_double R(V.dim(0), V.dim(1), 0);
+    MV_ColMat_double R(size_c, s, 0);
+    MV_ColMat_double SV(size_c, s, 0);
 
-    for(std::vector<int>::iterator iti = st_c_part_it; iti != glob_to_local_ind.end(); ++iti){
-            for(int j = 0; j < V.dim(1); j++)
-                W(iti - glob_to_local_ind.begin() , j) = V(*iti - n_o, j);
-    }
+    for(size_t i = 0; i < c_idx.size(); i++)
+        for(int j = 0; j < s; j++)
+            W(c_loc[i], j) = V(c_idx[i], j);
 
     W = W - sumProject(0e0, b, 1e0, W);
 
-    for(std::vector<int>::iterator iti = st_c_part_it; iti != glob_to_local_ind.end(); ++iti){
-            for(int j = 0; j < V.dim(1); j++)
-                R(*iti - n_o, j) = W(iti - glob_to_local_ind.begin() , j);
+    for(int i = 0; i < c_nb_owned; i++)
+        for(int j = 0; j < s; j++)
+            R(c_idx[i], j) = W(c_loc[i], j);
 
-    }
+    mpi::all_reduce(inter_comm, R.ptr(), size_c * s, SV.ptr(), std::plus<double>());
 
-    return R;
+    return SV;
 }       /* -----  end of function abcd::prodSv  ----- */
 
 
-MUMPS abcd::buildM (  )
+/// Builds and factorizes the preconditioner of the iterative solve of Sz = f
+///
+/// The columns of S in selected_S_columns are built with abcd::buildS,
+/// the skipped ones are replaced by the identity. The factorization is kept
+/// in mumps_M and reused by the following solves.
+void abcd::buildM (  )
 {
+    mpi::broadcast(inter_comm, selected_S_columns, 0);
+    mpi::broadcast(inter_comm, skipped_S_columns, 0);
+
     if(inter_comm.rank() == 0){
-        clog << "* Building the preconditioner      *" << endl;
-        clog << " Size is : " << selected_S_columns.size() << endl;
-
-        //ofstream f;
-        //f.open("/tmp/selected");
-        //for(int i = 0; i < selected_S_columns.size(); i++){
-            //f << selected_S_columns[i] << endl;
-        //}
-        //f.close();
+        LINFO << "*----------------------------------*";
+        LINFO << "> Building the preconditioner of S  ";
+        LINFO << "> " << selected_S_columns.size() << " columns out of " << size_c;
     }
 
-
     double t = MPI_Wtime();
-    //t = MPI_Wtime();
-    //S = buildS(skipped_S_columns);
-    //clog << " Time to build S : " << MPI_Wtime() - t << endl;
-
-    Coord_Mat_double M = buildS(selected_S_columns);
-    //clog << " Time to build M : " << MPI_Wtime() - t << endl;
-
-    //if(IRANK == 0) clog << "* -----------  DONE  ------------- * " << endl;
-
-    std::vector<int> dropped;
 
-    {
-        std::vector<int> mr, mc;
-        std::vector<double> mv;
-
-        std::vector<int>::iterator it;
-
-        for(size_t i = 0; i < skipped_S_columns.size(); i++){
-            std::map<int,int>::iterator iti = glob_to_local.find(n_o + skipped_S_columns[i]);
-            if(iti == glob_to_local.end()) continue;
-
-            int ro = skipped_S_columns[i];
+    std::vector<int> mr, mc;
+    std::vector<double> mv;
+    if(selected_S_columns.size() != 0)
+        buildS(mr, mc, mv, selected_S_columns);
+
+    std::vector<int> skipped(size_c, 0);
+    for(size_t i = 0; i < skipped_S_columns.size(); i++)
+        skipped[skipped_S_columns[i]] = 1;
+
+    // drop the rows of the skipped columns, the entries are 1-based
+    size_t k = 0;
+    for(size_t i = 0; i < mv.size(); i++){
+        if(mr[i] < 1 || skipped[mr[i] - 1] || mv[i] == 0) continue;
+        mr[k] = mr[i];
+        mc[k] = mc[i];
+        mv[k] = mv[i];
+        k++;
+    }
+    mr.resize(k);
+    mc.resize(k);
+    mv.resize(k);
+
+    // the identity for the skipped columns we own
+    for(int i = 0; i < c_nb_owned; i++){
+        if(!skipped[c_idx[i]]) continue;
+        mr.push_back(c_idx[i] + 1);
+        mc.push_back(c_idx[i] + 1);
+        mv.push_back(1);
+    }
 
-            mr.push_back(ro);
-            mc.push_back(ro);
-            //mv.push_back(S(ro,ro));
+    if(inter_comm.rank() == 0){
+        LINFO << "> T.build M : " << setprecision(2) << MPI_Wtime() - t;
+    }
 
-            mv.push_back(1);
-        }
+    t = MPI_Wtime();
+    factorizeOnMasters(mumps_M, size_c, mr, mc, mv, "the preconditioner of S");
 
-        for(int i = 0; i < M.NumNonzeros(); i++){
-            if(std::find(skipped_S_columns.begin(), skipped_S_columns.end(), M.row_ind(i))
-                    !=skipped_S_columns.end()) continue;
-            if(M.val(i) == 0) continue;
-            mr.push_back(M.row_ind(i));
-            mc.push_back(M.col_ind(i));
-            mv.push_back(M.val(i));
-        }
-        
-        M = Coord_Mat_double(size_c, size_c, mv.size(), &mv[0], &mr[0], &mc[0]);
+    if(inter_comm.rank() == 0){
+        LINFO << "> T.Analyse and Factorize M : " << setprecision(2) << MPI_Wtime() - t;
+        LINFO << "*----------------------------------*";
     }
+}       /* -----  end of function abcd::buildM  ----- */
 
-    /*-----------------------------------------------------------------------------
-     *  MUMPS part
-     *-----------------------------------------------------------------------------*/
-    
-    MUMPS mu;
-    mu.sym = 1;
-    mu.par = 1;
-    mu.job = -1;
-    mu.comm_fortran = MPI_Comm_c2f((MPI_Comm) inter_comm);
-
-    dmumps_c(&mu);
-
-    mu.icntl[0] = -1;
-    mu.icntl[1] = -1;
-    mu.icntl[2] = -1;
-
-    if(inter_comm.rank() == 0){ 
-        //strcpy(mu.write_problem, "/tmp/mmm.mtx");
-        //mu.icntl[0] = 6;
-        //mu.icntl[1] = 6;
-        //mu.icntl[2] = 6;
-        //mu.icntl[3] = 2;
-    }
 
-    mu.n = M.dim(0);
-
-    // parallel analysis if the S is large enough
-    //if(mu.n >= 200) {
-        //mu.icntl[28 - 1] =  2;
-    //}
-    mu.icntl[8  - 1] =  7;
-    mu.icntl[7  - 1] =  5;
-    mu.icntl[14 - 1] =  90;
-
-    if(inter_comm.size() == 1){ 
-        mu.nz= M.NumNonzeros();
-        mu.irn= M.rowind_ptr();
-        mu.jcn= M.colind_ptr();
-        mu.a= M.val_ptr();
-        for(int i = 0; i < mu.nz; i++){
-            mu.irn[i]++;
-            mu.jcn[i]++;
-        }
-    } else {
-        mu.icntl[18 - 1]= 3;
-        mu.nz_loc = M.NumNonzeros();
-
-        mu.irn_loc = M.rowind_ptr();
-        mu.jcn_loc = M.colind_ptr();
-        mu.a_loc = M.val_ptr();
-        for(int i = 0; i < mu.nz_loc; i++){
-            mu.irn_loc[i]++;
-            mu.jcn_loc[i]++;
-        }
+/// Analyses and factorizes with MUMPS the symmetric matrix spread over
+/// the masters as 1-based coordinates
+///
+/// The entries are summed across inter_comm, the arrays must outlive the
+/// factorization and may get a zero entry as MUMPS rejects empty local arrays.
+/// \param mumps The instance, initialized on inter_comm
+/// \param order The order of the matrix
+/// \param what The matrix named in the error message
+void abcd::factorizeOnMasters(MUMPS &mumps, int order, std::vector<int> &irn,
+                              std::vector<int> &jcn, std::vector<double> &val,
+                              const char *what)
+{
+    if(val.size() == 0) {
+        irn.push_back(1);
+        jcn.push_back(1);
+        val.push_back(0);
     }
-    t = MPI_Wtime();
 
-    IBARRIER;
-    if(inter_comm.rank() == 0)
-        clog << "* Starting Analysis of the precond *" << endl;
+    mumps.sym = 2;
+    mumps.par = 1;
+    mumps.comm_fortran = MPI_Comm_c2f((MPI_Comm) inter_comm);
 
-    mu.job = 1;
-    dmumps_c(&mu);
+    mumps(-1);
+    mumps.initialized = true;
 
-    if(inter_comm.rank() == 0){
-        clog << "*                                  *" << endl;
-        clog << "  [--] T.Analyse M :   " << MPI_Wtime() - t << endl;
-        clog << "*                                  *" << endl;
-    }
+    mumps.icntl[0] = -1;
+    mumps.icntl[1] = -1;
+    mumps.icntl[2] = -1;
 
-    t = MPI_Wtime();
+    mumps.n = order;
 
-    mu.job = 2;
-    dmumps_c(&mu);
+    mumps.setIcntl(8, 77);
+    mumps.setIcntl(7, 5);
+    mumps.setIcntl(14, 90);
 
-    if(inter_comm.rank() == 0){
-        clog << "*                                  *" << endl;
-        clog << "  [--] T.Factorize M : " << MPI_Wtime() - t << endl;
-        clog << "  N, NZ              : " << mu.n << ", " << mu.nz << endl;
-        clog << "*                                  *" << endl;
+    if(inter_comm.size() == 1){
+        mumps.nz = val.size();
+        mumps.irn = &irn[0];
+        mumps.jcn = &jcn[0];
+        mumps.a = &val[0];
+    } else {
+        mumps.setIcntl(18, 3);
+        mumps.nz_loc = val.size();
+        mumps.irn_loc = &irn[0];
+        mumps.jcn_loc = &jcn[0];
+        mumps.a_loc = &val[0];
     }
 
-    mu.icntl[0] = -1;
-    mu.icntl[1] = -1;
-    mu.icntl[2] = -1;
+    // analysis and factorization
+    mumps(4);
 
-    if(mu.info[0] < 0) {
-        clog << IRANK << " 1 : " << mu.info[0] <<  " 2 : " << mu.info[1] << endl;
-        exit(0); 
+    if(mumps.info[0] < 0) {
+        LERROR << "MUMPS exited with " << mumps.info[0] << " on " << what;
+        int job = -90 + mumps.info[0];
+        mpi::broadcast(intra_comm, job, 0);
+        throw std::runtime_error("MUMPS exited with an error");
     }
-    /*-----------------------------------------------------------------------------
-     *  END MUMPS part
-     *-----------------------------------------------------------------------------*/
-    return mu;
-}       /* -----  end of function abcd::buildM  ----- */
-
+}       /* -----  end of function abcd::factorizeOnMasters  ----- */
 
 
-    VECTOR_double
-abcd::solveM (MUMPS &mu, VECTOR_double &z )
+/// Solves M X = Z for all the columns of Z, the result is replicated
+    MV_ColMat_double
+abcd::solveM ( MV_ColMat_double &Z )
 {
-    if(IRANK == 0) {
-        mu.rhs = new double[z.size()];
-        for(int i = 0; i < z.size(); i++) mu.rhs[i] = z(i);
-        mu.nrhs = 1;
-    }
+    int s = Z.dim(1);
+    MV_ColMat_double X(Z);
 
-    mu.job = 3;
-    dmumps_c(&mu);
-    if(IRANK == 0){
-        VECTOR_double sol(mu.rhs, z.size());
-        double *sol_ptr = sol.ptr();
-        mpi::broadcast(inter_comm, sol_ptr, size_c, 0);
-        delete[] mu.rhs;
-        return sol;
-    } else {
-        VECTOR_double sol(z.size(), 0);
-        double *sol_ptr = sol.ptr();
-        mpi::broadcast(inter_comm, sol_ptr, size_c, 0);
-        return sol;
+    if(inter_comm.rank() == 0) {
+        mumps_M.rhs = X.ptr();
+        mumps_M.nrhs = s;
+        mumps_M.lrhs = size_c;
     }
 
+    mumps_M(3);
+
+    mpi::broadcast(inter_comm, X.ptr(), size_c * s, 0);
+
+    return X;
 }       /* -----  end of function abcd::solveM  ----- */
 
 
-    VECTOR_double
-abcd::pcgS ( VECTOR_double &b )
+/// Solves S Z = F with a preconditioned CG on all the columns of F
+///
+/// Each column has its own recurrence but the products with S and the
+/// preconditioner solves are done on the whole block. F and the result
+/// are replicated on the masters.
+    MV_ColMat_double
+abcd::pcgS ( MV_ColMat_double &F )
 {
-    double resid, tol = 1e-5;
+    int s = F.dim(1);
+    double tol = dcntl[Controls::aug_tol];
+    int max_iter = icntl[Controls::aug_itmax] > 0 ? icntl[Controls::aug_itmax] : size_c;
+    bool precond = dcntl[Controls::aug_precond] != 0;
 
-    //int max_iter = 2;
-    int max_iter = size_c;
+    if(precond && !mumps_M.initialized) buildM();
 
-    MUMPS mu;
-    if(dcntl[Controls::aug_precond] != 0) mu = buildM();
     double t = MPI_Wtime();
 
-    VECTOR_double p, z, q;
-    VECTOR_double alpha(1), beta(1), rho(1), rho_1(1);
-
-    MV_ColMat_double zk(size_c, 1, 0);
-    VECTOR_double x = zk.data();
+    MV_ColMat_double X(size_c, s, 0);
+    MV_ColMat_double R(F);
+    MV_ColMat_double P(size_c, s, 0);
+    MV_ColMat_double Z, Q;
+
+    double *r_ptr = R.ptr();
+    double *p_ptr = P.ptr();
+    double *x_ptr = X.ptr();
+
+    std::vector<double> normb(s, 1), resid(s, 0), rho(s, 0), rho_1(s, 0);
+    std::vector<bool> done(s, false);
+
+    // x0 = 0, a zero right-hand side is already solved
+    int it = 0;
+    double max_resid = 0;
+    for(int j = 0; j < s; j++){
+        double nb = 0;
+        for(int i = 0; i < size_c; i++) nb += r_ptr[i + j * size_c] * r_ptr[i + j * size_c];
+        nb = sqrt(nb);
+
+        normb[j] = nb != 0 ? nb : 1;
+        resid[j] = nb / normb[j];
+        done[j] = resid[j] <= tol;
+        max_resid = std::max(max_resid, resid[j]);
+    }
 
-    double normb = norm(b);
-    MV_ColMat_double Szk = prodSv(zk);
-    VECTOR_double r = b - Szk(0);
+    while(max_resid > tol && it < max_iter) {
+        it++;
 
-    if (normb == 0.0) 
-        normb = 1;
+        if(precond) Z = solveM(R);
+        else Z = R;
+        double *z_ptr = Z.ptr();
 
-    resid = norm(r) / normb;
+        for(int j = 0; j < s; j++){
+            if(done[j]) continue;
 
-    if (resid <= tol) {
-        tol = resid;
-        max_iter = 0;
-        return 0;
-    }
+            rho[j] = 0;
+            for(int i = 0; i < size_c; i++) rho[j] += r_ptr[i + j * size_c] * z_ptr[i + j * size_c];
 
-    for (int i = 1; i <= max_iter; i++) {
-        TIC;
-        if(dcntl[Controls::aug_precond] != 0) { 
-            z = solveM(mu, r);
-        } else {
-            z = r;
-        }
-        //IFMASTER clog << " Time in solveM " << TOC << endl;
-
-        TIC;
-        rho(0) = dot(r, z);
-        
-        if (i == 1)
-            p = z;
-        else {
-            beta(0) = rho(0) / rho_1(0);
-            p = z + beta(0) * p;
+            double beta = it == 1 || rho_1[j] == 0 ? 0 : rho[j] / rho_1[j];
+            for(int i = 0; i < size_c; i++)
+                p_ptr[i + j * size_c] = z_ptr[i + j * size_c] + beta * p_ptr[i + j * size_c];
         }
-        
-        MV_ColMat_double pv(p.ptr(), size_c, 1);
-        //IFMASTER clog<< "Time in dot " << TOC << endl;
-        TIC;
-        Szk = prodSv(pv);
-        //IFMASTER clog<< "Time in prodsv " << TOC << endl;
-        TIC;
 
-        double *f_ptr = Szk.ptr();
-        MV_ColMat_double ff(size_c, 1, 0);
-        double *f_o = ff.ptr();
+        Q = prodSv(P);
+        double *q_ptr = Q.ptr();
 
-        mpi::all_reduce(inter_comm, f_ptr, size_c, f_o, or_bin);
+        max_resid = 0;
+        for(int j = 0; j < s; j++){
+            if(done[j]) continue;
 
-        q = ff(0);
+            double pq = 0;
+            for(int i = 0; i < size_c; i++) pq += p_ptr[i + j * size_c] * q_ptr[i + j * size_c];
+            double alpha = pq != 0 ? rho[j] / pq : 0;
 
-        alpha(0) = rho(0) / dot(p, q);
-
-        x += alpha(0) * p;
-        r -= alpha(0) * q;
+            double nr = 0;
+            for(int i = 0; i < size_c; i++){
+                x_ptr[i + j * size_c] += alpha * p_ptr[i + j * size_c];
+                r_ptr[i + j * size_c] -= alpha * q_ptr[i + j * size_c];
+                nr += r_ptr[i + j * size_c] * r_ptr[i + j * size_c];
+            }
 
-        resid = norm(r) / normb;
+            resid[j] = sqrt(nr) / normb[j];
+            rho_1[j] = rho[j];
+            done[j] = resid[j] <= tol || alpha == 0;
+            max_resid = std::max(max_resid, done[j] ? 0 : resid[j]);
+        }
 
-        if (resid <= tol) {
-            tol = resid;
-            max_iter = i;
-            if(IRANK == 0){
-                clog << "Iteration to solve Sz = f " << i << " with a residual of " << resid << endl;
-                clog << "Time in iterations : " << MPI_Wtime() - t << endl;
-            }
-            return x;     
+        if(inter_comm.rank() == 0 && icntl[Controls::verbose_level] >= 2) {
+            LOG_EVERY_N(10, INFO) << "Iteration " << it << " residual " << scientific << max_resid;
         }
-        if(IRANK == 0)
-            clog << "Iteration  " << i << " residual " << resid << "\r" << flush;
+    }
 
-        //IFMASTER clog<< "Time in otherstuffs " << TOC << endl;
-        rho_1(0) = rho(0);
+    max_resid = *std::max_element(resid.begin(), resid.end());
+    if(inter_comm.rank() == 0){
+        LINFO << "> Iterations to solve Sz = f : " << it << " with a residual of " << scientific << max_resid;
+        LINFO << "> Time in iterations : " << setprecision(2) << MPI_Wtime() - t;
     }
-    
-    tol = resid;
-    if(IRANK == 0){
-        clog << "Iteration to solve Sz = f " << max_iter << " with a residual of " << resid << endl;
-        clog << "Time in iterations : " << MPI_Wtime() - t << endl;
+
+    info[Controls::aug_nb_iter] = it;
+    dinfo[Controls::aug_residual] = max_resid;
+
+    // not fatal, z is still used but the augmented solution is less accurate
+    if(max_resid > tol) {
+        info[Controls::status] = 1;
+        if(inter_comm.rank() == 0)
+            LWARNING << "Sz = f stopped at aug_itmax = " << max_iter
+                     << " with a residual of " << scientific << max_resid
+                     << " > aug_tol = " << tol;
     }
 
-    return x;
+    return X;
 }       /* -----  end of function abcd::pcgS  ----- */
-
-#endif //WIP
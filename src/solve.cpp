@@ -63,7 +63,9 @@ void abcd::solveABCD ( MV_ColMat_double &b )
     if(dcntl[Controls::aug_filter] == 0){
 #endif //WIP
 
-        w = sumProject(1e0, b, 0e0, Xk);
+        // keep a copy of the nrhs columns, sumProject returns its workspace
+        MV_ColMat_double sp = sumProject(1e0, b, 0e0, Xk);
+        w = sp(MV_VecIndex(0, n - 1), MV_VecIndex(0, nrhs - 1));
 
 #ifdef WIP
     } else {
@@ -83,21 +85,9 @@ void abcd::solveABCD ( MV_ColMat_double &b )
     }
 
     t = MPI_Wtime();
-    //TODO: change 1 to nrhs
-    MV_ColMat_double f(size_c, 1, 0);
-    for(std::map<int,int>::iterator it = glob_to_local.begin();
-        it != glob_to_local.end(); ++it){
-        if(it->first >= n_o){
-            f(it->first - n_o, 0) = -1 * w(it->second, 0);
-        }
-    }
-    {
-        double *f_ptr = f.ptr();
-        MV_ColMat_double ff(size_c, 1, 0);
-        double *f_o = ff.ptr();
-        mpi::all_reduce(inter_comm, f_ptr, size_c, f_o, or_bin);
-        f = ff;
-    }
+    // only the first master, the host of mumps_S, gets f
+    MV_ColMat_double f;
+    gatherF(w, f);
     if(inter_comm.rank() == 0){
         LINFO << "> Time to centralize f : " << setprecision(2) << MPI_Wtime() - t;
     }
@@ -110,24 +100,18 @@ void abcd::solveABCD ( MV_ColMat_double &b )
     }
 
     t = MPI_Wtime();
-#ifdef WIP
     if(icntl[Controls::aug_iterative] != 0){
         if(inter_comm.rank() == 0)
             LINFO << "* ITERATIVELY                      *";
 
-        VECTOR_double f0 = f.data();
-        f0 = pcgS(f0);
-        f.setData(f0);
+        // the iterations work on a replicated f
+        if(inter_comm.rank() != 0) f = MV_ColMat_double(size_c, nrhs, 0);
+        mpi::broadcast(inter_comm, f.ptr(), size_c * nrhs, 0);
 
+        f = pcgS(f);
     } else {
-
-#endif //WIP
-
-        f = solveS(f);
-
-#ifdef WIP
+        solveS(f);
     }
-#endif //WIP
 
     if(IRANK == 0) 
         LINFO << "| Time to solve Sz = f: " << setprecision(2) << MPI_Wtime() - t;
@@ -140,19 +124,11 @@ void abcd::solveABCD ( MV_ColMat_double &b )
     }
 
 
-    Xk = MV_ColMat_double(n, 1, 0);
-    MV_ColMat_double zrhs(m, 1, 0); 
-
-    for( int i = 0; i < size_c; i++){
+    Xk = MV_ColMat_double(n, nrhs, 0);
+    MV_ColMat_double zrhs(m, nrhs, 0); 
 
-        std::map<int,int>::iterator iti = glob_to_local.find(n_o + i);
-
-        if(iti!=glob_to_local.end()){
-            Xk(glob_to_local[n_o + i], 0) = f(i, 0);
-        } else {
-            continue;
-        }
-    }
+    // each master gets the part of z on the C columns it holds
+    scatterZ(f, Xk);
 
 #ifdef WIP
     if(dcntl[Controls::aug_filter] == 0){
@@ -162,7 +138,7 @@ void abcd::solveABCD ( MV_ColMat_double &b )
 #ifdef WIP
     } else {
         use_xk = false;
-        f = MV_ColMat_double(n, 1, 0);
+        f = MV_ColMat_double(n, nrhs, 0);
 
         if(!use_xk){
             int st = 0;
@@ -170,14 +146,14 @@ void abcd::solveABCD ( MV_ColMat_double &b )
                 MV_ColMat_double sp =  spsmv(partitions[p], local_column_index[p], Xk);
                 int pos = 0;
                 for(int k = st; k < st + partitions[p].dim(0); k++){
-                    zrhs(k, 0) = sp(pos, 0);
+                    for(int j = 0; j < nrhs; j++)
+                        zrhs(k, j) = sp(pos, j);
                     pos++;
                 }
                 st += partitions[p].dim(0);
             }
 
-            for(int i = 0; i < f.dim(0); i++)
-                f(i, 0) = Xk(i, 0);
+            f = Xk;
         }
 
         bcg(zrhs);
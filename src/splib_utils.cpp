@@ -50,6 +50,7 @@
 
 #include <abcd.h>
 #include "blas.h"
+#include <new>
 
 double infNorm(VECTOR_double &V){
     double max = 0;
@@ -113,6 +114,25 @@ CompCol_Mat_double CSC_middleRows (CompRow_Mat_double &M, int st_row, int nb_row
     return CompCol_Mat_double(CSR_middleRows(M, st_row, nb_rows));
 }
 
+/// Makes M use the given CSR arrays in place: nothing is copied and the
+/// arrays are not released with M. SparseLib++ only builds references
+/// through the constructors of its vectors, they are rebuilt in place.
+void CSR_reference (CompRow_Mat_double &M, int m, int n, int nz,
+                    double *val, int *row_ptr, int *col_ind)
+{
+    M.val_.~MV_Vector_double();
+    new (&M.val_) MV_Vector_double(val, nz, MV_Vector_::ref);
+    M.rowptr_.~MV_Vector_int();
+    new (&M.rowptr_) MV_Vector_int(row_ptr, m + 1, MV_Vector_::ref);
+    M.colind_.~MV_Vector_int();
+    new (&M.colind_) MV_Vector_int(col_ind, nz, MV_Vector_::ref);
+
+    M.base_ = 0;
+    M.nz_ = nz;
+    M.dim_[0] = m;
+    M.dim_[1] = n;
+}
+
 VECTOR_double middleCol(CompCol_Mat_double &M, int col_num, VECTOR_int &ind){
     int st_index, ed_index;
 
@@ -50,6 +50,9 @@ void abcd::partitionMatrix()
     unsigned row_sum = 0;
     int guessPartitionsNumber = icntl[Controls::part_guess];
 
+    // A is not permuted yet
+    row_perm.clear();
+
     if(guessPartitionsNumber == 1 && icntl[Controls::part_type] > 1){
         if (m_o == 1) {
             icntl[Controls::nbparts] = 1;
@@ -96,6 +99,10 @@ void abcd::partitionMatrix()
         LWARNING << "WARNING: PaToH is useless with a single partiton request, switching to automatic partitioning";
         icntl[Controls::part_type] = 2;
     }
+    if (icntl[Controls::nbparts] == 1 && icntl[Controls::part_type] == 4) {
+        LWARNING << "WARNING: The multilevel partitioner is useless with a single partiton request, switching to automatic partitioning";
+        icntl[Controls::part_type] = 2;
+    }
 
     if (icntl[Controls::part_type] == 1 && nbrows.size() == 0) {
         info[Controls::status] = -4;
@@ -157,12 +164,14 @@ void abcd::partitionMatrix()
          *-----------------------------------------------------------------------------*/
     case 3:
 #ifdef PATOH
+        {
         PaToH_Parameters args;
         int _c, _n, _nconst, _imba, _ne, *cwghts, *nwghts, *xpins, *pins, *partvec,
             cut, *partweights, ret;
         char cutdef[] = "CUT";
 
-        CompCol_Mat_double t_A = Coord_Mat_double(A);
+        std::vector<int> col_ptr, row_ind;
+        abcd::columnPattern(col_ptr, row_ind);
 
         double t = MPI_Wtime();
         LINFO << "Launching PaToH";
@@ -175,15 +184,8 @@ void abcd::partitionMatrix()
         _imba   = dcntl[Controls::part_imbalance];
         _ne     = nz_o;
 
-        xpins   = new int[_n + 1];
-        pins    = new int[nz_o];
-
-        for(int i = 0; i <= _n; i++){
-            xpins[i] = t_A.col_ptr(i);
-        }
-        for(int i = 0; i < _ne; i++){
-            pins[i] = t_A.row_ind(i);
-        }
+        xpins   = &col_ptr[0];
+        pins    = &row_ind[0];
 
         cwghts  = new int[_c*_nconst];
         //using boost lambdas
@@ -219,61 +221,59 @@ void abcd::partitionMatrix()
             }
         }
 
-        row_perm = sort_indexes(partvec, _c);
-
-        // Permutation
-        int *iro = A.rowptr_ptr();
-        int *jco = A.colind_ptr();
-        double *valo = A.val_ptr();
-
-        int *ir = new int[m_o + 1];
-        int *jc = new int[nz_o];
-        double *val = new double[nz_o];
-
-        int sr = 0;
-        for(int i = 0; i < m_o; i++){
-            int cur = row_perm[i];
-            ir[i] = sr;
-            for(int j = 0; j < iro[cur+1] - iro[cur]; j++){
-                jc[ir[i] + j] = jco[iro[cur] + j];
-                val[ir[i] + j] = valo[iro[cur] + j];
-            }
-            sr += iro[cur + 1] - iro[cur];
-        }
-        ir[m_o] = nz_o;
         LINFO << "Done with PaToH, time : " << MPI_Wtime() - t << "s.";
         t = MPI_Wtime();
 
-        A = CompRow_Mat_double(m_o, n_o, nz_o, val, ir, jc);
-
-        int * test;
-        
-        nbrows = std::vector<int>(partweights, partweights + icntl[Controls::nbparts]);
-        strow =  std::vector<int>(icntl[Controls::nbparts]);
-
-        for(unsigned k = 0; k < icntl[Controls::nbparts]; k++) {
-            strow[k] = row_sum;
-            row_sum += nbrows[k];
-        }
+        abcd::applyRowPartition(partvec);
 
         LINFO << "Finished Partitioning, time: " << MPI_Wtime() - t << "s.";
            
-        delete[] ir;
-        delete[] jc;
-        delete[] val;
         delete[] partvec;
         delete[] partweights;
         delete[] cwghts;
-        delete[] pins;
-        delete[] xpins;
         delete[] nwghts;
         PaToH_Free();
+        }
 #else
         info[Controls::status] = -7;
         mpi::broadcast(comm, info[Controls::status], 0);
         throw std::runtime_error("Trying to use PaToH while it is not available");
 #endif
         break;
+        /*-----------------------------------------------------------------------------
+         *  In-tree multilevel hypergraph partitioning
+         *-----------------------------------------------------------------------------*/
+    case 4:
+        {
+            double t = MPI_Wtime();
+            LINFO << "Launching the multilevel partitioner";
+
+            std::vector<int> partvec;
+            abcd::multilevelPartition(partvec);
+
+            std::vector<int> weights(icntl[Controls::nbparts], 0);
+            for(int i = 0; i < m_o; i++) weights[partvec[i]]++;
+            for (int i = 0; i < icntl[Controls::nbparts]; i++) {
+                if (weights[i] == 0) {
+                    info[Controls::status] = -6;
+                    mpi::broadcast(comm, info[Controls::status], 0);
+                    throw std::runtime_error("FATAL ERROR: The multilevel partitioner produced an empty partition");
+                }
+            }
+            LINFO << "Done with the multilevel partitioner, time : " << MPI_Wtime() - t << "s.";
+            t = MPI_Wtime();
+
+            abcd::applyRowPartition(&partvec[0]);
+
+            LINFO << "Finished Partitioning, time: " << MPI_Wtime() - t << "s.";
+        }
+        break;
+    }
+
+    if(icntl[Controls::part_refine] != 0 && icntl[Controls::nbparts] > 1) {
+        double t = MPI_Wtime();
+        abcd::refinePartitionCoupling();
+        LINFO << "Partitions refined by coupling, time: " << MPI_Wtime() - t << "s.";
     }
 
     if(write_problem.length() != 0) {
@@ -304,6 +304,90 @@ void abcd::partitionMatrix()
     }
 }
 
+/// Permutes the rows of A so that the partitions are contiguous and
+/// defines abcd::row_perm, abcd::nbrows and abcd::strow accordingly
+///
+/// When A is already permuted, the new permutation is composed with
+/// abcd::row_perm so that it still refers to the original rows.
+/// \param partvec The partition of each row of the current A
+void abcd::applyRowPartition(const int *partvec)
+{
+    std::vector<int> perm = sort_indexes(partvec, m_o);
+
+    // a distributed matrix is only a slice here, its rows are sent
+    // permuted by abcd::distributedRowPartition
+    if(icntl[Controls::dist_input] == 0) {
+        // Permutation
+        int *iro = A.rowptr_ptr();
+        int *jco = A.colind_ptr();
+        double *valo = A.val_ptr();
+
+        int *ir = new int[m_o + 1];
+        int *jc = new int[nz_o];
+        double *val = new double[nz_o];
+
+        int sr = 0;
+        for(int i = 0; i < m_o; i++){
+            int cur = perm[i];
+            ir[i] = sr;
+            for(int j = 0; j < iro[cur+1] - iro[cur]; j++){
+                jc[ir[i] + j] = jco[iro[cur] + j];
+                val[ir[i] + j] = valo[iro[cur] + j];
+            }
+            sr += iro[cur + 1] - iro[cur];
+        }
+        ir[m_o] = nz_o;
+
+        A = CompRow_Mat_double(m_o, n_o, nz_o, val, ir, jc);
+
+        delete[] ir;
+        delete[] jc;
+        delete[] val;
+    }
+
+    if(row_perm.size() != 0) {
+        for(int i = 0; i < m_o; i++) perm[i] = row_perm[perm[i]];
+    }
+    row_perm = perm;
+
+    nbrows.assign(icntl[Controls::nbparts], 0);
+    for(int i = 0; i < m_o; i++) nbrows[partvec[i]]++;
+
+    strow = std::vector<int>(icntl[Controls::nbparts]);
+    int row_sum = 0;
+    for(int k = 0; k < icntl[Controls::nbparts]; k++) {
+        strow[k] = row_sum;
+        row_sum += nbrows[k];
+    }
+}
+
+/// The pattern of the matrix by columns, i.e. the nets of the
+/// hypergraph whose vertices are the rows
+///
+/// It is taken from abcd::pattern_rp and abcd::pattern_ci when they are
+/// gathered, from A otherwise, without copying the values.
+/// \param xpins The start of each column in pins
+/// \param pins The rows of each column
+void abcd::columnPattern(std::vector<int> &xpins, std::vector<int> &pins)
+{
+    const int *rp = A.rowptr_ptr();
+    const int *ci = A.colind_ptr();
+    if(pattern_rp.size() != 0) {
+        rp = &pattern_rp[0];
+        ci = &pattern_ci[0];
+    }
+
+    xpins.assign(n_o + 1, 0);
+    for(int p = 0; p < rp[m_o]; p++) xpins[ci[p] + 1]++;
+    for(int j = 0; j < n_o; j++) xpins[j + 1] += xpins[j];
+
+    std::vector<int> next(xpins.begin(), xpins.end() - 1);
+    pins.resize(rp[m_o]);
+    for(int i = 0; i < m_o; i++) {
+        for(int p = rp[i]; p < rp[i + 1]; p++) pins[next[ci[p]]++] = i;
+    }
+}
+
 void abcd::analyseFrame()
 {
     LINFO << "Launching frame analysis";
@@ -317,19 +401,25 @@ void abcd::analyseFrame()
 
     LINFO << "Creating partitions";
     
-    for (unsigned int k = 0; k < (unsigned int)icntl[Controls::nbparts]; ++k) {
-        CompCol_Mat_double part(CSC_middleRows(A, strow[k], nbrows[k]));
-        
-        int *col_ptr = part.colptr_ptr();
-        column_index[k] =  getColumnIndex(col_ptr, part.dim(1));
-
-        // if no augmentation, then create the parts
-        if(icntl[Controls::aug_type] == 0)
-        {
-            parts[k] = CompRow_Mat_double(sub_matrix(part, column_index[k]));
-        } else 
-        {
-            loc_parts[k] = CompCol_Mat_double(part);
+    if (dist_prep) {
+        // the partitions stay on the masters holding them, see
+        // abcd::adoptDistributedPartitions
+        abcd::distributedPartitions();
+    } else {
+        for (unsigned int k = 0; k < (unsigned int)icntl[Controls::nbparts]; ++k) {
+            CompCol_Mat_double part(CSC_middleRows(A, strow[k], nbrows[k]));
+
+            int *col_ptr = part.colptr_ptr();
+            column_index[k] =  getColumnIndex(col_ptr, part.dim(1));
+
+            // if no augmentation, then create the parts
+            if(icntl[Controls::aug_type] == 0)
+            {
+                parts[k] = CompRow_Mat_double(sub_matrix(part, column_index[k]));
+            } else 
+            {
+                loc_parts[k] = CompCol_Mat_double(part);
+            }
         }
     }
     LINFO << "Partitions created in: " << MPI_Wtime() - t << "s.";
@@ -349,7 +439,12 @@ void abcd::analyseFrame()
     }
 #endif //WIP
 
-    if (icntl[Controls::aug_type] != 0) {
+    bool known_aug = icntl[Controls::aug_type] == 1 || icntl[Controls::aug_type] == 2;
+    if (dist_prep && known_aug) {
+        t = MPI_Wtime();
+        abcd::distributedAugmentation();
+        LINFO << "Augmentation time: " << MPI_Wtime() - t << "s.";
+    } else if (icntl[Controls::aug_type] != 0) {
         t = MPI_Wtime();
         abcd::augmentMatrix(loc_parts);
         LINFO << "Augmentation time: " << MPI_Wtime() - t << "s.";
@@ -389,3 +484,61 @@ void abcd::analyseFrame()
 
 }
 
+
+/// Computes on the master the values of all the partitions, with their
+/// augmentation, from new values of A. They are in the order of the
+/// entries of the partitions built by analyseFrame, whose structure is
+/// left untouched.
+/// \param new_A The scaled and permuted matrix with the new values
+/// \param part_vals The values of each partition
+/// \return -14 when the size of C has changed
+int abcd::refreshPartitions(CompRow_Mat_double &new_A,
+                            std::vector<std::vector<double> > &part_vals)
+{
+    int nbp = icntl[Controls::nbparts];
+    std::vector<CompCol_Mat_double> loc_parts(nbp);
+    std::vector<std::vector<int> > a_ci(nbp);
+
+    for (int k = 0; k < nbp; ++k) {
+        loc_parts[k] = CSC_middleRows(new_A, strow[k], nbrows[k]);
+        a_ci[k] = getColumnIndex(loc_parts[k].colptr_ptr(), loc_parts[k].dim(1));
+    }
+
+    // the blocks of C are recomputed from the new values, they take the
+    // same columns as in the augmentation
+    std::map<int, std::vector<CompCol_Mat_double> > C;
+    std::map<int, std::vector<int> > stCols;
+    if (icntl[Controls::aug_type] != 0) {
+        std::map<std::pair<int, int>, PairBlocks> blocks;
+        abcd::localPairBlocks(loc_parts, a_ci, blocks);
+
+        int nbcols = new_A.dim(1);
+        for (std::map<std::pair<int, int>, PairBlocks>::iterator it = blocks.begin();
+             it != blocks.end(); ++it) {
+            int i = it->first.first;
+            int j = it->first.second;
+
+            stCols[i].push_back(nbcols);
+            stCols[j].push_back(nbcols);
+            C[i].push_back(it->second.C_i);
+            C[j].push_back(it->second.C_j);
+
+            nbcols += it->second.C_i.dim(1);
+        }
+
+        if (nbcols - new_A.dim(1) != size_c) return -14;
+    }
+
+    // the rows of a partition hold their entries by increasing columns,
+    // those of A then those of C
+    part_vals.assign(nbp, std::vector<double>());
+    for (int k = 0; k < nbp; ++k) {
+        if (C.count(k) != 0)
+            loc_parts[k] = concat_columns(loc_parts[k], C[k], stCols[k]);
+
+        CompRow_Mat_double part(loc_parts[k]);
+        part_vals[k].assign(part.val_ptr(), part.val_ptr() + part.NumNonzeros());
+    }
+
+    return 0;
+}
@@ -33,6 +33,7 @@
 #include <abcd.h>
 #include <iostream>
 #include <fstream>
+#include <cmath>
 
 
 /* 
@@ -95,6 +96,8 @@ void abcd::buildS(std::vector<int> &vr, std::vector<int> &vc, std::vector<double
         LDEBUG << "Avg number of cols is " << total/parallel_cg;
     }
 
+    double t_build = MPI_Wtime();
+
 #ifdef WIP    
 
 #ifndef NO_MUMPS_ES
@@ -117,6 +120,42 @@ void abcd::buildS(std::vector<int> &vr, std::vector<int> &vc, std::vector<double
         vv.reserve(my_cols.size() * my_cols.size());
 
         int share = icntl[Controls::aug_blocking];
+        int min_share = std::max(1, share / 4);
+        int max_share = 4 * share;
+
+        // Scale the block size with our number of columns and inversely to
+        // the cost of a solve, estimated from the size of the factors,
+        // both relative to the average master: a master with many columns
+        // or cheap solves takes larger blocks, for a better sparse
+        // right-hand side throughput on the critical path
+        bool balance = icntl[Controls::aug_balance] != 0;
+        if(balance) {
+            double fac = mumps.getInfoG(29);
+            if(fac < 0) fac = -fac * 1e6;
+            if(fac == 0) fac = m_nz;
+
+            double avg_fac = mpi::all_reduce(inter_comm, fac, std::plus<double>()) / parallel_cg;
+            double avg_cols = (double) total / parallel_cg;
+
+            if(avg_fac > 0 && fac > 0 && avg_cols > 0 && !my_cols.empty()) {
+                double scale = (my_cols.size() / avg_cols) * (avg_fac / fac);
+                share = std::min(max_share, std::max(min_share, (int) std::ceil(share * scale)));
+            }
+        }
+        double avg_tp = 0;
+        double grow = 1.25;
+        // relative drop of the averaged throughput that turns the search back
+        const double tp_tol = 0.1;
+
+        // the Schur complements give all the columns at once
+        if(icntl[Controls::aug_schur] != 0) {
+            double t = MPI_Wtime();
+            abcd::buildSchurS(my_cols, vr, vc, vv);
+            pos = my_cols.end();
+
+            if(inter_comm.rank() == 0)
+                LINFO << "> T.Schur complements: " << setprecision(2) << MPI_Wtime() - t;
+        }
 
         while(pos != my_cols.end()){
             if(pos + share < my_cols.end()) end_pos = pos + share;
@@ -136,6 +175,8 @@ void abcd::buildS(std::vector<int> &vr, std::vector<int> &vc, std::vector<double
             int mumps_share = share;
             mumps.icntl[27 - 1] = mumps_share;
 
+            double t_block = MPI_Wtime();
+
 #ifdef WIP
             // debug
             bool dense_build = false;
@@ -163,6 +204,26 @@ void abcd::buildS(std::vector<int> &vr, std::vector<int> &vc, std::vector<double
                 spSimpleProject(cur_cols, vr, vc, vv);
 #endif // WIP
             pos = end_pos;
+
+            // Follow the measured throughput, keep growing (or shrinking)
+            // the blocks while it improves. It is averaged over the last
+            // blocks and has to drop by tp_tol to turn back, a single slow
+            // block is noise
+            if(balance) {
+                double tp = cur_cols.size() / std::max(MPI_Wtime() - t_block, 1e-9);
+                if(avg_tp == 0) {
+                    avg_tp = tp;
+                } else {
+                    double last_avg = avg_tp;
+                    avg_tp = 0.5 * (avg_tp + tp);
+                    if(avg_tp < (1 - tp_tol) * last_avg) grow = 1 / grow;
+                }
+
+                // rounded up, a small block would not move otherwise
+                int step = (int) std::ceil(share * std::abs(grow - 1));
+                share = grow > 1 ? share + step : share - step;
+                share = std::min(max_share, std::max(min_share, share));
+            }
         }
 
 
@@ -199,6 +260,15 @@ void abcd::buildS(std::vector<int> &vr, std::vector<int> &vc, std::vector<double
     }
 #endif // WIP
 
+    // max over average of the build times, 1 is a perfect balance
+    t_build = MPI_Wtime() - t_build;
+    double max_t = mpi::all_reduce(inter_comm, t_build, mpi::maximum<double>());
+    double sum_t = mpi::all_reduce(inter_comm, t_build, std::plus<double>());
+    dinfo[Controls::s_imbalance] = sum_t > 0 ? max_t * parallel_cg / sum_t : 1;
+    if(inter_comm.rank() == 0){
+        LDEBUG << "S build time max " << max_t << " avg " << sum_t / parallel_cg;
+    }
+
     if(vv.size() == 0) {
         vc.push_back(0);
         vr.push_back(0);
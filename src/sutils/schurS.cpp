@@ -0,0 +1,160 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#include <abcd.h>
+#include <mumps.h>
+#include "blas.h"
+
+/* 
+ * ===  FUNCTION  ======================================================================
+ *         Name:  abcd::buildSchurS
+ *  Description:  Builds the local contributions to S from the Schur
+ *                complements of the augmented systems
+ *
+ *  For a partition A_k, the (1,1) block of the inverse of the augmented
+ *  matrix [I A_k^T; A_k 0] is I - P_k. Its restriction to the C variables
+ *  is the inverse of the Schur complement on these variables, and the
+ *  contribution of the partition to S = Y (I - P) Y^T is that inverse
+ *  minus half the identity, each C column being in two partitions.
+ * =====================================================================================
+ */
+void abcd::buildSchurS(std::vector<int> &my_cols, std::vector<int> &vr,
+                       std::vector<int> &vc, std::vector<double> &vv)
+{
+    std::vector<int> wanted(size_c, 0);
+    for(size_t i = 0; i < my_cols.size(); i++) wanted[my_cols[i]] = 1;
+
+    for(int p = 0; p < nb_local_parts; p++) {
+        if(stC[p] == -1) continue;
+
+        CompRow_Mat_double &part = partitions[p];
+        std::vector<int> &civ = column_index[p];
+
+        int start_c = glob_to_part[p][stC[p]];
+        int dim0 = part.dim(0);
+        int dim1 = part.dim(1);
+        int ns = dim1 - start_c;
+
+        if(ns == 0) continue;
+
+        // the augmented system of the partition, lower triangular part
+        int nz = dim1 + part.NumNonzeros();
+        std::vector<int> irn, jcn;
+        std::vector<double> val;
+        irn.reserve(nz);
+        jcn.reserve(nz);
+        val.reserve(nz);
+
+        for(int i = 0; i < dim1; i++) {
+            irn.push_back(i + 1);
+            jcn.push_back(i + 1);
+            val.push_back(1);
+        }
+        for(int k = 0; k < dim0; k++) {
+            for(int j = part.row_ptr(k); j < part.row_ptr(k + 1); j++) {
+                irn.push_back(dim1 + k + 1);
+                jcn.push_back(part.col_ind(j) + 1);
+                val.push_back(part.val(j));
+            }
+        }
+
+        // the C columns are the last ones of the partition
+        std::vector<int> listvar(ns);
+        for(int i = 0; i < ns; i++) listvar[i] = start_c + i + 1;
+        std::vector<double> schur(ns * ns, 0);
+
+        MUMPS mu;
+        mu.sym = 2;
+        mu.par = 1;
+        mu.comm_fortran = MPI_Comm_c2f(MPI_COMM_SELF);
+        mu(-1);
+
+        mu.icntl[0] = -1;
+        mu.icntl[1] = -1;
+        mu.icntl[2] = -1;
+
+        mu.n = dim0 + dim1;
+        mu.nz = nz;
+        mu.irn = &irn[0];
+        mu.jcn = &jcn[0];
+        mu.a = &val[0];
+
+        // the dense Schur block is not in the workspace estimate
+        mu.setIcntl(14, 90);
+        mu.setIcntl(19, 1);
+        mu.size_schur = ns;
+        mu.listvar_schur = &listvar[0];
+        mu.schur = &schur[0];
+
+        // analysis and factorization
+        mu(4);
+        int mu_info = mu.info[0];
+        mu(-2);
+
+        if(mu_info < 0) {
+            LERROR << "MUMPS exited with " << mu_info << " on the Schur complement of partition " << p;
+            int job = -90 + mu_info;
+            mpi::broadcast(intra_comm, job, 0);
+            throw std::runtime_error("MUMPS exited with an error");
+        }
+
+        // the lower triangular part by rows is, in column major, the
+        // upper one; invert it in place
+        char up = 'U';
+        int ierr = 0;
+        dpotrf_(&up, &ns, &schur[0], &ns, &ierr);
+        if(ierr == 0) dpotri_(&up, &ns, &schur[0], &ns, &ierr);
+
+        if(ierr != 0) {
+            info[Controls::status] = -13;
+            int job = -13;
+            mpi::broadcast(intra_comm, job, 0);
+            throw std::runtime_error("The Schur complement of an augmented system is not positive definite");
+        }
+
+        for(int j = 0; j < ns; j++) {
+            int col = civ[start_c + j] - n_o;
+            if(!wanted[col]) continue;
+
+            for(int i = j; i < ns; i++) {
+                double v = schur[j + i * ns];
+                if(i == j) v -= 0.5;
+
+                if(v != 0) {
+                    vr.push_back(civ[start_c + i] - n_o + 1);
+                    vc.push_back(col + 1);
+                    vv.push_back(v);
+                }
+            }
+        }
+    }
+}       /* -----  end of function abcd::buildSchurS  ----- */
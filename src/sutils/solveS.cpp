@@ -40,7 +40,7 @@
  *  Description:  
  * =====================================================================================
  */
-MV_ColMat_double
+void
 abcd::solveS ( MV_ColMat_double &f )
 {
     double t;
@@ -187,7 +187,7 @@ abcd::solveS ( MV_ColMat_double &f )
 
     if(inter_comm.rank() == 0){
         mumps_S.rhs = f.ptr();
-        mumps_S.nrhs = 1;
+        mumps_S.nrhs = f.dim(1);
         mumps_S.lrhs = size_c;
     }
 
@@ -198,14 +198,10 @@ abcd::solveS ( MV_ColMat_double &f )
 
     mumps_S(3);
 
-    double *f_ptr = f.ptr();
-    // TODO : better send parts not the whole z
-    //
-    mpi::broadcast(inter_comm, f_ptr, size_c, 0);
+    // z overwrites f, only on the first master, see abcd::scatterZ. The
+    // other masters hold an empty f that cannot be copied around.
     if(inter_comm.rank() == 0){
         LINFO << "> Took: " << setprecision(2) << MPI_Wtime() - t;
         LINFO << "*----------------------------------*";
     }
-
-    return f;
 }       /* -----  end of function abcd::solveS  ----- */
@@ -0,0 +1,340 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#include <abcd.h>
+#include <mumps.h>
+
+#include <iostream>
+
+/// Builds the coarse space and factorizes the coarse matrix E = Z^T H Z
+///
+/// Each column goes to the first local partition holding it on the
+/// master owning it (see abcd::comm_map), the other masters learn it
+/// from the owner. The coarse vector z_q is the indicator of the
+/// columns of the partition q. As P_i z_q only involves the columns
+/// of the partition i, each partition contributes the block of E
+/// coupling the coarse vectors of its columns, with a single local
+/// solve of its augmented system.
+void abcd::buildCoarseSpace()
+{
+    double t = MPI_Wtime();
+    int nb_coarse = icntl[Controls::nbparts];
+
+    coarse_id.assign(n, -1);
+    for(int k = 0; k < nb_local_parts; k++) {
+        for(size_t l = 0; l < local_column_index[k].size(); l++) {
+            int c = local_column_index[k][l];
+            if(coarse_id[c] < 0) coarse_id[c] = parts_id[k];
+        }
+    }
+
+    // the shared columns take the id of the master of lowest rank
+    {
+        std::vector<int> nbrs;
+        std::vector<std::vector<int> > mine, theirs;
+        std::vector<mpi::request> reqs;
+        for(std::map<int, std::vector<int> >::iterator it = col_interconnections.begin();
+                it != col_interconnections.end(); ++it) {
+            if(it->second.size() == 0) continue;
+            nbrs.push_back(it->first);
+            mine.push_back(std::vector<int>());
+            for(size_t i = 0; i < it->second.size(); i++) {
+                mine.back().push_back(coarse_id[it->second[i]]);
+            }
+            theirs.push_back(std::vector<int>(it->second.size()));
+        }
+        for(size_t k = 0; k < nbrs.size(); k++) {
+            reqs.push_back(inter_comm.irecv(nbrs[k], 82, &theirs[k][0], theirs[k].size()));
+            reqs.push_back(inter_comm.isend(nbrs[k], 82, &mine[k][0], mine[k].size()));
+        }
+        mpi::wait_all(reqs.begin(), reqs.end());
+
+        // the neighbours are in increasing ranks, the first one wins
+        std::vector<bool> taken(n, false);
+        for(size_t k = 0; k < nbrs.size(); k++) {
+            if(nbrs[k] > inter_comm.rank()) break;
+            std::vector<int> &cols = col_interconnections[nbrs[k]];
+            for(size_t i = 0; i < cols.size(); i++) {
+                if(taken[cols[i]]) continue;
+                coarse_id[cols[i]] = theirs[k][i];
+                taken[cols[i]] = true;
+            }
+        }
+    }
+
+    // the coupling of the coarse vectors of each partition, slot t of
+    // partition k is its t-th coarse vector
+    std::vector<std::vector<int> > part_q(nb_local_parts);
+    std::vector<int> slot(nb_coarse, -1);
+    int s = 1;
+    for(int k = 0; k < nb_local_parts; k++) {
+        for(size_t l = 0; l < local_column_index[k].size(); l++) {
+            int q = coarse_id[local_column_index[k][l]];
+            if(slot[q] >= 0) continue;
+            slot[q] = part_q[k].size();
+            part_q[k].push_back(q);
+        }
+        for(size_t t = 0; t < part_q[k].size(); t++) slot[part_q[k][t]] = -1;
+        s = std::max<int>(s, part_q[k].size());
+    }
+
+    // rhs = A_k z_q below each partition's block
+    std::vector<double> rhs(size_t(mumps.n) * s, 0);
+    int pos = 0;
+    for(int k = 0; k < nb_local_parts; k++) {
+        CompRow_Mat_double *part = &partitions[k];
+        int *rp = part->rowptr_ptr();
+        int *cp = part->colind_ptr();
+        double *vp = part->val_ptr();
+        std::vector<int> &lci = local_column_index[k];
+
+        for(size_t t = 0; t < part_q[k].size(); t++) slot[part_q[k][t]] = t;
+
+        double *rpt = &rhs[pos + part->dim(1)];
+        for(int i = 0; i < part->dim(0); i++) {
+            for(int c = rp[i]; c < rp[i + 1]; c++) {
+                rpt[i + slot[coarse_id[lci[cp[c]]]] * mumps.n] += vp[c];
+            }
+        }
+
+        for(size_t t = 0; t < part_q[k].size(); t++) slot[part_q[k][t]] = -1;
+        pos += part->dim(1) + part->dim(0);
+    }
+
+    int job = 1;
+    mpi::broadcast(intra_comm, job, 0);
+
+    mumps.rhs = &rhs[0];
+    mumps.nrhs = s;
+    mumps.lrhs = mumps.n;
+    mumps.job = 3;
+    dmumps_c(&mumps);
+
+    // E(p, q) += z_p^T P_k z_q, the lower triangle with 1-based indices
+    std::vector<int> er, ec;
+    std::vector<double> ev;
+    std::vector<bool> used(nb_coarse, false);
+    pos = 0;
+    for(int k = 0; k < nb_local_parts; k++) {
+        std::vector<int> &lci = local_column_index[k];
+        int nq = part_q[k].size();
+
+        for(int t = 0; t < nq; t++) slot[part_q[k][t]] = t;
+
+        std::vector<double> blk(nq * nq, 0);
+        for(int t = 0; t < nq; t++) {
+            for(size_t l = 0; l < lci.size(); l++) {
+                blk[slot[coarse_id[lci[l]]] + t * nq] += rhs[pos + l + t * mumps.n];
+            }
+        }
+
+        for(int t = 0; t < nq; t++) {
+            for(int p = 0; p < nq; p++) {
+                if(part_q[k][p] < part_q[k][t] || blk[p + t * nq] == 0) continue;
+                er.push_back(part_q[k][p] + 1);
+                ec.push_back(part_q[k][t] + 1);
+                ev.push_back(blk[p + t * nq]);
+            }
+            used[part_q[k][t]] = true;
+            slot[part_q[k][t]] = -1;
+        }
+
+        pos += partitions[k].dim(1) + partitions[k].dim(0);
+    }
+
+    // a partition whose columns all went to others has no coarse vector
+    for(int k = 0; k < nb_local_parts; k++) {
+        if(used[parts_id[k]]) continue;
+        er.push_back(parts_id[k] + 1);
+        ec.push_back(parts_id[k] + 1);
+        ev.push_back(1);
+    }
+
+    factorizeOnMasters(mumps_E, nb_coarse, er, ec, ev, "the coarse matrix");
+
+    if(inter_comm.rank() == 0){
+        LINFO << "Coarse space of " << nb_coarse << " vectors built in "
+              << setprecision(2) << MPI_Wtime() - t;
+    }
+}
+
+/// Computes Z E^-1 Z^T r, the coarse correction of r
+MV_ColMat_double abcd::coarseCorrection(MV_ColMat_double &r)
+{
+    int s = r.dim(1);
+    int nb_coarse = icntl[Controls::nbparts];
+
+    std::vector<double> loc(nb_coarse * s, 0), y(nb_coarse * s, 0);
+    double *rp = r.ptr();
+    int rlda = r.lda();
+
+    for(int j = 0; j < s; j++) {
+        for(int i = 0; i < n; i++) {
+            if(comm_map[i] == 1) loc[coarse_id[i] + j * nb_coarse] += rp[i + j * rlda];
+        }
+    }
+
+    mpi::reduce(inter_comm, &loc[0], nb_coarse * s, &y[0], std::plus<double>(), 0);
+
+    if(inter_comm.rank() == 0) {
+        mumps_E.rhs = &y[0];
+        mumps_E.nrhs = s;
+        mumps_E.lrhs = nb_coarse;
+    }
+
+    mumps_E(3);
+
+    mpi::broadcast(inter_comm, &y[0], nb_coarse * s, 0);
+
+    MV_ColMat_double c(n, s, 0);
+    for(int j = 0; j < s; j++) {
+        for(int i = 0; i < n; i++) {
+            c(i, j) = y[coarse_id[i] + j * nb_coarse];
+        }
+    }
+
+    return c;
+}
+
+/// Uses a CG preconditioned by the two-level correction I + Z E^-1 Z^T
+/// to solve Hx = k, each right-hand side having its own recurrence
+///
+/// The coarse space is built at the first call after a factorization.
+/// The backward error is computed every icntl[Controls::check_interval]
+/// iterations.
+/// \param b The right-hand side
+void abcd::twoLevelCG(MV_ColMat_double &b)
+{
+    std::streamsize oldprec = std::cout.precision();
+
+    const double threshold = dcntl[Controls::threshold];
+    const int itmax = icntl[Controls::itmax];
+    const int check_interval = std::max(1, icntl[Controls::check_interval]);
+
+    MV_ColMat_double u(m, nrhs, 0);
+    startAcceleration(b, u);
+
+    if(!mumps_E.initialized) buildCoarseSpace();
+
+    MV_ColMat_double r(n, nrhs, 0);
+    MV_ColMat_double z(n, nrhs, 0);
+    MV_ColMat_double p(n, nrhs, 0);
+    MV_ColMat_double q(n, nrhs, 0);
+
+    double t1_total = MPI_Wtime();
+
+    // r = k - Hx
+    if(use_xk) {
+        r = sumProject(1e0, u, -1e0, Xk);
+    } else {
+        r = sumProject(1e0, u, 0, Xk);
+    }
+    t1_total = MPI_Wtime() - t1_total;
+
+    double t2_total = MPI_Wtime();
+    z = r + coarseCorrection(r);
+    t2_total = MPI_Wtime() - t2_total;
+    p = z;
+
+    double *xp = Xk.ptr(), *rp = r.ptr(), *zp = z.ptr(), *pp = p.ptr(), *qp = q.ptr();
+    int xlda = Xk.lda();
+
+    std::vector<double> gamma(nrhs), delta(nrhs), gamma_new(nrhs);
+    std::vector<bool> active(nrhs, true);
+    globalDot(r, z, &gamma[0], true);
+
+    int it = 0;
+    int nb_checks = 1;
+    double rho = compute_rho(Xk, u);
+    double ti = MPI_Wtime();
+
+    while(rho > threshold && it < itmax) {
+        double t1 = MPI_Wtime();
+        q = sumProject(0e0, u, 1e0, p);
+        t1_total += MPI_Wtime() - t1;
+
+        globalDot(p, q, &delta[0], true);
+
+        bool any = false;
+        for(int j = 0; j < nrhs; j++) {
+            if(gamma[j] == 0 || delta[j] <= 0) active[j] = false;
+            any = any || active[j];
+        }
+        if(!any) break;
+
+        for(int j = 0; j < nrhs; j++) {
+            double a = active[j] ? gamma[j] / delta[j] : 0;
+            for(int i = 0; i < n; i++) {
+                xp[i + j * xlda] += a * pp[i + j * n];
+                rp[i + j * n] -= a * qp[i + j * n];
+            }
+        }
+        it++;
+
+        if(it % check_interval == 0 || it >= itmax) {
+            rho = compute_rho(Xk, u);
+            normres.push_back(rho);
+            nb_checks++;
+
+            if(comm.rank() == 0 && icntl[Controls::verbose_level] >= 2) {
+                int ev = icntl[Controls::verbose_level] >= 3 ? 1 : 10;
+                LOG_EVERY_N(ev, INFO) << "ITERATION " << it <<
+                    " rho = " << scientific << rho << setprecision(oldprec);
+            }
+            if(rho < threshold || it >= itmax) break;
+        }
+
+        double t2 = MPI_Wtime();
+        z = r + coarseCorrection(r);
+        t2_total += MPI_Wtime() - t2;
+
+        globalDot(r, z, &gamma_new[0], true);
+        for(int j = 0; j < nrhs; j++) {
+            double be = active[j] ? gamma_new[j] / gamma[j] : 0;
+            gamma[j] = gamma_new[j];
+            for(int i = 0; i < n; i++) {
+                pp[i + j * n] = zp[i + j * n] + be * pp[i + j * n];
+            }
+        }
+    }
+
+    if(inter_comm.rank() == 0) {
+        LINFO2 << "Two-level CG Rho: " << scientific << rho ;
+        LINFO2 << "Two-level CG Iterations : " << setprecision(2) << it ;
+        LINFO2 << "Two-level CG TIME : " << MPI_Wtime() - ti ;
+        LINFO2 << "SumProject time : " << t1_total ;
+        LINFO2 << "Coarse correction time : " << t2_total ;
+        LINFO2 << "Exact Rho computations : " << nb_checks ;
+    }
+    info[Controls::nb_backward] = nb_checks;
+    endAcceleration(it);
+}
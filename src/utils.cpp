@@ -147,7 +147,6 @@ void abcd::get_nrmres(MV_ColMat_double &x, MV_ColMat_double &b,
                       VECTOR_double &nrmR, VECTOR_double &nrmX)
 {
     int rn = x.dim(1);
-    int rm = x.dim(0);
 
     nrmX = 0;
     nrmR = 0;
@@ -155,9 +154,30 @@ void abcd::get_nrmres(MV_ColMat_double &x, MV_ColMat_double &b,
     VECTOR_double nrmXV(rn, 0);
     VECTOR_double nrmRV(rn, 0);
 
-    MV_ColMat_double loc_x(rm, rn, 0);
+    abcd::get_local_nrmres(x, b, nrmRV, nrmXV);
+
+    mpi::all_reduce(inter_comm, nrmRV.ptr(), rn, nrmR.ptr(), mpi::maximum<double>());
+    mpi::all_reduce(inter_comm, nrmXV.ptr(), rn, nrmX.ptr(), std::plus<double>());
+
+}
+
+/* 
+ * ===  FUNCTION  ======================================================================
+ *         Name:  abcd::get_local_nrmres
+ *  Description:  Computes the local contributions to ||r||_inf and ||X||
+ *                without any communication, the caller reduces them
+ * =====================================================================================
+ */
+void abcd::get_local_nrmres(MV_ColMat_double &x, MV_ColMat_double &b,
+                            VECTOR_double &nrmRV, VECTOR_double &nrmXV)
+{
+    int rn = x.dim(1);
+    int rm = x.dim(0);
+
+    nrmXV = 0;
+    nrmRV = 0;
+
     MV_ColMat_double loc_r(m, rn, 0);
-    MV_ColMat_double loc_xfmx(rm, rn, 0);
 
     int pos = 0;
     for(int i = 0; i < rm; i++) {
@@ -198,10 +218,6 @@ void abcd::get_nrmres(MV_ColMat_double &x, MV_ColMat_double &b,
         VECTOR_double loc_r_j = loc_r(j);
         nrmRV(j) = infNorm(loc_r_j);
     }
-
-    mpi::all_reduce(inter_comm, nrmRV.ptr(), rn, nrmR.ptr(), mpi::maximum<double>());
-    mpi::all_reduce(inter_comm, nrmXV.ptr(), rn, nrmX.ptr(), std::plus<double>());
-
 }
 
 double or_bin(double &a, double &b){
@@ -0,0 +1,87 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+// Converts a Matrix Market file into the binary format read by abcd_run,
+// a coordinate matrix becomes a CSR matrix and an array becomes
+// right-hand sides
+//
+//     abcd_convert matrix.mtx matrix.bin
+//     abcd_convert rhs.mtx rhs.bin
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "loader.h"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    if(argc != 3) {
+        clog << "Usage " << argv[0] << " input.mtx output.bin" << endl;
+        return -1;
+    }
+
+    string input = argv[1], output = argv[2];
+
+    // the banner tells a matrix from right-hand sides
+    ifstream f(input.c_str());
+    string banner;
+    getline(f, banner);
+    f.close();
+    transform(banner.begin(), banner.end(), banner.begin(), ::tolower);
+
+    try {
+        if(banner.find("array") != string::npos) {
+            int m, nrhs;
+            double *rhs = load_rhs(input, m, nrhs);
+            write_binary_rhs(output, rhs, m, nrhs);
+
+            cout << "Wrote " << nrhs << " right-hand sides of size " << m << endl;
+        } else {
+            matrix_data A = load_matrix(input);
+            coordinates_to_csr(A);
+            write_binary_matrix(output, A);
+
+            cout << "Wrote the matrix m = " << A.m << "; n = " << A.n << "; nz = " << A.nz
+                 << (A.sym ? " (symmetric)" : "") << endl;
+        }
+    } catch(std::runtime_error &e) {
+        cerr << e.what() << endl;
+        return -1;
+    }
+
+    return 0;
+}
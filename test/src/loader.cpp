@@ -0,0 +1,521 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#include "loader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <stdint.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+/// The header of the binary files, the arrays start right after it
+///
+/// A matrix is followed by its row pointers (m + 1 ints), its column
+/// indices (nz ints) and, from the next multiple of 8 bytes, its
+/// entries (nz doubles). Right-hand sides are followed by their
+/// m * nrhs values stored by columns, nrhs being kept in n.
+struct binary_header {
+    char magic[8];
+    int32_t version;
+    int32_t sym;
+    int64_t m;
+    int64_t n;
+    int64_t nz;
+    int64_t reserved[3];
+};
+
+const char csr_magic[8] = "ABCDCSR";
+const char rhs_magic[8] = "ABCDRHS";
+const int32_t binary_version = 1;
+
+/// The Matrix Market files are parsed by chunks of about this size,
+/// the chunks are shared between the threads
+const size_t chunk_size = 1 << 24;
+
+struct mapped_file {
+    char *data;
+    size_t size;
+};
+
+/// Maps a whole file in memory, the pages are private to the process
+mapped_file map_file(const string &file)
+{
+    int fd = open(file.c_str(), O_RDONLY);
+    if(fd < 0) throw runtime_error("Error opening the file '" + file + "'");
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        throw runtime_error("Error reading the file '" + file + "'");
+    }
+
+    void *p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) throw runtime_error("Error mapping the file '" + file + "'");
+
+    mapped_file f = {static_cast<char *>(p), static_cast<size_t>(st.st_size)};
+    return f;
+}
+
+inline bool is_binary(const mapped_file &f, const char *magic)
+{
+    return f.size >= sizeof(binary_header) && memcmp(f.data, magic, 8) == 0;
+}
+
+inline const char *next_line(const char *p, const char *end)
+{
+    p = static_cast<const char *>(memchr(p, '\n', end - p));
+    return p != NULL ? p + 1 : end;
+}
+
+inline const char *skip_blanks(const char *p, const char *end)
+{
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    return p;
+}
+
+/// True when the line starting at p holds data, not a comment nor blanks
+inline bool is_data(const char *p, const char *end)
+{
+    p = skip_blanks(p, end);
+    return p < end && *p != '\n' && *p != '%';
+}
+
+/// Parses an integer of the current line, the buffer is not terminated
+inline bool parse_int(const char *&p, const char *end, long &v)
+{
+    p = skip_blanks(p, end);
+    bool neg = false;
+    if(p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    if(p == end || !isdigit(static_cast<unsigned char>(*p))) return false;
+
+    long r = 0;
+    while(p < end && isdigit(static_cast<unsigned char>(*p))) r = 10 * r + (*p++ - '0');
+    v = neg ? -r : r;
+    return true;
+}
+
+/// Parses a real of the current line through a terminated copy
+inline bool parse_double(const char *&p, const char *end, double &v)
+{
+    p = skip_blanks(p, end);
+    char buf[64];
+    int l = 0;
+    while(p < end && l < 63 && !isspace(static_cast<unsigned char>(*p))) buf[l++] = *p++;
+    if(l == 0) return false;
+    buf[l] = '\0';
+
+    char *e;
+    v = strtod(buf, &e);
+    return e == buf + l;
+}
+
+/// Splits [begin, end) in chunks made of whole lines
+vector<const char *> split_lines(const char *begin, const char *end)
+{
+    vector<const char *> b(1, begin);
+    const char *p = begin;
+    while(p < end) {
+        p = static_cast<size_t>(end - p) > chunk_size ? next_line(p + chunk_size, end) : end;
+        b.push_back(p);
+    }
+    return b;
+}
+
+/// Reads the banner of a Matrix Market file and moves p to its size line
+vector<string> read_banner(const char *&p, const char *end, const string &file)
+{
+    const char *e = next_line(p, end);
+    string line(p, e);
+    transform(line.begin(), line.end(), line.begin(), ::tolower);
+
+    istringstream ss(line);
+    vector<string> banner;
+    string w;
+    while(ss >> w) banner.push_back(w);
+
+    if(banner.size() != 5 || banner[0] != "%%matrixmarket" || banner[1] != "matrix")
+        throw runtime_error("The file '" + file + "' is neither a Matrix Market nor an ABCD binary file");
+
+    if(banner[3] != "real" && banner[3] != "double" && banner[3] != "integer" && banner[3] != "pattern")
+        throw runtime_error("Only real matrices are supported, '" + file + "' is " + banner[3]);
+
+    if(banner[4] != "general" && banner[4] != "symmetric")
+        throw runtime_error("Only general and symmetric matrices are supported, '" + file + "' is " + banner[4]);
+
+    p = e;
+    while(p < end && !is_data(p, end)) p = next_line(p, end);
+    return banner;
+}
+
+matrix_data load_market_matrix(const mapped_file &f, const string &file)
+{
+    const char *p = f.data, *end = f.data + f.size;
+    vector<string> banner = read_banner(p, end, file);
+    if(banner[2] != "coordinate")
+        throw runtime_error("The matrix in '" + file + "' has to be in coordinate format");
+
+    long m, n, nz;
+    if(!parse_int(p, end, m) || !parse_int(p, end, n) || !parse_int(p, end, nz) ||
+       m <= 0 || n <= 0 || nz <= 0 || nz > numeric_limits<int>::max())
+        throw runtime_error("Wrong size line in '" + file + "'");
+    p = next_line(p, end);
+
+    matrix_data A;
+    A.m = m;
+    A.n = n;
+    A.nz = nz;
+    A.sym = banner[4] == "symmetric";
+    A.start_index = 1;
+    A.row_ptr = NULL;
+    A.irn = new int[nz];
+    A.jcn = new int[nz];
+    A.val = new double[nz];
+
+    bool pattern = banner[3] == "pattern";
+    vector<const char *> b = split_lines(p, end);
+    int nc = b.size() - 1;
+
+    // count the entries of each chunk to know where they go
+    vector<long> first(nc + 1, 0);
+    #pragma omp parallel for schedule(dynamic)
+    for(int c = 0; c < nc; c++) {
+        long k = 0;
+        for(const char *l = b[c]; l < b[c + 1]; l = next_line(l, b[c + 1]))
+            if(is_data(l, b[c + 1])) k++;
+        first[c + 1] = k;
+    }
+    for(int c = 0; c < nc; c++) first[c + 1] += first[c];
+
+    if(first[nc] != nz) {
+        delete[] A.irn;
+        delete[] A.jcn;
+        delete[] A.val;
+        ostringstream ss;
+        ss << "The file '" << file << "' announces " << nz << " entries but holds " << first[nc];
+        throw runtime_error(ss.str());
+    }
+
+    vector<char> bad(nc, 0);
+    #pragma omp parallel for schedule(dynamic)
+    for(int c = 0; c < nc; c++) {
+        long k = first[c];
+        for(const char *l = b[c]; l < b[c + 1]; l = next_line(l, b[c + 1])) {
+            if(!is_data(l, b[c + 1])) continue;
+
+            long i, j;
+            double v = 1;
+            if(!parse_int(l, b[c + 1], i) || !parse_int(l, b[c + 1], j) ||
+               (!pattern && !parse_double(l, b[c + 1], v)) ||
+               i < 1 || i > m || j < 1 || j > n) {
+                bad[c] = 1;
+                break;
+            }
+            A.irn[k] = i;
+            A.jcn[k] = j;
+            A.val[k] = v;
+            k++;
+        }
+    }
+
+    if(find(bad.begin(), bad.end(), 1) != bad.end()) {
+        delete[] A.irn;
+        delete[] A.jcn;
+        delete[] A.val;
+        throw runtime_error("Wrong entry in the file '" + file + "'");
+    }
+
+    return A;
+}
+
+matrix_data load_binary_matrix(const mapped_file &f, const string &file)
+{
+    binary_header h;
+    memcpy(&h, f.data, sizeof(h));
+
+    if(h.version != binary_version)
+        throw runtime_error("Unsupported version of the binary file '" + file + "'");
+    if(h.m <= 0 || h.n <= 0 || h.nz <= 0 || h.m >= numeric_limits<int>::max() ||
+       h.n > numeric_limits<int>::max() || h.nz > numeric_limits<int>::max())
+        throw runtime_error("Wrong sizes in the binary file '" + file + "'");
+
+    size_t ind = sizeof(h) + sizeof(int32_t) * (h.m + 1 + h.nz);
+    size_t vals = (ind + 7) / 8 * 8;
+    if(f.size < vals + sizeof(double) * h.nz)
+        throw runtime_error("The binary file '" + file + "' is truncated");
+
+    matrix_data A;
+    A.m = h.m;
+    A.n = h.n;
+    A.nz = h.nz;
+    A.sym = h.sym != 0;
+    A.start_index = 0;
+    A.irn = NULL;
+    A.row_ptr = reinterpret_cast<int *>(f.data + sizeof(h));
+    A.jcn = A.row_ptr + A.m + 1;
+    A.val = reinterpret_cast<double *>(f.data + vals);
+
+    if(A.row_ptr[0] != 0 || A.row_ptr[A.m] != A.nz)
+        throw runtime_error("Wrong row pointers in the binary file '" + file + "'");
+
+    // the solver trusts the structure, an entry out of its row or of
+    // the matrix would be read or written out of bounds
+    int bad_ptr = 0, bad_ind = 0;
+    #pragma omp parallel for reduction(max:bad_ptr)
+    for(int i = 0; i < A.m; i++)
+        if(A.row_ptr[i + 1] < A.row_ptr[i]) bad_ptr = 1;
+    if(bad_ptr)
+        throw runtime_error("Decreasing row pointers in the binary file '" + file + "'");
+
+    #pragma omp parallel for reduction(max:bad_ind)
+    for(int k = 0; k < A.nz; k++)
+        if(A.jcn[k] < 0 || A.jcn[k] >= A.n) bad_ind = 1;
+    if(bad_ind)
+        throw runtime_error("Column index out of range in the binary file '" + file + "'");
+
+    return A;
+}
+
+double *load_market_rhs(const mapped_file &f, const string &file, int &m, int &nrhs)
+{
+    const char *p = f.data, *end = f.data + f.size;
+    vector<string> banner = read_banner(p, end, file);
+    if(banner[2] != "array" || banner[3] == "pattern" || banner[4] != "general")
+        throw runtime_error("The right-hand sides in '" + file + "' have to be a general real array");
+
+    long lm, ln;
+    if(!parse_int(p, end, lm) || !parse_int(p, end, ln) || lm <= 0 || ln <= 0 ||
+       lm * ln > numeric_limits<int>::max())
+        throw runtime_error("Wrong size line in '" + file + "'");
+    p = next_line(p, end);
+
+    m = lm;
+    nrhs = ln;
+    double *rhs = new double[lm * ln];
+
+    vector<const char *> b = split_lines(p, end);
+    int nc = b.size() - 1;
+
+    // the values are counted per chunk, there may be several on a line
+    vector<long> first(nc + 1, 0);
+    #pragma omp parallel for schedule(dynamic)
+    for(int c = 0; c < nc; c++) {
+        long k = 0;
+        for(const char *l = b[c]; l < b[c + 1]; ) {
+            while(l < b[c + 1] && isspace(static_cast<unsigned char>(*l))) ++l;
+            if(l == b[c + 1]) break;
+            if(*l == '%') {
+                l = next_line(l, b[c + 1]);
+                continue;
+            }
+            while(l < b[c + 1] && !isspace(static_cast<unsigned char>(*l))) ++l;
+            k++;
+        }
+        first[c + 1] = k;
+    }
+    for(int c = 0; c < nc; c++) first[c + 1] += first[c];
+
+    if(first[nc] != lm * ln) {
+        delete[] rhs;
+        ostringstream ss;
+        ss << "The file '" << file << "' announces " << lm * ln << " values but holds " << first[nc];
+        throw runtime_error(ss.str());
+    }
+
+    vector<char> bad(nc, 0);
+    #pragma omp parallel for schedule(dynamic)
+    for(int c = 0; c < nc; c++) {
+        long k = first[c];
+        for(const char *l = b[c]; l < b[c + 1]; ) {
+            while(l < b[c + 1] && isspace(static_cast<unsigned char>(*l))) ++l;
+            if(l == b[c + 1]) break;
+            if(*l == '%') {
+                l = next_line(l, b[c + 1]);
+                continue;
+            }
+            if(!parse_double(l, b[c + 1], rhs[k++])) {
+                bad[c] = 1;
+                break;
+            }
+        }
+    }
+
+    if(find(bad.begin(), bad.end(), 1) != bad.end()) {
+        delete[] rhs;
+        throw runtime_error("Wrong value in the file '" + file + "'");
+    }
+
+    return rhs;
+}
+
+double *load_binary_rhs(const mapped_file &f, const string &file, int &m, int &nrhs)
+{
+    binary_header h;
+    memcpy(&h, f.data, sizeof(h));
+
+    if(h.version != binary_version)
+        throw runtime_error("Unsupported version of the binary file '" + file + "'");
+    if(h.m <= 0 || h.n <= 0 || h.m * h.n > numeric_limits<int>::max())
+        throw runtime_error("Wrong sizes in the binary file '" + file + "'");
+    if(f.size < sizeof(h) + sizeof(double) * h.m * h.n)
+        throw runtime_error("The binary file '" + file + "' is truncated");
+
+    m = h.m;
+    nrhs = h.n;
+    return reinterpret_cast<double *>(f.data + sizeof(h));
+}
+
+binary_header make_header(const char *magic, bool sym, int64_t m, int64_t n, int64_t nz)
+{
+    binary_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, magic, 8);
+    h.version = binary_version;
+    h.sym = sym;
+    h.m = m;
+    h.n = n;
+    h.nz = nz;
+    return h;
+}
+
+} // namespace
+
+matrix_data load_matrix(const string &file)
+{
+    mapped_file f = map_file(file);
+
+    try {
+        // the binary arrays are used in place, the mapping stays
+        if(is_binary(f, csr_magic)) return load_binary_matrix(f, file);
+
+        matrix_data A = load_market_matrix(f, file);
+        munmap(f.data, f.size);
+        return A;
+    } catch(...) {
+        munmap(f.data, f.size);
+        throw;
+    }
+}
+
+double *load_rhs(const string &file, int &m, int &nrhs)
+{
+    mapped_file f = map_file(file);
+
+    try {
+        if(is_binary(f, rhs_magic)) return load_binary_rhs(f, file, m, nrhs);
+
+        double *rhs = load_market_rhs(f, file, m, nrhs);
+        munmap(f.data, f.size);
+        return rhs;
+    } catch(...) {
+        munmap(f.data, f.size);
+        throw;
+    }
+}
+
+void coordinates_to_csr(matrix_data &A)
+{
+    if(A.row_ptr != NULL) return;
+
+    int *rp = new int[A.m + 1];
+    int *ci = new int[A.nz];
+    double *v = new double[A.nz];
+
+    fill(rp, rp + A.m + 1, 0);
+    for(int k = 0; k < A.nz; k++) rp[A.irn[k] - A.start_index + 1]++;
+    for(int i = 0; i < A.m; i++) rp[i + 1] += rp[i];
+
+    vector<int> tally(rp, rp + A.m);
+    for(int k = 0; k < A.nz; k++) {
+        int p = tally[A.irn[k] - A.start_index]++;
+        ci[p] = A.jcn[k] - A.start_index;
+        v[p] = A.val[k];
+    }
+
+    delete[] A.irn;
+    delete[] A.jcn;
+    delete[] A.val;
+
+    A.irn = NULL;
+    A.row_ptr = rp;
+    A.jcn = ci;
+    A.val = v;
+    A.start_index = 0;
+}
+
+void write_binary_matrix(const string &file, const matrix_data &A)
+{
+    if(A.row_ptr == NULL || A.start_index != 0)
+        throw runtime_error("Only 0-based CSR matrices can be written in binary");
+
+    ofstream f(file.c_str(), ios::binary);
+    if(!f) throw runtime_error("Error opening the file '" + file + "'");
+
+    binary_header h = make_header(csr_magic, A.sym, A.m, A.n, A.nz);
+    f.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    f.write(reinterpret_cast<const char *>(A.row_ptr), sizeof(int32_t) * (A.m + 1));
+    f.write(reinterpret_cast<const char *>(A.jcn), sizeof(int32_t) * A.nz);
+
+    size_t ind = sizeof(h) + sizeof(int32_t) * (static_cast<size_t>(A.m) + 1 + A.nz);
+    const char pad[8] = {0};
+    f.write(pad, (ind + 7) / 8 * 8 - ind);
+    f.write(reinterpret_cast<const char *>(A.val), sizeof(double) * A.nz);
+
+    if(!f) throw runtime_error("Error writing the file '" + file + "'");
+}
+
+void write_binary_rhs(const string &file, const double *rhs, int m, int nrhs)
+{
+    ofstream f(file.c_str(), ios::binary);
+    if(!f) throw runtime_error("Error opening the file '" + file + "'");
+
+    binary_header h = make_header(rhs_magic, false, m, nrhs, 0);
+    f.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    f.write(reinterpret_cast<const char *>(rhs), sizeof(double) * static_cast<size_t>(m) * nrhs);
+
+    if(!f) throw runtime_error("Error writing the file '" + file + "'");
+}
@@ -0,0 +1,73 @@
+// Copyright Institut National Polytechnique de Toulouse (2014) 
+// Contributor(s) :
+// M. Zenadi <mzenadi@enseeiht.fr>
+// D. Ruiz <ruiz@enseeiht.fr>
+// R. Guivarch <guivarch@enseeiht.fr>
+
+// This software is governed by the CeCILL-C license under French law and
+// abiding by the rules of distribution of free software.  You can  use, 
+// modify and/ or redistribute the software under the terms of the CeCILL-C
+// license as circulated by CEA, CNRS and INRIA at the following URL
+// "http://www.cecill.info/licences/Licence_CeCILL-C_V1-en.html"
+
+// As a counterpart to the access to the source code and  rights to copy,
+// modify and redistribute granted by the license, users are provided only
+// with a limited warranty  and the software's author,  the holder of the
+// economic rights,  and the successive licensors  have only  limited
+// liability. 
+
+// In this respect, the user's attention is drawn to the risks associated
+// with loading,  using,  modifying and/or developing or reproducing the
+// software by the user in light of its specific status of free software,
+// that may mean  that it is complicated to manipulate,  and  that  also
+// therefore means  that it is reserved for developers  and  experienced
+// professionals having in-depth computer knowledge. Users are therefore
+// encouraged to load and test the software's suitability as regards their
+// requirements in conditions enabling the security of their systems and/or 
+// data to be ensured and,  more generally, to use and operate it in the 
+// same conditions as regards security. 
+
+// The fact that you are presently reading this means that you have had
+// knowledge of the CeCILL-C license and that you accept its terms.
+
+#ifndef LOADER_H_
+#define LOADER_H_
+
+#include <string>
+
+/*! A sparse matrix read from a file
+ *
+ * A Matrix Market file gives the entries in coordinates, 1-based, in
+ * #irn, #jcn and #val. A binary file gives 0-based CSR rows through
+ * #row_ptr, #jcn and #val that point in the mapping of the file; the
+ * mapping is private, writing in the arrays does not change the file.
+ * For a symmetric matrix only one triangle is given.
+ */
+struct matrix_data {
+    int m, n, nz;
+    bool sym;
+    int start_index;
+    int *irn;
+    int *jcn;
+    int *row_ptr;
+    double *val;
+};
+
+/// Reads a matrix in Matrix Market coordinate format or in binary CSR
+matrix_data load_matrix(const std::string &file);
+
+/// Reads dense right-hand sides in Matrix Market array format or in
+/// binary, the values of size m * nrhs are stored by columns
+double *load_rhs(const std::string &file, int &m, int &nrhs);
+
+/// Turns the coordinates of a loaded matrix into 0-based CSR rows,
+/// the entries keep their order in each row
+void coordinates_to_csr(matrix_data &A);
+
+/// Writes a matrix held in CSR in the binary format
+void write_binary_matrix(const std::string &file, const matrix_data &A);
+
+/// Writes dense right-hand sides in the binary format
+void write_binary_rhs(const std::string &file, const double *rhs, int m, int nrhs);
+
+#endif // LOADER_H_
@@ -11,20 +11,12 @@
 
 #include "abcd.h"
 #include "mumps.h"
+#include "loader.h"
 
 using namespace std;
 using namespace boost::property_tree;
 
 
-extern "C" {
-    #include "mmio.h"
-    int mm_read_mtx_crd_size(_IO_FILE*, int*, int*, int*);
-    int mm_read_mtx_crd_data(_IO_FILE*, int, int, int, int*, int*, double*, char*);
-    int mm_read_banner(_IO_FILE*, char (*) [4]);
-    int mm_read_mtx_array_size(_IO_FILE*, int*, int*);
-}
-
-
 
 int main(int argc, char* argv[]) 
 {
@@ -75,71 +67,61 @@ int main(int argc, char* argv[])
             exit(-1);
         }
 
-        FILE *f = fopen(matrix_file.c_str(), "r");
+        // the preprocessed problem may come from a checkpoint, the
+        // matrix is then not needed
+        obj.read_checkpoint = pt.get<string>("read_checkpoint", "");
 
-        if(f == NULL){
-            cerr << "Error opening the file '"<< matrix_file << "'" << endl;
-            exit(-1);
+        // either a Matrix Market file, read in coordinates, or a binary
+        // file whose CSR arrays are given as is to the solver
+        matrix_data mat = {0, 0, 0, false, 0, nullptr, nullptr, nullptr, nullptr};
+        if(obj.read_checkpoint.length() == 0) {
+            try {
+                mat = load_matrix(matrix_file);
+            } catch(std::runtime_error &e) {
+                cerr << e.what() << endl;
+                exit(-1);
+            }
         }
-        MM_typecode mat_code;
 
-        mm_read_banner(f, &mat_code);
-        mm_read_mtx_crd_size(f, (int *)&obj.m, (int *)&obj.n, (int *)&obj.nz);
-
-        if(mm_is_symmetric(mat_code))
-            obj.sym = true;
-        else
-            obj.sym = false;
-
-        // allocate the arrays
-        obj.irn = new int[obj.nz];
-        obj.jcn = new int[obj.nz];
-        obj.val = new double[obj.nz];
-        obj.start_index = 1;
-
-        mm_read_mtx_crd_data(f, obj.m, obj.n, obj.nz, obj.irn, obj.jcn, obj.val, mat_code);
+        obj.m = mat.m;
+        obj.n = mat.n;
+        obj.nz = mat.nz;
+        obj.sym = mat.sym;
+        obj.irn = mat.irn;
+        obj.jcn = mat.jcn;
+        obj.row_ptr = mat.row_ptr;
+        obj.val = mat.val;
+        obj.start_index = mat.start_index;
 
         cout << "Matrix information : ";
         cout << "m = " << obj.m << "; n = " << obj.n << "; nz = " << obj.nz << endl;
 
-        fclose(f);
-
         //read the rhs here!
         boost::optional<string> rhs_file = pt.get_optional<string>("system.rhs_file");
         boost::optional<string> sol_file = pt.get_optional<string>("system.sol_file");
         
         if(rhs_file){
-            FILE *rhs_f = fopen(rhs_file->c_str(), "r");
-
-            if(rhs_f == NULL){
-                cerr << "Error opening the file '"<< *rhs_file << "'" << endl;
-                exit(-1);
-            }
-
-            MM_typecode rhs_code;
             int nb_v, m_v;
 
-            mm_read_banner(rhs_f, &rhs_code);
-            mm_read_mtx_array_size(rhs_f, &m_v, &nb_v);
-
-            obj.rhs = new double[nb_v * m_v];
-            cout << "Reading "<< m_v << " values for each of the " << nb_v << " rhs" << endl;
-
-            double cv;
-            int ret;
-            for(int i = 0; i < m_v*nb_v; i++){
-                ret = fscanf(rhs_f, "%lf", &cv);
-                obj.rhs[i] = cv;
+            try {
+                obj.rhs = load_rhs(*rhs_file, m_v, nb_v);
+            } catch(std::runtime_error &e) {
+                cerr << e.what() << endl;
+                exit(-1);
             }
-            //
-            fclose(rhs_f);
+            cout << "Read "<< m_v << " values for each of the " << nb_v << " rhs" << endl;
         }
 
         int testMumps =(int) pt.get<bool>("test_mumps", false);
+        if(testMumps && obj.read_checkpoint.length() != 0) {
+            clog << "Error parsing the file, test_mumps needs the matrix that is not read with read_checkpoint" << endl;
+            exit(-1);
+        }
         double minMumps = pt.get<double>("min_mumps", 0);
         double *mumps_rhs;
         int mumps_n = obj.n;
         MUMPS mu;
+        std::vector<int> mu_irn, mu_jcn;
         if(testMumps){
 
             if(obj.sym) {
@@ -173,8 +155,20 @@ int main(int argc, char* argv[])
 
             mu.n = obj.n;
             mu.nz = obj.nz;
-            mu.irn = obj.irn;
-            mu.jcn = obj.jcn;
+            if(obj.row_ptr != nullptr) {
+                // MUMPS takes the entries in 1-based coordinates
+                for(int i = 0; i < obj.m; i++) {
+                    for(int k = obj.row_ptr[i]; k < obj.row_ptr[i + 1]; k++) {
+                        mu_irn.push_back(i + 1);
+                        mu_jcn.push_back(obj.jcn[k] + 1);
+                    }
+                }
+                mu.irn = &mu_irn[0];
+                mu.jcn = &mu_jcn[0];
+            } else {
+                mu.irn = obj.irn;
+                mu.jcn = obj.jcn;
+            }
             mu.a = obj.val;
 
             if (obj.rhs != NULL){
@@ -234,6 +228,7 @@ int main(int argc, char* argv[])
 
         obj.icntl[Controls::part_type] = pt.get<int>("partitioning.part_type", 2);
         obj.icntl[Controls::part_guess] = pt.get<int>("partitioning.part_guess", 0);
+        obj.icntl[Controls::part_refine] = pt.get<int>("partitioning.part_refine", 0);
         obj.dcntl[Controls::part_imbalance] = pt.get<double>("partitioning.part_imbalance", 0.5);
 
         if(obj.icntl[Controls::part_type] == 1){
@@ -273,18 +268,26 @@ int main(int argc, char* argv[])
         }
 
         obj.write_problem   = pt.get<string>("write_problem", "");
+        obj.write_checkpoint = pt.get<string>("write_checkpoint", "");
 
 #ifdef WIP
         obj.icntl[Controls::exploit_sparcity]    = pt.get<int>("exploit_sparcity", 1);
 #endif //WIP
 
         obj.icntl[Controls::scaling]    = pt.get<int>("scaling", 2);
+        obj.icntl[Controls::dist_preprocess] = pt.get<int>("dist_preprocess", 0);
 
         boost::optional<ptree::key_type> augmentation = pt.get_optional<ptree::key_type>("augmentation");
 
         if(augmentation){
             obj.icntl[Controls::aug_type]   = pt.get<int>("augmentation.aug_type", 2);
             obj.icntl[Controls::aug_blocking]   = pt.get<int>("augmentation.aug_blocking", 256);
+            obj.icntl[Controls::aug_schur]   = pt.get<int>("augmentation.aug_schur", 0);
+            obj.icntl[Controls::aug_balance]   = pt.get<int>("augmentation.aug_balance", 0);
+            obj.icntl[Controls::aug_iterative]   = pt.get<int>("augmentation.aug_iterative", 0);
+            obj.icntl[Controls::aug_itmax]   = pt.get<int>("augmentation.aug_itmax", 0);
+            obj.dcntl[Controls::aug_precond]   = pt.get<double>("augmentation.aug_precond", 0);
+            obj.dcntl[Controls::aug_tol]   = pt.get<double>("augmentation.aug_tol", 1e-10);
 #ifdef WIP
             obj.icntl[Controls::aug_analysis]   = pt.get<int>("augmentation.analysis", 0);
             obj.dcntl[Controls::aug_filter]   = pt.get<double>("augmentation.filtering", 0.0);
@@ -318,6 +321,16 @@ int main(int argc, char* argv[])
 
             obj.icntl[Controls::itmax] = pt.get<int>("system.itmax", 2000);
             obj.dcntl[Controls::threshold] = pt.get<double>("system.threshold", 1e-12);
+            obj.icntl[Controls::halo_exchange] = pt.get<int>("system.halo_exchange", 0);
+            obj.icntl[Controls::acceleration] = pt.get<int>("system.acceleration", 0);
+            obj.icntl[Controls::check_interval] = pt.get<int>("system.check_interval", 0);
+            obj.icntl[Controls::cheb_lanczos] = pt.get<int>("system.cheb_lanczos", 0);
+            obj.dcntl[Controls::async_omega] = pt.get<double>("system.async_omega", 0);
+            obj.icntl[Controls::kaczmarz] = pt.get<int>("system.kaczmarz", 0);
+            obj.icntl[Controls::two_level] = pt.get<int>("system.two_level", 0);
+            obj.icntl[Controls::recycle] = pt.get<int>("system.recycle", 0);
+            obj.dcntl[Controls::recycle_mem] = pt.get<double>("system.recycle_mem", 0);
+            obj.icntl[Controls::warm_start] = pt.get<int>("system.warm_start", 0);
 
             // obj.icntl[Controls::verbose] =  pt.get<int>("solve_verbose", 0);
             obj(3);
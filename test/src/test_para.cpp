@@ -4,13 +4,22 @@
 #include "gmock/gmock.h"
 #include "vect_utils.h"
 #include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdint.h>
+#include <vector>
 
 using ::testing::AtLeast;
 using ::testing::Return;
 using ::testing::Eq;
 using ::testing::Ne;
+using ::testing::Ge;
 using ::testing::Le;
 using ::testing::Lt;
+using ::testing::Gt;
 using namespace Controls;
 
 #include "mpi.h"
@@ -19,6 +28,9 @@ using namespace Controls;
 // A simple matrix generator for a regular 2D mesh + 5-point stencil 
 void init_2d_lap(int m, int n, int nz, int *irn, int *jcn, double *val, int mesh_size);
 void init_2d_lap(abcd &o, int mesh_size);
+// The rows first to last - 1 of the same matrix with both triangles, in CSR
+void init_2d_lap_rows(int mesh_size, int first, int last, std::vector<int> &row_ptr,
+                      std::vector<int> &jcn, std::vector<double> &val);
 
 
 class AbcdTest : public ::testing::Test {
@@ -30,8 +42,8 @@ protected:
 TEST_F (AbcdTest, defaults)
 {
   // default icntl
-  int ic[] = {0,4,2,0,1,2,1000,1,0,0,0,256,0,0,0,0,0,0,0,0};
-  std::vector<int> default_icntl(ic, ic + 20);
+  int ic[] = {0,4,2,0,1,2,1000,1,0,0,0,256,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+  std::vector<int> default_icntl(ic, ic + 32);
 
   EXPECT_THAT(obj.icntl, Eq(default_icntl));
 }
@@ -104,6 +116,33 @@ TEST_F (AbcdTest, MatrixInit)
   }
 }
 
+TEST_F (AbcdTest, MatrixInit_OutOfRange)
+{
+  // a 1-based index given with 0-based arrays
+  int irn[] = {0, 1, 2};
+  int jcn[] = {0, 1, 2};
+  double val[] = {1, 1, 1};
+
+  if (world.rank() == 0) {
+    obj.m = 2;
+    obj.n = 2;
+    obj.nz = 3;
+    obj.irn = irn;
+    obj.jcn = jcn;
+    obj.val = val;
+  }
+
+  // only the master holds the matrix
+  if (world.rank() == 0) {
+    EXPECT_THROW(obj(-1), range_error);
+    EXPECT_THAT(obj.info[Controls::status], Eq(-2));
+    // the user's arrays are left untouched
+    EXPECT_THAT(irn[2], Eq(2));
+  } else {
+    EXPECT_NO_THROW(obj(-1));
+  }
+}
+
 TEST_F (AbcdTest, OneSystemOneBased)
 {
   obj.m = 1;
@@ -121,6 +160,7 @@ TEST_F (AbcdTest, OneSystemOneBased)
   obj.rhs[0] = 2;
   obj.nrhs = 1;
   obj.sym = false;
+  obj.start_index = 1;
 
   EXPECT_NO_THROW(obj(-1));
   EXPECT_NO_THROW(obj(1));
@@ -336,6 +376,748 @@ TEST_F (AbcdTest, AijAugment_SmallChuncks)
   EXPECT_NO_THROW(obj(6));
 }
 
+// Solves the 2D Laplacian once with the classical CG, the other solves
+// of the same system have to converge to its solution
+class AbcdSolveTest : public AbcdTest {
+protected:
+  static const int mesh_size = 30;
+  static std::vector<double> ref_sol;
+  static double ref_backward;
+  static int ref_nb_iter;
+
+  static void SetUpTestCase()
+  {
+    mpi::communicator world;
+    abcd ref;
+    initLap(ref);
+    ref(-1);
+    ref(6);
+
+    if (world.rank() == 0) {
+      ref_sol.assign(ref.sol, ref.sol + ref.n);
+      ref_backward = ref.dinfo[Controls::backward];
+      ref_nb_iter = ref.info[Controls::nb_iter];
+    }
+  }
+
+  // init_2d_lap fills the arrays 1-based
+  static void initLap(abcd &o)
+  {
+    init_2d_lap(o, mesh_size);
+    o.start_index = 1;
+  }
+
+  // converged below max_backward and to the solution of the classical CG
+  void expectConverged(abcd &o, double max_backward = 1e-12)
+  {
+    if (world.rank() != 0) return;
+
+    EXPECT_THAT(o.info[Controls::status], Eq(0));
+    EXPECT_THAT(o.info[Controls::nb_iter], Lt(o.icntl[Controls::itmax]));
+    EXPECT_THAT(o.dinfo[Controls::backward], Lt(max_backward));
+    EXPECT_THAT(relativeError(o.sol, &ref_sol[0], ref_sol.size()), Lt(1e-6));
+  }
+
+  // converged to the solution of other, solved from scratch
+  void expectSameSolution(abcd &o, abcd &other)
+  {
+    if (world.rank() != 0) return;
+
+    EXPECT_THAT(o.info[Controls::status], Eq(0));
+    EXPECT_THAT(o.dinfo[Controls::backward], Lt(1e-12));
+    EXPECT_THAT(relativeError(o.sol, other.sol, ref_sol.size()), Lt(1e-6));
+  }
+
+  static double relativeError(const double *x, const double *ref, int n)
+  {
+    double err = 0, nrm = 0;
+    for (int i = 0; i < n; i++) {
+      err = std::max(err, std::abs(x[i] - ref[i]));
+      nrm = std::max(nrm, std::abs(ref[i]));
+    }
+    return err / nrm;
+  }
+
+  // the same matrix with both triangles, its CSR arrays are adopted by
+  // the solver and have to outlive it
+  void initCSR(abcd &o)
+  {
+    if (world.rank() != 0) return;
+
+    int m = mesh_size * mesh_size;
+    std::vector<int> rp, ci;
+    std::vector<double> v;
+    init_2d_lap_rows(mesh_size, 0, m, rp, ci, v);
+
+    o.m = m;
+    o.n = m;
+    o.nz = ci.size();
+    o.sym = false;
+    o.start_index = 1;
+    o.row_ptr = new int[m + 1];
+    o.jcn = new int[o.nz];
+    o.val = new double[o.nz];
+    std::copy(rp.begin(), rp.end(), o.row_ptr);
+    std::copy(ci.begin(), ci.end(), o.jcn);
+    std::copy(v.begin(), v.end(), o.val);
+
+    o.rhs = new double[m];
+    for (int i = 0; i < m; i++) o.rhs[i] = ((double) i + 1)/m;
+  }
+
+  // the same matrix given by slices of rows, one per process
+  void initSlice(abcd &o)
+  {
+    int m = mesh_size * mesh_size;
+    int first = world.rank() * m / world.size();
+    int last = (world.rank() + 1) * m / world.size();
+    std::vector<int> rp, ci;
+    std::vector<double> v;
+    init_2d_lap_rows(mesh_size, first, last, rp, ci, v);
+
+    o.m = m;
+    o.n = m;
+    o.nz = ci.size();
+    o.sym = false;
+    o.start_index = 1;
+    o.row_offset = first;
+
+    o.irn = new int[o.nz];
+    o.jcn = new int[o.nz];
+    o.val = new double[o.nz];
+    for (int i = 0; i < last - first; i++)
+      for (int k = rp[i] - 1; k < rp[i + 1] - 1; k++) o.irn[k] = first + i + 1;
+    std::copy(ci.begin(), ci.end(), o.jcn);
+    std::copy(v.begin(), v.end(), o.val);
+
+    if (world.rank() == 0) {
+      o.rhs = new double[m];
+      for (int i = 0; i < m; i++) o.rhs[i] = ((double) i + 1)/m;
+    }
+  }
+};
+
+std::vector<double> AbcdSolveTest::ref_sol;
+double AbcdSolveTest::ref_backward;
+int AbcdSolveTest::ref_nb_iter;
+
+TEST_F (AbcdSolveTest, Reference)
+{
+  if (world.rank() == 0) {
+    EXPECT_THAT(ref_sol.size(), Eq((size_t) mesh_size * mesh_size));
+    EXPECT_THAT(ref_backward, Lt(1e-12));
+  }
+}
+
+TEST_F (AbcdSolveTest, Workspace)
+{
+  initLap(obj);
+  obj.icntl[block_size] = 4;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  // the sumProject workspace is sized before the iterations
+  if (world.rank() == 0) {
+    EXPECT_THAT(obj.dinfo[Controls::ws_bytes], Gt(0.0));
+    EXPECT_THAT(obj.dinfo[Controls::ws_iter_bytes], Eq(0.0));
+  }
+}
+
+TEST_F (AbcdSolveTest, PipelinedCG)
+{
+  initLap(obj);
+  obj.icntl[acceleration] = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+}
+
+// the halo is exchanged between masters, it needs several of them
+TEST_F (AbcdSolveTest, HaloPipelined)
+{
+  if (world.size() == 1) return;
+
+  initLap(obj);
+  obj.icntl[halo_exchange] = 1;
+  obj.icntl[nbparts] = 4;
+  obj.icntl[part_guess] = 0;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+  if (world.rank() == 0) EXPECT_THAT(obj.parallel_cg, Gt(1));
+}
+
+TEST_F (AbcdSolveTest, HaloNeighbourhood)
+{
+  if (world.size() == 1) return;
+
+  initLap(obj);
+  obj.icntl[halo_exchange] = 2;
+  obj.icntl[nbparts] = 4;
+  obj.icntl[part_guess] = 0;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+  if (world.rank() == 0) EXPECT_THAT(obj.parallel_cg, Gt(1));
+}
+
+TEST_F (AbcdSolveTest, CheckInterval)
+{
+  initLap(obj);
+  obj.icntl[check_interval] = 5;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  // by default the backward error is computed at every iteration
+  abcd every;
+  initLap(every);
+  EXPECT_NO_THROW(every(-1));
+  EXPECT_NO_THROW(every(6));
+
+  if (world.rank() == 0) {
+    EXPECT_THAT(every.info[Controls::nb_backward], Eq(every.info[Controls::nb_iter] + 1));
+    EXPECT_THAT(obj.info[Controls::nb_backward], Lt(every.info[Controls::nb_backward] / 2));
+  }
+}
+
+// the initial analysis that estimates the work of the slaves gives its
+// ordering to the analysis with them
+TEST_F (AbcdSolveTest, OrderingReuse)
+{
+  initLap(obj);
+  obj.parallel_cg = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+  if (world.rank() == 0) EXPECT_THAT(obj.info[Controls::nb_orderings], Eq(1));
+}
+
+TEST_F (AbcdSolveTest, AugSchur)
+{
+  initLap(obj);
+  obj.icntl[aug_type] = 1;
+  obj.icntl[aug_schur] = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+}
+
+TEST_F (AbcdSolveTest, Chebyshev)
+{
+  initLap(obj);
+  obj.icntl[acceleration] = 2;
+  obj.icntl[itmax] = 2000;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  // the backward error is the only reduction, every 10 iterations
+  if (world.rank() == 0)
+    EXPECT_THAT(obj.info[Controls::nb_backward], Le(obj.info[Controls::nb_iter] / 10 + 2));
+}
+
+// the relaxed iterations are not accelerated, they only get to a
+// looser threshold in a reasonable number of iterations
+TEST_F (AbcdSolveTest, AsyncCimmino)
+{
+  initLap(obj);
+  obj.icntl[acceleration] = 3;
+  obj.icntl[itmax] = 20000;
+  obj.dcntl[Controls::threshold] = 1e-8;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+
+  if (world.rank() == 0) {
+    EXPECT_THAT(obj.info[Controls::status], Eq(0));
+    EXPECT_THAT(obj.info[Controls::nb_iter], Lt(obj.icntl[itmax]));
+    EXPECT_THAT(obj.dinfo[Controls::backward], Lt(1e-8));
+    EXPECT_THAT(relativeError(obj.sol, &ref_sol[0], ref_sol.size()), Lt(1e-3));
+  }
+}
+
+TEST_F (AbcdSolveTest, Kaczmarz)
+{
+  initLap(obj);
+  obj.icntl[kaczmarz] = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+}
+
+// the sweeps are not accelerated
+TEST_F (AbcdSolveTest, KaczmarzSweeps)
+{
+  initLap(obj);
+  obj.icntl[kaczmarz] = 2;
+  obj.icntl[itmax] = 20000;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+}
+
+TEST_F (AbcdSolveTest, TwoLevel)
+{
+  initLap(obj);
+  obj.icntl[two_level] = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  // the coarse correction removes the slowest components
+  if (world.rank() == 0)
+    EXPECT_THAT(obj.info[Controls::nb_iter], Lt(ref_nb_iter));
+}
+
+TEST_F (AbcdSolveTest, Multilevel)
+{
+  initLap(obj);
+  obj.icntl[part_type] = 4;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+}
+
+TEST_F (AbcdSolveTest, Multilevel_Refine)
+{
+  initLap(obj);
+  obj.icntl[part_type] = 4;
+  obj.icntl[part_refine] = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  if (world.rank() == 0) {
+    EXPECT_THAT(obj.dinfo[Controls::coupling_after], Lt(obj.dinfo[Controls::coupling_before]));
+  }
+}
+
+TEST_F (AbcdSolveTest, DistPreprocess)
+{
+  initLap(obj);
+  obj.icntl[dist_preprocess] = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+}
+
+TEST_F (AbcdSolveTest, DistPreprocess_CijAugment)
+{
+  initLap(obj);
+  obj.icntl[dist_preprocess] = 1;
+  obj.icntl[aug_type] = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+}
+
+TEST_F (AbcdSolveTest, AugBalance)
+{
+  initLap(obj);
+  obj.icntl[aug_type] = 1;
+  obj.icntl[aug_balance] = 1;
+  obj.icntl[aug_blocking] = 16;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  // the slowest master over the average, between a perfect balance and
+  // a single master doing all the work
+  if (world.rank() == 0) {
+    int masters = std::min(world.size(), obj.icntl[nbparts]);
+    EXPECT_THAT(obj.dinfo[Controls::s_imbalance], Ge(1.0));
+    EXPECT_THAT(obj.dinfo[Controls::s_imbalance], Le((double) masters));
+    if (masters == 1) EXPECT_THAT(obj.dinfo[Controls::s_imbalance], Eq(1.0));
+  }
+}
+
+TEST_F (AbcdSolveTest, AugIterative)
+{
+  initLap(obj);
+  obj.icntl[aug_type] = 1;
+  obj.icntl[aug_iterative] = 1;
+  obj.dcntl[Controls::aug_precond] = -2;
+  // S is ill-conditioned on the Laplacian, the CG needs more than size_c
+  // iterations in floating point
+  obj.icntl[aug_itmax] = 1000;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj, 1e-10);
+  if (world.rank() == 0) {
+    EXPECT_THAT(obj.dinfo[Controls::aug_residual], Le(obj.dcntl[Controls::aug_tol]));
+  }
+
+  // stopped before aug_tol, the solve goes on with a warning
+  obj.icntl[aug_itmax] = 1;
+  EXPECT_NO_THROW(obj(3));
+  if (world.rank() == 0) {
+    EXPECT_THAT(obj.info[Controls::status], Eq(1));
+    EXPECT_THAT(obj.info[Controls::aug_nb_iter], Eq(1));
+  }
+}
+
+TEST_F (AbcdSolveTest, Recycling)
+{
+  initLap(obj);
+  obj.icntl[recycle] = 10;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  // another right-hand side, deflated by the recycled basis
+  if (world.rank() == 0) {
+    for (int i = 0; i < mesh_size * mesh_size; i++) obj.rhs[i] = 1;
+  }
+  EXPECT_NO_THROW(obj(3));
+
+  // the same right-hand side without recycling
+  abcd plain;
+  initLap(plain);
+  if (world.rank() == 0) {
+    for (int i = 0; i < mesh_size * mesh_size; i++) plain.rhs[i] = 1;
+  }
+  EXPECT_NO_THROW(plain(-1));
+  EXPECT_NO_THROW(plain(6));
+
+  expectSameSolution(obj, plain);
+  if (world.rank() == 0) {
+    EXPECT_THAT(obj.info[Controls::nb_iter], Lt(plain.info[Controls::nb_iter]));
+  }
+}
+
+TEST_F (AbcdSolveTest, StartingPoint)
+{
+  initLap(obj);
+  if (world.rank() == 0) obj.x0 = &ref_sol[0];
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+  if (world.rank() == 0) {
+    EXPECT_THAT(obj.info[Controls::nb_iter], Le(1));
+  }
+}
+
+TEST_F (AbcdSolveTest, WarmStart)
+{
+  initLap(obj);
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  // the previous solution solves the same system
+  obj.icntl[warm_start] = 1;
+  EXPECT_NO_THROW(obj(3));
+  expectConverged(obj);
+  if (world.rank() == 0) {
+    EXPECT_THAT(obj.info[Controls::nb_iter], Le(1));
+  }
+}
+
+TEST_F (AbcdSolveTest, DistInput)
+{
+  initSlice(obj);
+  obj.icntl[dist_input] = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+}
+
+TEST_F (AbcdSolveTest, DistInput_OutOfSlice)
+{
+  initSlice(obj);
+  obj.icntl[dist_input] = 1;
+
+  // the last process gives a column out of the matrix and, when it is
+  // not alone, a row of the first slice
+  if (world.rank() == world.size() - 1) {
+    obj.jcn[0] = obj.n + 1;
+    if (world.size() > 1) obj.irn[1] = 1;
+  }
+
+  // every process refuses the matrix
+  EXPECT_THROW(obj(-1), range_error);
+  EXPECT_THAT(obj.info[Controls::status], Eq(-2));
+}
+
+// the partitioner only gets the pattern of the slices
+TEST_F (AbcdSolveTest, DistInput_Multilevel)
+{
+  initSlice(obj);
+  obj.icntl[dist_input] = 1;
+  obj.icntl[part_type] = 4;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+}
+
+TEST_F (AbcdSolveTest, DistInput_Checkpoint)
+{
+  initSlice(obj);
+  obj.icntl[dist_input] = 1;
+  // no checkpoint without the matrix on the master
+  obj.write_checkpoint = "/tmp/test_file_abcd.ckp";
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_ANY_THROW(obj(1));
+  EXPECT_THAT(obj.info[Controls::status], Eq(-15));
+}
+
+TEST_F (AbcdSolveTest, CSR)
+{
+  initCSR(obj);
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+}
+
+TEST_F (AbcdSolveTest, Checkpoint)
+{
+  initLap(obj);
+  obj.icntl[aug_type] = 1;
+  obj.icntl[aug_iterative] = 1;
+  obj.icntl[aug_itmax] = 1000;
+  obj.write_checkpoint = "/tmp/test_file_abcd.ckp";
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj, 1e-10);
+
+  // the same solve without the matrix
+  abcd other;
+  other.icntl[aug_type] = 1;
+  other.icntl[aug_iterative] = 1;
+  other.icntl[aug_itmax] = 1000;
+  other.read_checkpoint = obj.write_checkpoint;
+  // obj.m is now the number of rows of the master
+  if (world.rank() == 0) {
+    int m = mesh_size * mesh_size;
+    other.rhs = new double[m];
+    std::copy(obj.rhs, obj.rhs + m, other.rhs);
+  }
+
+  EXPECT_NO_THROW(other(-1));
+  EXPECT_NO_THROW(other(6));
+  expectConverged(other, 1e-10);
+
+  // a missing checkpoint
+  abcd missing;
+  missing.read_checkpoint = "/tmp/test_file_abcd_missing.ckp";
+  EXPECT_NO_THROW(missing(-1));
+  EXPECT_ANY_THROW(missing(1));
+  EXPECT_THAT(missing.info[Controls::status], Eq(-16));
+
+  // a column index of A out of the matrix
+  abcd corrupted;
+  corrupted.read_checkpoint = "/tmp/test_file_abcd_corrupted.ckp";
+  if (world.rank() == 0) {
+    std::ifstream in(obj.write_checkpoint.c_str(), std::ios::binary);
+    std::vector<char> ckp((std::istreambuf_iterator<char>(in)),
+                          std::istreambuf_iterator<char>());
+
+    // skip the header, the scaling, the permutation and the partitioning
+    size_t pos = 8 + sizeof(int32_t) + 7 * sizeof(int64_t);
+    for (int k = 0; k < 6; k++) {
+      int64_t len;
+      std::memcpy(&len, &ckp[pos], sizeof(len));
+      pos += sizeof(len) + len * (k < 2 ? sizeof(double) : sizeof(int));
+    }
+    int64_t dims[3];
+    std::memcpy(dims, &ckp[pos], sizeof(dims));
+    pos += sizeof(dims) + (dims[0] + 1) * sizeof(int);
+    int bad = dims[1];
+    std::memcpy(&ckp[pos], &bad, sizeof(bad));
+
+    std::ofstream out(corrupted.read_checkpoint.c_str(), std::ios::binary);
+    out.write(&ckp[0], ckp.size());
+  }
+  EXPECT_NO_THROW(corrupted(-1));
+  EXPECT_ANY_THROW(corrupted(1));
+  EXPECT_THAT(corrupted.info[Controls::status], Eq(-16));
+}
+
+// The values of the Laplacian with -6 on the diagonal, in the order of
+// the entries given by initLap or initCSR
+void setNewValues(abcd &o, int mesh_size, bool csr)
+{
+  if (o.comm.rank() != 0) return;
+
+  int m = mesh_size * mesh_size;
+  std::vector<double> v;
+  if (csr) {
+    std::vector<int> rp, ci;
+    init_2d_lap_rows(mesh_size, 0, m, rp, ci, v);
+  } else {
+    int nz = 3*m - 2*mesh_size;
+    std::vector<int> irn(nz), jcn(nz);
+    v.resize(nz);
+    init_2d_lap(m, m, nz, &irn[0], &jcn[0], &v[0], mesh_size);
+  }
+
+  for (size_t k = 0; k < v.size(); k++)
+    if (v[k] == -4.0) v[k] = -6.0;
+  std::copy(v.begin(), v.end(), o.val);
+}
+
+TEST_F (AbcdSolveTest, Refactorize_SymmetricCoordinates)
+{
+  initLap(obj);
+  // the blocks of C are recomputed from the new values
+  obj.icntl[aug_type] = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  setNewValues(obj, mesh_size, false);
+  EXPECT_NO_THROW(obj(7));
+  EXPECT_NO_THROW(obj(3));
+
+  abcd fresh;
+  initLap(fresh);
+  fresh.icntl[aug_type] = 1;
+  setNewValues(fresh, mesh_size, false);
+  EXPECT_NO_THROW(fresh(-1));
+  EXPECT_NO_THROW(fresh(6));
+  expectSameSolution(obj, fresh);
+}
+
+// the partitions and the blocks of C stay on the masters that built them
+TEST_F (AbcdSolveTest, Refactorize_DistPreprocess)
+{
+  initLap(obj);
+  obj.icntl[dist_preprocess] = 1;
+  obj.icntl[aug_type] = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  setNewValues(obj, mesh_size, false);
+  EXPECT_NO_THROW(obj(7));
+  EXPECT_NO_THROW(obj(3));
+
+  abcd fresh;
+  initLap(fresh);
+  fresh.icntl[aug_type] = 1;
+  setNewValues(fresh, mesh_size, false);
+  EXPECT_NO_THROW(fresh(-1));
+  EXPECT_NO_THROW(fresh(6));
+  expectSameSolution(obj, fresh);
+}
+
+TEST_F (AbcdSolveTest, Refactorize_AdoptedCSR)
+{
+  initCSR(obj);
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  // val is also the storage of A, all of it is given again
+  setNewValues(obj, mesh_size, true);
+  EXPECT_NO_THROW(obj(7));
+  EXPECT_NO_THROW(obj(3));
+
+  abcd fresh;
+  initCSR(fresh);
+  setNewValues(fresh, mesh_size, true);
+  EXPECT_NO_THROW(fresh(-1));
+  EXPECT_NO_THROW(fresh(6));
+  expectSameSolution(obj, fresh);
+}
+
+TEST_F (AbcdSolveTest, Refactorize_Recycling)
+{
+  initLap(obj);
+  obj.icntl[recycle] = 10;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  expectConverged(obj);
+
+  // the recycled basis of the previous matrix is dropped, the
+  // assertions of the bundled MV++ check the empty matrices
+  setNewValues(obj, mesh_size, false);
+  EXPECT_NO_THROW(obj(7));
+  EXPECT_NO_THROW(obj(3));
+
+  abcd fresh;
+  initLap(fresh);
+  setNewValues(fresh, mesh_size, false);
+  EXPECT_NO_THROW(fresh(-1));
+  EXPECT_NO_THROW(fresh(6));
+  expectSameSolution(obj, fresh);
+}
+
+TEST_F (AbcdTest, Refactorize_PatternChanged)
+{
+  // two partitions sharing the columns 2 and 3, C has a single entry
+  // 1*1 + 1*2 that the new values cancel
+  int irn[] = {1, 2, 2, 3, 3, 4};
+  int jcn[] = {1, 2, 3, 2, 3, 4};
+  double val[] = {2, 1, 1, 1, 2, 3};
+  double rhs[] = {1, 1, 1, 1};
+
+  if (world.rank() == 0) {
+    obj.m = 4;
+    obj.n = 4;
+    obj.nz = 6;
+    obj.sym = false;
+    obj.start_index = 1;
+    obj.irn = irn;
+    obj.jcn = jcn;
+    obj.val = val;
+    obj.rhs = rhs;
+  }
+  obj.icntl[nbparts] = 2;
+  obj.icntl[part_type] = 1;
+  obj.nbrows.assign(2, 2);
+  obj.icntl[scaling] = 0;
+  obj.icntl[aug_type] = 1;
+
+  EXPECT_NO_THROW(obj(-1));
+  EXPECT_NO_THROW(obj(6));
+  std::vector<double> old_sol;
+  if (world.rank() == 0) old_sol.assign(obj.sol, obj.sol + 4);
+
+  val[4] = -1;
+  EXPECT_THROW(obj(7), runtime_error);
+  EXPECT_THAT(obj.info[Controls::status], Eq(-14));
+
+  // nothing has been updated, the previous matrix is still solved
+  EXPECT_NO_THROW(obj(3));
+  if (world.rank() == 0) {
+    EXPECT_THAT(obj.info[Controls::status], Eq(0));
+    for (int i = 0; i < 4; i++)
+      EXPECT_NEAR(old_sol[i], obj.sol[i], 1e-10);
+  }
+}
+
 int main(int argc, char **argv) {
   // Equivalent to MPI_Initialize
   mpi::environment env(argc, argv);
@@ -355,6 +1137,7 @@ void init_2d_lap(abcd &obj, int mesh_size)
   obj.n = obj.m; // number of columns
   obj.nz = 3*obj.m - 2*mesh_size; // number of nnz in the lower-triangular part
   obj.sym = true;
+  obj.start_index = 1; // the indices below are 1-based
 
   // allocate the arrays
   obj.irn = new int[obj.nz];
@@ -400,3 +1183,26 @@ void init_2d_lap(int m, int n, int nz, int *irn, int *jcn, double *val, int mesh
     pos++;
   }
 }
+
+void init_2d_lap_rows(int mesh_size, int first, int last, std::vector<int> &row_ptr,
+                      std::vector<int> &jcn, std::vector<double> &val)
+{
+  int m = mesh_size * mesh_size;
+
+  row_ptr.assign(1, 1);
+  for (int i = first; i < last; i++) {
+    int cols[5] = {i - mesh_size, i - 1, i, i + 1, i + mesh_size};
+
+    for (int k = 0; k < 5; k++) {
+      int c = cols[k];
+      if (c < 0 || c >= m) continue;
+      // no neighbour across the border of the mesh
+      if (c == i - 1 && i % mesh_size == 0) continue;
+      if (c == i + 1 && c % mesh_size == 0) continue;
+
+      jcn.push_back(c + 1);
+      val.push_back(c == i ? -4.0 : 1.0);
+    }
+    row_ptr.push_back(jcn.size() + 1);
+  }
+}